@@ -51,7 +51,7 @@
 
 #define INCLUDE_vTaskSuspend 1
 
-#define INCLUDE_vTaskDelayUntil 0
+#define INCLUDE_vTaskDelayUntil 1
 
 #define INCLUDE_vTaskDelay 1
 
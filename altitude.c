@@ -9,17 +9,95 @@
  ENCE 464 Group 13
  altitude.c
 
- Interrupt driven collection of altitude adc values. Inserts
- adc values into a circular buffer and calculates an average. Converts
- Average into an altitude percentage between 0 and 100 and adds to
- altitue queue
+ Interrupt driven collection of altitude adc values. Passes
+ adc values through a filter pipeline (see filter.h). Converts
+ Average into an altitude percentage between 0 and 100, estimates
+ vertical velocity and adds both to altitue queue
 ----------------------------------------------------------------*/
 
 /* Includes ----------------------------------------------------*/
 #include "main.h"
 #include "altitude.h"
 #include "uart.h"
-#include "circBufT.h"
+#include "filter.h"
+#include "estimator.h"
+#include "pwm.h"
+/*--------------------------------------------------------------*/
+
+/* Globals -----------------------------------------------------*/
+// Altitude filter pipeline, each ADC sample passes through
+// these stages in order
+static const filterConfig_t altFilterConfig[] = {
+#if ALT_NOTCH_ENABLE
+        {FILTER_NOTCH, ALT_NOTCH_RADIUS},
+#endif
+        {FILTER_BOXCAR, ALT_ADC_BUF_LENGTH},
+};
+
+#if ALT_NOTCH_ENABLE
+// Main rotor vibration frequency seen on the altitude sensor at every
+// 10% of main duty (Hz, Q4). Measured per rig, 0 leaves the notch off.
+static const uint16_t altRotorFreqTable[11] = {
+        0 << FILTER_FREQ_BITS,  0 << FILTER_FREQ_BITS,  12 << FILTER_FREQ_BITS,
+        18 << FILTER_FREQ_BITS, 23 << FILTER_FREQ_BITS, 27 << FILTER_FREQ_BITS,
+        31 << FILTER_FREQ_BITS, 34 << FILTER_FREQ_BITS, 37 << FILTER_FREQ_BITS,
+        40 << FILTER_FREQ_BITS, 43 << FILTER_FREQ_BITS};
+#endif
+
+// Ground calibration result
+static altitudeCalibration_t altCalibration;
+
+// Altitude limit comparator events
+static volatile altitudeLimitStats_t altLimitStats;
+
+// ADC to altitude mapping, set up by altitudeInitScale
+static int32_t altADCValueAt0;
+#if ALT_SCALE_USE_LUT
+// Measured altitude (percent, Q8) at every 2^ALT_LUT_STEP_BITS ADC counts
+// above ground. The default is the linear ALT_ADC_SWING mapping.
+static const int32_t altScaleTable[ALT_LUT_LENGTH] = {
+        0 << ALT_FRAC_BITS,   16 << ALT_FRAC_BITS,  32 << ALT_FRAC_BITS,
+        48 << ALT_FRAC_BITS,  64 << ALT_FRAC_BITS,  80 << ALT_FRAC_BITS,
+        96 << ALT_FRAC_BITS,  112 << ALT_FRAC_BITS, 128 << ALT_FRAC_BITS};
+#else
+// Percent (Q8) per ADC count, Q ALT_RECIP_BITS
+static int32_t altScaleRecip;
+#endif
+
+#if ALT_ADC_USE_UDMA
+// uDMA channel control table, must be 1024 byte aligned
+#pragma DATA_ALIGN(uDMAControlTable, 1024)
+static uint8_t uDMAControlTable[1024];
+
+// An ADC feeding the altitude stream through uDMA ping-pong blocks
+typedef struct altitudeCapture_t {
+    uint32_t adcBase;
+    uint32_t dmaChannel;
+    uint32_t blocks[2][ALT_ADC_BLOCK_LENGTH];   // Filled by the uDMA
+    volatile bool busy[2];      // Set while a block is queued or being read
+    uint32_t sequence;          // Blocks completed, written by the ISR only
+} altitudeCapture_t;
+
+static altitudeCapture_t altCapture[ALT_ADC_COUNT] = {
+        {ALTITUDE_ADC_BASE, ALTITUDE_DMA_CHANNEL},
+#if ALT_ADC_DUAL
+        {ALTITUDE_ADC1_BASE, ALTITUDE_DMA1_CHANNEL},
+#endif
+};
+static volatile uint32_t altADCOverruns = 0;
+#if ALT_ADC_DUAL
+// Latest unpaired block from each ADC, and the interleaved pair
+static altitudeADCBlock_t altPendingBlock[ALT_ADC_COUNT];
+static uint32_t altMergedSamples[ALT_ADC_COUNT * ALT_ADC_BLOCK_LENGTH];
+static uint32_t altUnpaired = 0;
+#else
+// Block being read by altitudeAvgTask
+static altitudeADCBlock_t altCurrentBlock;
+#endif
+#else
+// Samples taken off the queue by altitudeAvgTask
+static uint32_t altADCSamples[ALT_ADC_QUEUE_LENGTH];
+#endif
 /*--------------------------------------------------------------*/
 
 // Altitude ADC sample trigger task.
@@ -27,12 +105,85 @@
 void altitudeADCSamplingTask(void *pvParameters) {
     while(1){
         // Trigger an ADC sample capture
-        ADCProcessorTrigger(ADC0_BASE, 3);
+        ADCProcessorTrigger(ALTITUDE_ADC_BASE, ALTITUDE_ADC_SEQ_NUM);
         // Task delay
         vTaskDelay(ALT_ADC_SAMPLE_DELAY / portTICK_RATE_MS);
     }
 }
 
+#if ALT_ADC_USE_UDMA
+// Queues a completed ping-pong block and re-arms it for the uDMA.
+// The re-armed block is not written until the other block is full.
+static void altitudeBlockComplete(uint32_t source, uint32_t index, uint32_t select, BaseType_t* woken) {
+    altitudeCapture_t* capture = &altCapture[source];
+    altitudeADCBlock_t block;
+
+    // The uDMA has moved on to the other block. If the task still
+    // holds it, those samples are being overwritten.
+    if (capture->busy[index ^ 1]) {
+        altADCOverruns++;
+    }
+
+    block.samples = capture->blocks[index];
+    block.length = ALT_ADC_BLOCK_LENGTH;
+    block.index = index;
+    block.source = source;
+    block.sequence = capture->sequence++;
+    capture->busy[index] = true;
+    if (xQueueSendFromISR(xAltitudeADCQueue, &block, woken) != pdPASS) {
+        capture->busy[index] = false;
+        altADCOverruns++;
+    }
+
+    uDMAChannelTransferSet(capture->dmaChannel | select, UDMA_MODE_PINGPONG,
+                           (void *) (capture->adcBase + ADC_O_SSFIFO3),
+                           capture->blocks[index], ALT_ADC_BLOCK_LENGTH);
+}
+
+// Checks both control structures of an ADC's uDMA channel
+static void altitudeCaptureInt(uint32_t source) {
+    altitudeCapture_t* capture = &altCapture[source];
+    BaseType_t woken = pdFALSE;
+
+    ADCIntClear(capture->adcBase, ALTITUDE_ADC_SEQ_NUM);
+
+    // A stopped control structure marks a full block
+    if (uDMAChannelModeGet(capture->dmaChannel | UDMA_PRI_SELECT) == UDMA_MODE_STOP) {
+        altitudeBlockComplete(source, 0, UDMA_PRI_SELECT, &woken);
+    }
+    if (uDMAChannelModeGet(capture->dmaChannel | UDMA_ALT_SELECT) == UDMA_MODE_STOP) {
+        altitudeBlockComplete(source, 1, UDMA_ALT_SELECT, &woken);
+    }
+    portYIELD_FROM_ISR(woken);
+}
+
+// Interrupt handler for ADC0 uDMA block completion
+void altitudeADCIntHandler (void) {
+    altitudeCaptureInt(0);
+}
+
+#if ALT_ADC_DUAL
+// Interrupt handler for ADC1 uDMA block completion
+void altitudeADC1IntHandler (void) {
+    altitudeCaptureInt(1);
+}
+#endif
+
+// Hands a block back to the uDMA once its samples have been used
+void altitudeReleaseBlock(const altitudeADCBlock_t* block) {
+    altCapture[block->source].busy[block->index] = false;
+}
+
+// Number of blocks lost, overwritten before being released or
+// dropped for lack of a partner from the other ADC
+uint32_t altitudeGetOverruns(void) {
+#if ALT_ADC_DUAL
+    return altADCOverruns + altUnpaired;
+#else
+    return altADCOverruns;
+#endif
+}
+#else
 // Interrupt handler for ADC conversion completion
 void altitudeADCIntHandler (void) {
     // Get value
@@ -46,113 +197,503 @@ void altitudeADCIntHandler (void) {
     ADCIntClear(ALTITUDE_ADC_BASE, ALTITUDE_ADC_SEQ_NUM);
 }
 
-// Main altitude task. Calculates the current altitude and sends
-// current position to a queue for the PID controller to consume
+// Blocks are not used without uDMA
+uint32_t altitudeGetOverruns(void) {
+    return 0;
+}
+#endif
+
+#if ALT_ADC_USE_UDMA && ALT_ADC_DUAL
+// Waits for blocks from both ADCs covering the same period and
+// interleaves them. ADC1 samples half a period after ADC0, so
+// alternating the two keeps the stream in time order. Only this
+// task touches the pending blocks, so no locking is needed.
+static uint32_t altitudeWaitSamples(const uint32_t** samples, TickType_t wait) {
+    altitudeADCBlock_t block;
+    while (xQueueReceive(xAltitudeADCQueue, (void *) &block, wait) == pdPASS) {
+        altitudeADCBlock_t* a = &altPendingBlock[0];
+        altitudeADCBlock_t* b = &altPendingBlock[1];
+
+        // A newer block from the same ADC replaces an unpaired one
+        if (altPendingBlock[block.source].length > 0) {
+            altitudeReleaseBlock(&altPendingBlock[block.source]);
+            altUnpaired++;
+        }
+        altPendingBlock[block.source] = block;
+        if (a->length == 0 || b->length == 0) {
+            continue;
+        }
+
+        if (a->sequence == b->sequence) {
+            uint32_t i;
+            for (i = 0; i < ALT_ADC_BLOCK_LENGTH; i++) {
+                altMergedSamples[2 * i] = a->samples[i];
+                altMergedSamples[2 * i + 1] = b->samples[i];
+            }
+            altitudeReleaseBlock(a);
+            altitudeReleaseBlock(b);
+            a->length = 0;
+            b->length = 0;
+            *samples = altMergedSamples;
+            return ALT_ADC_COUNT * ALT_ADC_BLOCK_LENGTH;
+        }
+
+        // The older block's partner was lost, drop it
+        altitudeADCBlock_t* older = ((int32_t) (a->sequence - b->sequence) < 0) ? a : b;
+        altitudeReleaseBlock(older);
+        older->length = 0;
+        altUnpaired++;
+    }
+    return 0;
+}
+
+// Blocks are released as soon as they are merged
+static void altitudeDoneSamples(void) {
+}
+#elif ALT_ADC_USE_UDMA
+// Waits for the next full block and returns its samples in place.
+// altitudeDoneSamples hands the block back to the uDMA.
+static uint32_t altitudeWaitSamples(const uint32_t** samples, TickType_t wait) {
+    if(xQueueReceive(xAltitudeADCQueue, (void *) &altCurrentBlock, wait) != pdPASS) {
+        altCurrentBlock.length = 0;
+        return 0;
+    }
+    *samples = altCurrentBlock.samples;
+    return altCurrentBlock.length;
+}
+
+// Releases the samples returned by altitudeWaitSamples
+static void altitudeDoneSamples(void) {
+    if (altCurrentBlock.length > 0) {
+        altitudeReleaseBlock(&altCurrentBlock);
+        altCurrentBlock.length = 0;
+    }
+}
+#else
+// Waits for the first sample, then takes any others already queued
+static uint32_t altitudeWaitSamples(const uint32_t** samples, TickType_t wait) {
+    uint32_t count = 0;
+    while (count < ALT_ADC_QUEUE_LENGTH &&
+           xQueueReceive(xAltitudeADCQueue, (void *) &altADCSamples[count], wait) == pdPASS) {
+        count++;
+        wait = 0;
+    }
+    *samples = altADCSamples;
+    return count;
+}
+
+// Samples are copied off the queue, nothing to release
+static void altitudeDoneSamples(void) {
+}
+#endif
+
+// Main altitude task. Filters the ADC samples, calculates the current
+// altitude and sends current position to a queue for the PID controller
+// to consume
 void altitudeAvgTask(void *ptr) {
-    circBuf_t altitudeADCBuffer;
-    uint32_t buffer[ALT_ADC_BUF_LENGTH];
-    altitudeADCBuffer.size = ALT_ADC_BUF_LENGTH;
-    altitudeADCBuffer.data = buffer;
-    altitudeADCBuffer.windex = 0;
-    altitudeADCBuffer.rindex = 0;
+    static filterChain_t altitudeFilter;
+    if (!filterInit(&altitudeFilter, altFilterConfig,
+                    sizeof(altFilterConfig) / sizeof(altFilterConfig[0]))) {
+        uartSend("altFilterFail\r\n");
+        while(1);
+    }
 
-    // Find ADC value for 0% and 100% height
-    const uint32_t altADCValueAt0 = altitudeFindADCValueAt0(&altitudeADCBuffer);
-    const uint32_t altADCValueAt100 = altADCValueAt0 - ALT_ADC_SWING;
+    estimatorHandle_t altitudeEstimate;
+
+    // Find ADC value for 0% height, start the filter and estimator there
+    altitudeCalibrate();
+    filterReset(&altitudeFilter, altCalibration.mean);
+    altitudeInitScale(altCalibration.mean);
+#if ALT_CMP_ENABLE
+    altitudeInitLimits(altCalibration.mean);
+    uint32_t reportedCeilings = 0;
+#endif
+    estimatorInit(&altitudeEstimate, ALT_EST_ALPHA, ALT_EST_BETA, 0);
+    uint32_t reportedOverruns = 0;
+    TickType_t reportedAt = xTaskGetTickCount();
+#if ALT_NOTCH_ENABLE
+    uint32_t notchDuty = 0;
+#endif
 
     while (1) {
-        int32_t avgAltitudeADCValue;
-        int32_t avgAltitudePcnt;
-        uint32_t ADCValue;
-
-        // Get the ADC value from the queue when ready
-        while(uxQueueMessagesWaiting(xAltitudeADCQueue) > 0) {
-            if(xQueueReceive(xAltitudeADCQueue, (void *) &ADCValue, (TickType_t) 10) != pdPASS) {
-                uartSend("altADCRxFail\r\n");
+        altitudeMessage_t measured;
+        const uint32_t* samples;
+        uint32_t count;
+        uint32_t i;
+
+#if ALT_ADC_USE_UDMA
+        // Woken once per full block
+        count = altitudeWaitSamples(&samples, portMAX_DELAY);
+#else
+        // Take whatever has been queued since the last update
+        count = altitudeWaitSamples(&samples, 0);
+#endif
+#if ALT_NOTCH_ENABLE
+        // Move the notch when the commanded rotor speed changes
+        uint32_t duty = pwmGetMainDuty();
+        if (duty != notchDuty) {
+            notchDuty = duty;
+            filterSetNotch(&altitudeFilter, altitudeRotorFreq(duty), ALT_ADC_STREAM_RATE_HZ);
+        }
+#endif
+        // Pass the ADC values through the filter pipeline and update the
+        // estimate with each altitude (percent, Q8) that comes out of it
+        for (i = 0; i < count; i++) {
+            if (filterProcess(&altitudeFilter, samples[i])) {
+                estimatorUpdate(&altitudeEstimate,
+                                altitudeScale(altitudeFilter.output) << (ESTIMATOR_FRAC_BITS - ALT_FRAC_BITS));
             }
-            // Write the ADC values to the circular buffer
-            writeCircBuf (&altitudeADCBuffer, ADCValue);
         }
+        altitudeDoneSamples();
 
-        // Calculate average ADCvalue
-        avgAltitudeADCValue = calcAvgAltADC(&altitudeADCBuffer);
+        // Report any lost sample blocks, at most once per report period
+        if (altitudeGetOverruns() != reportedOverruns &&
+            xTaskGetTickCount() - reportedAt >= ALT_OVERRUN_REPORT_MS / portTICK_RATE_MS) {
+            char str[24];
+            reportedOverruns = altitudeGetOverruns();
+            reportedAt = xTaskGetTickCount();
+            usprintf(str, "altOverrun %d\r\n", reportedOverruns);
+            uartSend(str);
+        }
+
+        // Round the estimated altitude to whole percent, and scale velocity
+        // from per update to per second. Send both to the mailbox to be
+        // processed by the PID controller. Never blocks, the newest value
+        // replaces one nobody has read.
+        measured.altitude = (altitudeEstimate.position + (1 << (ESTIMATOR_FRAC_BITS - 1))) >> ESTIMATOR_FRAC_BITS;
+        if (measured.altitude < ALT_GROUND_DEADBAND) {measured.altitude = 0;}
+        measured.velocity = (int32_t) (((int64_t) altitudeEstimate.velocity * ALT_EST_RATE_HZ)
+                                       >> (ESTIMATOR_FRAC_BITS - ALT_FRAC_BITS));
 
-        // Calculate altitude percentage and send it to the queue to be processed by the PID controller
-        avgAltitudePcnt = 100 * (altADCValueAt0 - avgAltitudeADCValue) / (altADCValueAt0 - altADCValueAt100);
-        if (avgAltitudePcnt > 250 || avgAltitudePcnt < 5) {avgAltitudePcnt = 0;}
+        xQueueOverwrite(xMeasuredAltitudeQueue, (void *) &measured);
 
-        xQueueSend(xMeasuredAltitudeQueue, (void *) &avgAltitudePcnt, (TickType_t) 10);
+#if ALT_CMP_ENABLE
+        // Lift the main duty cap once back under the ceiling. The
+        // comparator interrupt is masked so a new crossing cannot cap
+        // between the flag and the limit being cleared.
+        if (altLimitStats.capped && measured.altitude < ALT_CMP_RELEASE_PCNT) {
+            IntDisable(ALTITUDE_CMP_INT_GROUP);
+            altLimitStats.capped = false;
+            pwmLimitMain(MAIN_MAX_DUTY);
+            IntEnable(ALTITUDE_CMP_INT_GROUP);
+        }
+        if (altLimitStats.ceilingEvents != reportedCeilings) {
+            char str[32];
+            reportedCeilings = altLimitStats.ceilingEvents;
+            usprintf(str, "altCeiling %d %dcyc\r\n", reportedCeilings, altLimitStats.lastLatency);
+            uartSend(str);
+        }
+#endif
+#if !ALT_ADC_USE_UDMA
         // Task delay
         vTaskDelay(ALTITUDE_DELAY/ portTICK_RATE_MS);
+#endif
     }
 
 }
 
-// Initalise the altitude adc buffer.
-// Fill for first time and return initial average value
-uint32_t altitudeFindADCValueAt0(circBuf_t* altitudeADCBuffer) {
-    int i;
-    uint32_t ADCValue;
-    uint32_t maxInitialValue;
-    for(i = 0; i <= 10*ALT_ADC_BUF_LENGTH; i++) {
-        // Trigger the sample
-        ADCProcessorTrigger(ADC0_BASE, ALTITUDE_ADC_SEQ_NUM);
-        // Wait for the sample to be sent to the queue
-        while(uxQueueMessagesWaiting(xAltitudeADCQueue) == 0) {}
-        // Get the sample
-        if(xQueueReceive(xAltitudeADCQueue, (void *) &ADCValue, (TickType_t) 10) != pdPASS) {
-            uartSend("altADCRxFail\r\n");
+// Finds the ADC value at 0% altitude. Blocks until samples arrive and
+// keeps running sums for the mean and variance. Stops once the standard
+// error of the mean is below 1/ALT_CAL_SEM_DIV counts, or after
+// ALT_CAL_MAX_SAMPLES samples.
+void altitudeCalibrate(void) {
+    const TickType_t start = xTaskGetTickCount();
+    uint64_t sum = 0;
+    uint64_t sumSquares = 0;
+    uint64_t n = 0;
+    uint64_t spread = 0;    // n^2 * variance
+
+    altCalibration.converged = false;
+    while (n < ALT_CAL_MAX_SAMPLES && !altCalibration.converged) {
+        const uint32_t* samples;
+        uint32_t count = altitudeWaitSamples(&samples, portMAX_DELAY);
+        uint32_t i;
+        for (i = 0; i < count; i++) {
+            sum += samples[i];
+            sumSquares += (uint64_t) samples[i] * samples[i];
         }
-        if (ADCValue > maxInitialValue) {
-            maxInitialValue = ADCValue;
+        altitudeDoneSamples();
+        n += count;
+
+        // sem^2 = variance / n, so sem < 1/DIV when
+        // n^2 * variance * DIV^2 < n^3
+        if (n >= ALT_CAL_MIN_SAMPLES) {
+            spread = n * sumSquares - sum * sum;
+            altCalibration.converged =
+                    spread * ALT_CAL_SEM_DIV * ALT_CAL_SEM_DIV < n * n * n;
         }
-        writeCircBuf(altitudeADCBuffer, ADCValue);
-   }
-   return maxInitialValue;
+    }
+
+    altCalibration.mean = (sum + n / 2) / n;
+    altCalibration.variance = spread / (n * n);
+    altCalibration.samples = n;
+    altCalibration.durationMs = (xTaskGetTickCount() - start) * portTICK_RATE_MS;
+
+    char str[40];
+    usprintf(str, "altCal %d in %dms (%d)\r\n", altCalibration.mean,
+             altCalibration.durationMs, altCalibration.samples);
+    uartSend(str);
 }
 
-// Calculate the average value of the buffer
-uint32_t calcAvgAltADC(circBuf_t* altBuf) {
-    uint32_t sum = 0;
-    // find the sum of the circular buffer
-    int i;
-    for (i = 0; i < ALT_ADC_BUF_LENGTH; i++) {
-        sum += readCircBuf(altBuf);
+// Result of the last ground calibration
+const altitudeCalibration_t* altitudeGetCalibration(void) {
+    return &altCalibration;
+}
+
+#if ALT_NOTCH_ENABLE
+// Rotor vibration frequency (Hz, Q4) at a main duty, interpolated
+// between the 10% steps of altRotorFreqTable
+uint32_t altitudeRotorFreq(uint32_t duty) {
+    if (duty >= 100) {
+        return altRotorFreqTable[10];
     }
-    // Calculate the rounded mean of the buffer contents
-    return  (2 * sum + ALT_ADC_BUF_LENGTH) / 2 / ALT_ADC_BUF_LENGTH;
+    uint32_t index = duty / 10;
+    uint32_t frac = duty % 10;
+    return altRotorFreqTable[index] +
+           ((altRotorFreqTable[index + 1] - altRotorFreqTable[index]) * frac) / 10;
 }
+#endif
 
-// Altitude ADC initialization function
-void altitudeInitADC (void) {
-    // The ADC0 peripheral must be enabled for configuration and use.
-    SysCtlPeripheralEnable(ALTITUDE_ADC_PERIPH);
+// Precomputes the ADC to altitude mapping for the calibrated ground value
+void altitudeInitScale(uint32_t adcAt0) {
+    altADCValueAt0 = adcAt0;
+#if !ALT_SCALE_USE_LUT
+    altScaleRecip = ((100 << ALT_FRAC_BITS) << ALT_RECIP_BITS) / ALT_ADC_SWING;
+#endif
+}
+
+#if ALT_CMP_ENABLE
+// Sets the comparator thresholds from the calibrated ground value and
+// starts the limit comparators. Each comparator interrupts once on
+// entering its band and re-arms when the value leaves it.
+void altitudeInitLimits(uint32_t adcAt0) {
+    const uint32_t ceilingADC = adcAt0 - ALT_CMP_CEILING_PCNT * ALT_ADC_SWING / 100;
+    const uint32_t floorADC = adcAt0 - ALT_CMP_FLOOR_PCNT * ALT_ADC_SWING / 100;
+
+    ADCSequenceConfigure(ALTITUDE_ADC_BASE, ALTITUDE_CMP_SEQ_NUM,
+                         ALTITUDE_TIMER_TRIGGER, ALTITUDE_CMP_PRIORITY);
+
+    // Ceiling: ADC value falls below the threshold as the heli rises
+    ADCComparatorConfigure(ALTITUDE_ADC_BASE, ALTITUDE_CMP_CEILING, ADC_COMP_INT_LOW_HONCE);
+    ADCComparatorRegionSet(ALTITUDE_ADC_BASE, ALTITUDE_CMP_CEILING, ceilingADC, ceilingADC);
+    ADCComparatorReset(ALTITUDE_ADC_BASE, ALTITUDE_CMP_CEILING, true, true);
+
+    // Floor: ADC value rises above the threshold as the heli drops
+    ADCComparatorConfigure(ALTITUDE_ADC_BASE, ALTITUDE_CMP_FLOOR, ADC_COMP_INT_HIGH_HONCE);
+    ADCComparatorRegionSet(ALTITUDE_ADC_BASE, ALTITUDE_CMP_FLOOR, floorADC, floorADC);
+    ADCComparatorReset(ALTITUDE_ADC_BASE, ALTITUDE_CMP_FLOOR, true, true);
+
+    // Both steps go to a comparator, not the FIFO
+    ADCSequenceStepConfigure(ALTITUDE_ADC_BASE, ALTITUDE_CMP_SEQ_NUM, 0,
+                             ALTITUDE_ADC_CHANNEL | ADC_CTL_CMP0);
+    ADCSequenceStepConfigure(ALTITUDE_ADC_BASE, ALTITUDE_CMP_SEQ_NUM, 1,
+                             ALTITUDE_ADC_CHANNEL | ADC_CTL_CMP1 | ADC_CTL_END);
+
+    // The handler makes no RTOS calls, so it can sit above
+    // configMAX_SYSCALL_INTERRUPT_PRIORITY where kernel critical sections
+    // never mask it. The other handlers are still at the default 0 as
+    // well, so it can wait behind one of them but never preempts them.
+    ADCIntRegister(ALTITUDE_ADC_BASE, ALTITUDE_CMP_SEQ_NUM, altitudeLimitIntHandler);
+    IntPrioritySet(ALTITUDE_CMP_INT_GROUP, 0);
+    ADCComparatorIntClear(ALTITUDE_ADC_BASE, 0xff);
+    ADCComparatorIntEnable(ALTITUDE_ADC_BASE, ALTITUDE_CMP_SEQ_NUM);
+    ADCSequenceEnable(ALTITUDE_ADC_BASE, ALTITUDE_CMP_SEQ_NUM);
+}
+
+// Interrupt handler for the altitude limit comparators. Caps the main
+// duty straight away on a ceiling crossing and records how long after
+// the triggering conversion started that took effect.
+void altitudeLimitIntHandler(void) {
+    uint32_t status = ADCComparatorIntStatus(ALTITUDE_ADC_BASE);
+    ADCComparatorIntClear(ALTITUDE_ADC_BASE, status);
+    // The sequence level DCINSS bit is separate, left set it would
+    // keep the interrupt asserted
+    ADCIntClearEx(ALTITUDE_ADC_BASE, ALTITUDE_CMP_INT_FLAG);
+
+    if (status & (1 << ALTITUDE_CMP_CEILING)) {
+        pwmLimitMain(ALT_CMP_CEILING_DUTY);
+
+        // The sample timer counts down from its load value after each trigger
+        uint32_t latency = TimerLoadGet(ALTITUDE_TIMER_BASE, ALTITUDE_TIMER)
+                         - TimerValueGet(ALTITUDE_TIMER_BASE, ALTITUDE_TIMER);
+        altLimitStats.lastLatency = latency;
+        if (latency > altLimitStats.maxLatency) {
+            altLimitStats.maxLatency = latency;
+        }
+        altLimitStats.capped = true;
+        altLimitStats.ceilingEvents++;
+    }
+    if (status & (1 << ALTITUDE_CMP_FLOOR)) {
+        altLimitStats.floorEvents++;
+    }
+}
+#endif
+
+// Altitude limit comparator events and latency
+const altitudeLimitStats_t* altitudeGetLimitStats(void) {
+    return (const altitudeLimitStats_t*) &altLimitStats;
+}
+
+// Altitude (percent, Q ALT_FRAC_BITS) for a filtered ADC value.
+// The ADC value falls as the heli rises.
+int32_t altitudeScale(int32_t adc) {
+    int32_t offset = altADCValueAt0 - adc;
+    int32_t altitude;
+    if (offset <= 0) {
+        return 0;
+    }
+#if ALT_SCALE_USE_LUT
+    // Linear interpolation between the two nearest table entries
+    uint32_t index = offset >> ALT_LUT_STEP_BITS;
+    if (index >= ALT_LUT_LENGTH - 1) {
+        return ALT_PCNT_LIMIT << ALT_FRAC_BITS;
+    }
+    int32_t frac = offset & ((1 << ALT_LUT_STEP_BITS) - 1);
+    altitude = altScaleTable[index] +
+            (((altScaleTable[index + 1] - altScaleTable[index]) * frac) >> ALT_LUT_STEP_BITS);
+#else
+    altitude = ((int64_t) offset * altScaleRecip) >> ALT_RECIP_BITS;
+#endif
+    if (altitude > (ALT_PCNT_LIMIT << ALT_FRAC_BITS)) {
+        altitude = ALT_PCNT_LIMIT << ALT_FRAC_BITS;
+    }
+    return altitude;
+}
+
+// Configures sequence 3 of an ADC to convert the altitude channel
+// on the given trigger, interrupting when each sample is acquired
+static void altitudeInitSequence(uint32_t periph, uint32_t base, uint32_t trigger, void (*handler)(void)) {
+    // The ADC peripheral must be enabled for configuration and use.
+    SysCtlPeripheralEnable(periph);
 
     // Wait for peripheral to be ready
-    while(!SysCtlPeripheralReady(ALTITUDE_ADC_PERIPH));
+    while(!SysCtlPeripheralReady(periph));
+
+    // Average several conversions in hardware for each result
+    // written to the sequence FIFO.
+    ADCHardwareOversampleConfigure(base, ALT_ADC_HW_OVERSAMPLE);
 
-    // Configure altitude ADC sample sequence using
-    // processor trigger. This converts a single sample each time
-    // the processor triggers the ADC with priority 0.
-    ADCSequenceConfigure(ALTITUDE_ADC_BASE,
-                         ALTITUDE_ADC_SEQ_NUM,
-                         ALTITUDE_ADC_TRIGGER,
-                         ALTITUDE_ADC_PRIORITY);
+    // Configure altitude ADC sample sequence. A single sample is
+    // converted each time with priority 0.
+    ADCSequenceConfigure(base, ALTITUDE_ADC_SEQ_NUM, trigger, ALTITUDE_ADC_PRIORITY);
 
     // Configure altitude ADC step on sequence: ALTITUDE_ADC_SEQ_NUM.
     // ADC_CTL_IE configures the ADC to trigger an interrupt
     // when each sample is acquired.
-    ADCSequenceStepConfigure(ALTITUDE_ADC_BASE,
+    ADCSequenceStepConfigure(base,
                              ALTITUDE_ADC_SEQ_NUM,
                              ALTITUDE_ADC_STEP,
                              ALTITUDE_ADC_CHANNEL | ADC_CTL_IE | ADC_CTL_END);
 
     // Register the interrupt handler for the sequence step configured above
-    ADCIntRegister (ALTITUDE_ADC_BASE, ALTITUDE_ADC_SEQ_NUM, altitudeADCIntHandler);
+    ADCIntRegister (base, ALTITUDE_ADC_SEQ_NUM, handler);
 
     // Enable altitude ADC sample sequence
-    ADCSequenceEnable(ALTITUDE_ADC_BASE, ALTITUDE_ADC_SEQ_NUM);
+    ADCSequenceEnable(base, ALTITUDE_ADC_SEQ_NUM);
+
+    // Enable interrupts for sequence 3 (clears any outstanding interrupts)
+    ADCIntEnable(base, ALTITUDE_ADC_SEQ_NUM);
+}
+
+// Altitude ADC initialization function. With ALT_ADC_TIMER_TRIGGER
+// the sample timer starts each ADC0 conversion, otherwise the
+// processor triggers the ADC.
+void altitudeInitADC (void) {
+#if ALT_ADC_TIMER_TRIGGER
+    altitudeInitSequence(ALTITUDE_ADC_PERIPH, ALTITUDE_ADC_BASE,
+                         ALTITUDE_TIMER_TRIGGER, altitudeADCIntHandler);
+#else
+    altitudeInitSequence(ALTITUDE_ADC_PERIPH, ALTITUDE_ADC_BASE,
+                         ALTITUDE_ADC_TRIGGER, altitudeADCIntHandler);
+#endif
+#if ALT_ADC_DUAL
+    altitudeInitSequence(ALTITUDE_ADC1_PERIPH, ALTITUDE_ADC1_BASE,
+                         ALTITUDE_ADC1_TRIGGER, altitudeADC1IntHandler);
+#endif
+
+#if ALT_ADC_USE_UDMA
+    altitudeInitDMA();
+#endif
+#if ALT_ADC_TIMER_TRIGGER
+    altitudeInitTimer();
+#endif
+}
+
+#if ALT_ADC_USE_UDMA
+// Sets up the uDMA to copy each sequence 3 result into the ping-pong
+// blocks. The ADC interrupt then only fires once per full block.
+void altitudeInitDMA (void) {
+    uint32_t i;
+
+    SysCtlPeripheralEnable(ALTITUDE_DMA_PERIPH);
+    while(!SysCtlPeripheralReady(ALTITUDE_DMA_PERIPH));
+
+    uDMAEnable();
+    uDMAControlBaseSet(uDMAControlTable);
+#if ALT_ADC_DUAL
+    // ADC1 sequence 3 is not the default peripheral on its channel
+    uDMAChannelAssign(ALTITUDE_DMA1_ASSIGN);
+#endif
+
+    for (i = 0; i < ALT_ADC_COUNT; i++) {
+        altitudeCapture_t* capture = &altCapture[i];
+        void* src = (void *) (capture->adcBase + ADC_O_SSFIFO3);
+
+        // Start from a known channel state
+        uDMAChannelAttributeDisable(capture->dmaChannel,
+                                    UDMA_ATTR_ALTSELECT | UDMA_ATTR_USEBURST |
+                                    UDMA_ATTR_HIGH_PRIORITY | UDMA_ATTR_REQMASK);
+
+        // One 32 bit word per request from the FIFO into the next block slot
+        uDMAChannelControlSet(capture->dmaChannel | UDMA_PRI_SELECT,
+                              UDMA_SIZE_32 | UDMA_SRC_INC_NONE | UDMA_DST_INC_32 | UDMA_ARB_1);
+        uDMAChannelControlSet(capture->dmaChannel | UDMA_ALT_SELECT,
+                              UDMA_SIZE_32 | UDMA_SRC_INC_NONE | UDMA_DST_INC_32 | UDMA_ARB_1);
+        uDMAChannelTransferSet(capture->dmaChannel | UDMA_PRI_SELECT, UDMA_MODE_PINGPONG,
+                               src, capture->blocks[0], ALT_ADC_BLOCK_LENGTH);
+        uDMAChannelTransferSet(capture->dmaChannel | UDMA_ALT_SELECT, UDMA_MODE_PINGPONG,
+                               src, capture->blocks[1], ALT_ADC_BLOCK_LENGTH);
+
+        uDMAChannelEnable(capture->dmaChannel);
+        ADCSequenceDMAEnable(capture->adcBase, ALTITUDE_ADC_SEQ_NUM);
+    }
+}
+#endif
+
+// Altitude sample timer initialization function. Configures the timer
+// to trigger an ADC conversion every 1/ALT_ADC_SAMPLE_RATE_HZ seconds.
+void altitudeInitTimer (void) {
+    SysCtlPeripheralEnable(ALTITUDE_TIMER_PERIPH);
+    while(!SysCtlPeripheralReady(ALTITUDE_TIMER_PERIPH));
+
+    // Full width periodic timer
+    TimerConfigure(ALTITUDE_TIMER_BASE, TIMER_CFG_PERIODIC);
+    TimerLoadSet(ALTITUDE_TIMER_BASE, ALTITUDE_TIMER,
+                 SysCtlClockGet() / ALT_ADC_SAMPLE_RATE_HZ - 1);
+
+    // Timeout event triggers the ADC sequence, no timer interrupt is used
+    TimerControlTrigger(ALTITUDE_TIMER_BASE, ALTITUDE_TIMER, true);
+
+#if ALT_ADC_DUAL
+    // Every timer trigger reaches every ADC, so ADC1 is triggered by a
+    // spare PWM generator counting down over the same period instead.
+    // Both count the same system clock, so the phase does not drift.
+    const uint32_t pwmPeriod = SysCtlClockGet() / PWM_CLOCK_DIVISOR / ALT_ADC_SAMPLE_RATE_HZ;
+    SysCtlPeripheralEnable(ALTITUDE_PWM_TRIG_PERIPH);
+    while(!SysCtlPeripheralReady(ALTITUDE_PWM_TRIG_PERIPH));
+    SysCtlPWMClockSet(PWM_CLOCK_DIV);
+    PWMGenConfigure(ALTITUDE_PWM_TRIG_BASE, ALTITUDE_PWM_TRIG_GEN,
+                    PWM_GEN_MODE_DOWN | PWM_GEN_MODE_NO_SYNC);
+    PWMGenPeriodSet(ALTITUDE_PWM_TRIG_BASE, ALTITUDE_PWM_TRIG_GEN, pwmPeriod);
+    PWMGenIntTrigEnable(ALTITUDE_PWM_TRIG_BASE, ALTITUDE_PWM_TRIG_GEN, PWM_TR_CNT_ZERO);
 
-    // Enable interrupts for ADC0 sequence 3 (clears any outstanding interrupts)
-    ADCIntEnable(ALTITUDE_ADC_BASE, ALTITUDE_ADC_SEQ_NUM);
+    // Start the generator half way through a timer period so ADC1
+    // samples half way between ADC0 samples
+    TimerEnable(ALTITUDE_TIMER_BASE, ALTITUDE_TIMER);
+    while (TimerValueGet(ALTITUDE_TIMER_BASE, ALTITUDE_TIMER) >
+           TimerLoadGet(ALTITUDE_TIMER_BASE, ALTITUDE_TIMER) / 2);
+    PWMGenEnable(ALTITUDE_PWM_TRIG_BASE, ALTITUDE_PWM_TRIG_GEN);
+#else
+    TimerEnable(ALTITUDE_TIMER_BASE, ALTITUDE_TIMER);
+#endif
 }
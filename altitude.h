@@ -9,34 +9,132 @@
  ENCE 464 Group 13
  altitude.h
 
- Interrupt driven collection of altitude adc values. Inserts
- adc values into a circular buffer and calculates an average. Converts
- Average into an altitude percentage between 0 and 100 and adds to
- altitue queue
+ Interrupt driven collection of altitude adc values. Passes
+ adc values through a filter pipeline (see filter.h). Converts
+ Average into an altitude percentage between 0 and 100, estimates
+ vertical velocity and adds both to altitue queue
 ----------------------------------------------------------------*/
 
 #ifndef ALTITUDE_H_
 #define ALTITUDE_H_
 
 /* Includes -----------------------------------------*/
-#include "circBufT.h"
+#include "filter.h"
+#include "estimator.h"
 /*--------------------------------------------------------------*/
 
 /* Definitions -------------------------------------------------*/
 // Altitude scaling factors
 #define ALT_ADC_SWING        800 // Number of adc points between 0% and 100%
 #define ALT_ADC_NOISE_MARGIN 100
+#define ALT_FRAC_BITS        8   // Altitude is scaled in percent, Q8
+#define ALT_RECIP_BITS       16  // Fraction bits of the precomputed reciprocal
+#define ALT_GROUND_DEADBAND  5   // Readings below this percent are treated as landed
+#define ALT_PCNT_LIMIT       120 // Readings are clamped to this percent
+// 1: map ADC to altitude through altScaleTable to correct sensor
+//    non-linearity. 0: linear mapping over ALT_ADC_SWING.
+#define ALT_SCALE_USE_LUT    0
+#define ALT_LUT_STEP_BITS    7   // Table entries every 128 ADC counts above ground
+#define ALT_LUT_LENGTH       9
 // Altitude setting constants
 #define ALT_TARGET_MAX       100
 #define ALT_TARGET_MIN       0
 #define ALT_TARGET_STEP      10
 // Altitude ADC parameters
 #define ALTITUDE_DELAY        7  // ms between averaging
-#define ALT_ADC_BUF_LENGTH    10
-#define ALT_ADC_SAMPLE_DELAY  2  // ms between samples. 4ms = 250Hz
+#define ALT_ADC_BUF_LENGTH    10 // Boxcar window, up to FILTER_BOXCAR_MAX. Cost per sample does not grow with length
+#define ALT_ADC_SAMPLE_RATE_HZ  500 // ADC sample rate
+#define ALT_ADC_SAMPLE_DELAY  (1000 / ALT_ADC_SAMPLE_RATE_HZ) // ms between samples
+// 1: Timer0A triggers the ADC in hardware, no sampling task is run.
+// 0: altitudeADCSamplingTask triggers each conversion from software.
+#define ALT_ADC_TIMER_TRIGGER 1
+// Hardware averaging (SAC) factor. Each result is the mean of this many
+// conversions. Must be 1 (off), 2, 4, 8, 16, 32 or 64.
+#define ALT_ADC_HW_OVERSAMPLE 4
+// 1: uDMA copies samples into two blocks in ping-pong mode and
+// altitudeAvgTask is woken once per full block. Needs ALT_ADC_TIMER_TRIGGER.
+#define ALT_ADC_USE_UDMA      1
+#define ALT_ADC_BLOCK_LENGTH  4  // Samples per block. Sets the altitude update rate
+#define ALT_ADC_QUEUE_LENGTH  12 // Queue depth for single samples
+#define ALT_OVERRUN_REPORT_MS 1000 // Shortest time between overrun reports
+// 1: ADC1 also samples the altitude channel, half a sample period after
+// ADC0. The two block streams are interleaved, doubling the sample rate.
+// Needs ALT_ADC_USE_UDMA.
+#define ALT_ADC_DUAL          0
+#define ALT_ADC_COUNT         (ALT_ADC_DUAL ? 2 : 1)
+#define ALT_ADC_STREAM_RATE_HZ (ALT_ADC_SAMPLE_RATE_HZ * ALT_ADC_COUNT) // Merged sample rate
+
+// Rotor vibration notch. The centre follows the commanded main duty
+// through altRotorFreqTable
+#define ALT_NOTCH_ENABLE      1
+#define ALT_NOTCH_RADIUS      15565 // Pole radius 0.95 (Q14), about 8Hz wide at 500Hz
+
+// Vertical velocity estimator, run on every filter output
+#define ALT_EST_RATE_HZ       ALT_ADC_STREAM_RATE_HZ // Filter output rate (divide by any decimation)
+#define ALT_EST_ALPHA         3277 // 0.1 (Q15)
+#define ALT_EST_BETA          172  // alpha^2 / (2 - alpha), critically damped (Q15)
+
+// Altitude limit comparators. Crossing the ceiling caps the main duty
+// from the comparator interrupt, crossing the floor is counted.
+#define ALT_CMP_ENABLE        1
+#define ALT_CMP_CEILING_PCNT  105
+#define ALT_CMP_FLOOR_PCNT    ALT_GROUND_DEADBAND
+#define ALT_CMP_CEILING_DUTY  20  // Main duty cap above the ceiling
+#define ALT_CMP_RELEASE_PCNT  95  // Cap is lifted once back below this
+
+// Ground calibration
+#define ALT_CAL_MIN_SAMPLES   32   // Samples before the estimate may be accepted
+#define ALT_CAL_MAX_SAMPLES   1024 // Give up refining after this many samples
+#define ALT_CAL_SEM_DIV       4    // Stop at a standard error of 1/4 ADC count
+
+#if ALT_ADC_USE_UDMA && !ALT_ADC_TIMER_TRIGGER
+#error "ALT_ADC_USE_UDMA requires ALT_ADC_TIMER_TRIGGER"
+#endif
+#if ALT_ADC_DUAL && !ALT_ADC_USE_UDMA
+#error "ALT_ADC_DUAL requires ALT_ADC_USE_UDMA"
+#endif
+#if ALT_CMP_ENABLE && !ALT_ADC_TIMER_TRIGGER
+#error "ALT_CMP_ENABLE requires ALT_ADC_TIMER_TRIGGER"
+#endif
 
 /*--------------------------------------------------------------*/
 
+/* Type Definitions --------------------------------------------*/
+// A completed uDMA block of ADC samples. The samples stay in the
+// capture buffer until the block is released.
+typedef struct altitudeADCBlock_t {
+    const uint32_t* samples;
+    uint32_t length;
+    uint32_t index;         // Ping-pong buffer the block belongs to
+    uint32_t source;        // ADC the block came from
+    uint32_t sequence;      // Count of blocks completed by that ADC
+} altitudeADCBlock_t;
+
+// Measured altitude, sent to xMeasuredAltitudeQueue
+typedef struct altitudeMessage_t {
+    int32_t altitude;       // Percent
+    int32_t velocity;       // Percent per second (Q ALT_FRAC_BITS)
+} altitudeMessage_t;
+
+// Ground calibration statistics
+typedef struct altitudeCalibration_t {
+    uint32_t mean;          // ADC value at 0% altitude
+    uint32_t variance;      // Sample variance (ADC counts^2)
+    uint32_t samples;       // Samples used
+    uint32_t durationMs;    // Time taken to calibrate
+    bool converged;         // False if ALT_CAL_MAX_SAMPLES was reached
+} altitudeCalibration_t;
+
+// Altitude limit comparator events
+typedef struct altitudeLimitStats_t {
+    uint32_t ceilingEvents;
+    uint32_t floorEvents;
+    uint32_t lastLatency;   // Cycles from sample trigger to main duty cap
+    uint32_t maxLatency;
+    bool capped;            // Main duty is currently capped
+} altitudeLimitStats_t;
+/*--------------------------------------------------------------*/
+
 /* Globals -------------------------------------------------*/
 //external global queue handles
 extern QueueHandle_t xMeasuredAltitudeQueue;
@@ -47,20 +145,55 @@ extern QueueHandle_t xTelemetryQueue;
 /* Function prototypes -----------------------------------------*/
 void altitudeInitADC(void);
 
+// Sets up the timer that triggers ADC conversions in hardware
+void altitudeInitTimer(void);
+
+// Sets up the uDMA ping-pong transfer from the ADC FIFO
+void altitudeInitDMA(void);
+
+// Hands a block back to the uDMA once its samples have been used
+void altitudeReleaseBlock(const altitudeADCBlock_t* block);
+
+// Number of blocks lost or overwritten before being released
+uint32_t altitudeGetOverruns(void);
+
 // ISR to send complete ADC conversions to the queue
 void altitudeADCIntHandler(void);
 
-// Task to trigger ADC samples
+// Task to trigger ADC samples (only used without ALT_ADC_TIMER_TRIGGER)
 void altitudeADCSamplingTask(void *pvParameters);
 
 // Task to average the ADC values and send to PID controller
 void altitudeAvgTask(void *pvParameters);
 
-// Finds the ADC value at 0% altitude
-uint32_t altitudeFindADCValueAt0(circBuf_t* altitudeADCBuffer);
+// Finds the ADC value at 0% altitude from the sample statistics
+void altitudeCalibrate(void);
+
+// Result of the last ground calibration
+const altitudeCalibration_t* altitudeGetCalibration(void);
+
+// Rotor vibration frequency (Hz, Q FILTER_FREQ_BITS) at a main duty
+uint32_t altitudeRotorFreq(uint32_t duty);
+
+// Precomputes the ADC to altitude mapping for the calibrated ground value
+void altitudeInitScale(uint32_t adcAt0);
+
+// Sets the comparator thresholds from the calibrated ground value
+// and starts the limit comparators
+void altitudeInitLimits(uint32_t adcAt0);
+
+// ISR for ADC1 blocks when sampling with both ADCs
+void altitudeADC1IntHandler(void);
+
+// Interrupt handler for the altitude limit comparators
+void altitudeLimitIntHandler(void);
+
+// Altitude limit comparator events and latency
+const altitudeLimitStats_t* altitudeGetLimitStats(void);
 
-// Calculates the average ADC value from the buffer
-uint32_t calcAvgAltADC(circBuf_t* altBuf);
+// Altitude (percent, Q ALT_FRAC_BITS) for a filtered ADC value.
+// Uses the mapping from altitudeInitScale, no division.
+int32_t altitudeScale(int32_t adc);
 
 /*--------------------------------------------------------------*/
 
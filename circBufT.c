@@ -11,11 +11,28 @@
 #include "main.h"
 #include "circBufT.h"
 
+// *******************************************************
+// initCircBuf: attach the storage to the buffer, zero the
+//              entries and the running sum.
+// *******************************************************
+void initCircBuf(circBuf_t *buffer, uint32_t *data, uint32_t size) {
+    uint32_t i;
+    buffer->data = data;
+    buffer->size = size;
+    buffer->windex = 0;
+    buffer->rindex = 0;
+    buffer->sum = 0;
+    for (i = 0; i < size; i++)
+        data[i] = 0;
+}
+
 // *******************************************************
 // writeCircBuf: insert entry at the current windex location,
-//              advance windex, modulo (buffer size).
+//              advance windex, modulo (buffer size). The entry
+//              being replaced is taken out of the running sum.
 // *******************************************************
 void writeCircBuf(circBuf_t *buffer, uint32_t entry) {
+    buffer->sum += entry - buffer->data[buffer->windex];
     *(buffer->data + buffer->windex) = entry;
     buffer->windex++;
     if (buffer->windex >= buffer->size)
@@ -38,3 +55,12 @@ uint32_t readCircBuf(circBuf_t *buffer) {
     return entry;
 }
 
+
+// *******************************************************
+// meanCircBuf: return the rounded mean of all entries from the
+//              running sum. Constant time for any size, does not
+//              move rindex.
+// *******************************************************
+uint32_t meanCircBuf(circBuf_t *buffer) {
+    return (buffer->sum + buffer->size / 2) / buffer->size;
+}
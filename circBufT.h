@@ -20,12 +20,18 @@ typedef struct {
     uint32_t size;      // Number of entries in buffer
     uint32_t windex;    // index for writing, mod(size)
     uint32_t rindex;    // index for reading, mod(size)
+    uint32_t sum;       // running sum of all entries
     uint32_t *data;     // pointer to the data
 } circBuf_t;
 /*--------------------------------------------------------------*/
 
 /* Function prototypes -----------------------------------------*/
 
+// *******************************************************
+// initCircBuf: attach the storage to the buffer, zero the
+// entries and the running sum.
+void initCircBuf (circBuf_t *buffer, uint32_t *data, uint32_t size);
+
 // *******************************************************
 // writeCircBuf: insert entry at the current windex location,
 // advance windex, modulo (buffer size).
@@ -37,6 +43,11 @@ void writeCircBuf (circBuf_t *buffer, uint32_t entry);
 // if reading has advanced ahead of writing.
 uint32_t readCircBuf (circBuf_t *buffer);
 
+// *******************************************************
+// meanCircBuf: return the rounded mean of all entries from the
+// running sum. Constant time for any size, does not move rindex.
+uint32_t meanCircBuf (circBuf_t *buffer);
+
 /*--------------------------------------------------------------*/
 
 #endif /*CIRCBUFT_H_*/
@@ -24,6 +24,7 @@
 #include "pid.h"
 #include "yaw.h"
 #include "pwm.h"
+#include "altitude.h"
 /*--------------------------------------------------------------*/
 
 /* Function definitions ----------------------------------------*/
@@ -33,6 +34,8 @@
 void controlLandedTask(void *pvParameters) {
     uint8_t patternStatus1 = 0;
     uint8_t patternStatus2 = 0;
+    uint8_t patternStatus3 = 0;
+    uint8_t patternStatus4 = 0;
     pwmUpdateMessage_t pwm = {0};
     const userInputEventMessage_t pattern1[PATTERN_LENGTH] = {
                         {BUT_PUSHED, LEFT},
@@ -45,6 +48,18 @@ void controlLandedTask(void *pvParameters) {
                         {BUT_RELEASED, RIGHT},
                         {BUT_PUSHED, LEFT},
                         {BUT_RELEASED, LEFT}};
+
+    const userInputEventMessage_t pattern3[PATTERN_LENGTH] = {
+                        {BUT_PUSHED, UP},
+                        {BUT_RELEASED, UP},
+                        {BUT_PUSHED, DOWN},
+                        {BUT_RELEASED, DOWN}};
+
+    const userInputEventMessage_t pattern4[PATTERN_LENGTH] = {
+                        {BUT_PUSHED, DOWN},
+                        {BUT_RELEASED, DOWN},
+                        {BUT_PUSHED, UP},
+                        {BUT_RELEASED, UP}};
     while (1) {
         // Sustain idle
         xQueueSend(xPWMQueue, (void *) &pwm, (TickType_t) 10);
@@ -76,6 +91,24 @@ void controlLandedTask(void *pvParameters) {
                     controlStartSpecial(2);
                 }
             } else { patternStatus2 = 0; }
+
+            // Check for pattern 3
+            userInputEventMessage_t next3 = pattern3[patternStatus3];
+            if(recievedEvent.name == next3.name && recievedEvent.action == next3.action) {
+                patternStatus3++;
+                if(patternStatus3 == PATTERN_LENGTH) {
+                    controlStartSpecial(3);
+                }
+            } else { patternStatus3 = 0; }
+
+            // Check for pattern 4
+            userInputEventMessage_t next4 = pattern4[patternStatus4];
+            if(recievedEvent.name == next4.name && recievedEvent.action == next4.action) {
+                patternStatus4++;
+                if(patternStatus4 == PATTERN_LENGTH) {
+                    controlStartSpecial(4);
+                }
+            } else { patternStatus4 = 0; }
         }
 
         // Task delay
@@ -99,8 +132,9 @@ void controlFlyingTask(void *yawInitial) {
             // Get the user input event
             userInputEventMessage_t recievedEvent;
             xQueueReceive(xUserInputEventQueue, &recievedEvent, 5);
-            // Check for user change to flying mode
-            if(recievedEvent.name == SW1 && recievedEvent.action == SWITCHED_OFF) {
+            // Check for user change to landing mode, or a fault
+            if((recievedEvent.name == SW1 && recievedEvent.action == SWITCHED_OFF) ||
+               recievedEvent.name == FAULT) {
                 controlStartLanding();
             } else {
                 controlUpdateTarget(&target, recievedEvent);
@@ -117,12 +151,12 @@ void controlFlyingTask(void *yawInitial) {
 
 //State that brings helicopter gently to landed
 void controlLandingTask(void *pvParameters) {
-    int32_t altitude;
+    altitudeMessage_t measured;
     controlTargetMessage_t target = {0};
     while (1) {
-        if (xQueueReceive(xMeasuredAltitudeQueue, (void *) &altitude, (TickType_t) 10) == pdPASS) {
-            target.altitude = altitude - 20;
-            if(altitude == 0) {
+        if (xQueueReceive(xMeasuredAltitudeQueue, (void *) &measured, (TickType_t) 10) == pdPASS) {
+            target.altitude = measured.altitude - 20;
+            if(measured.altitude == 0) {
                 vTaskDelete(pidTaskHandle);
                 controlStartLanded();
             }
@@ -135,31 +169,75 @@ void controlLandingTask(void *pvParameters) {
     }
 }
 
-//State for finding the reference point for the yaw. Is
-//blocked by until a semaphore is given by the yaw ref ISR.
+//Tail duty for the reference search at a time into the search
+static int16_t controlYawRefDuty(uint32_t elapsedMs) {
+    if (elapsedMs >= YAWREF_RAMP_MS) {
+        return YAWREF_DUTY_MAX;
+    }
+    return YAWREF_DUTY_START
+            + (YAWREF_DUTY_MAX - YAWREF_DUTY_START) * elapsedMs / YAWREF_RAMP_MS;
+}
+
+//Runs one reference search along the tail profile. Returns true if the
+//yaw ref ISR gave the semaphore before the timeout.
+static bool controlYawRefSearch(void) {
+    pwmUpdateMessage_t pwm = {0};
+    TickType_t start = xTaskGetTickCount();
+    uint32_t elapsedMs = 0;
+
+    while (elapsedMs < YAWREF_TIMEOUT_MS) {
+        // Set the tail pwm duty cycle to search for ref
+        pwm.tail = controlYawRefDuty(elapsedMs);
+        xQueueSend(xPWMQueue, (void *) &pwm, (TickType_t) 10);
+
+        // Wait for ISR to give semaphore
+        if (xSemaphoreTake(ctrlYawRefSmph, CONTROL_UPDATE_RATE / portTICK_RATE_MS) == pdTRUE) {
+            return true;
+        }
+        elapsedMs = (xTaskGetTickCount() - start) * portTICK_RATE_MS;
+    }
+    return false;
+}
+
+//State for finding the reference point for the yaw. Ramps the tail
+//along a profile until the yaw ref ISR gives a semaphore, with a
+//bounded number of attempts.
 void controlYawRefTask(void *pvParameters) {
+    pwmUpdateMessage_t pwm = {0};
+    TickType_t start = xTaskGetTickCount();
+    uint8_t attempt = 0;
+    char str[30];
+
     uartSend("LOOKING FOR REF!\r\n");
+    while (!controlYawRefSearch()) {
+        // Timed out: stop the tail before trying again
+        xQueueSend(xPWMQueue, (void *) &pwm, (TickType_t) 10);
+        attempt++;
+        if (attempt > YAWREF_RETRIES) {
+            // Fault: leave the rotors off and wait for the rig to be
+            // turned through the reference by hand
+            uartSend("REF FAULT\r\n");
+            xSemaphoreTake(ctrlYawRefSmph, portMAX_DELAY);
+            break;
+        }
+        uartSend("REF RETRY\r\n");
+        vTaskDelay(YAWREF_RETRY_PAUSE_MS / portTICK_RATE_MS);
+    }
 
-    // Set the tail pwm duty cycle to search for ref
-    pwmUpdateMessage_t pwm;
-    pwm.tail = TAIL_YAWREF_DUTY;
-    pwm.main = 0;
+    // Brake: cut the tail as soon as the reference is seen
     xQueueSend(xPWMQueue, (void *) &pwm, (TickType_t) 10);
 
-    // Wait for ISR to give semaphore
-    xSemaphoreTake(ctrlYawRefSmph, (TickType_t) 0xffff);
-
     // Clean up
     xQueueReset(xMeasuredAltitudeQueue);
     xQueueReset(xMeasuredYawQueue);
     xQueueReset(xUserInputEventQueue);
-    IntDisable(YAW_REF_INT_GROUP);
 
     // Give semaphore to yaw calculation task
     xSemaphoreGive(ctrlYawRefSmph);
 
     // Reference has been found:
-    uartSend("REF FOUND!\r\n");
+    usprintf(str, "REF FOUND! %dms\r\n", (xTaskGetTickCount() - start) * portTICK_RATE_MS);
+    uartSend(str);
 
     // Switch to Landed mode
     controlStartLanded();
@@ -167,10 +245,12 @@ void controlYawRefTask(void *pvParameters) {
 
 //Special states for heli. First state brings the helicopter gently
 //to an alttude of 50% and maintains this altitude. Second state
-//maintains a slow spin indefinitely.
+//maintains a slow spin indefinitely. Third state holds yaw through a
+//series of altitudes to learn the torque feedforward, then hovers.
+//Fourth state hovers and runs the relay autotune, landing if it aborts.
 void controlSpecialTask(void *patternNumberPTR) {
     uint8_t* patternNumber = (uint8_t *) patternNumberPTR;
-    int32_t altitude;
+    altitudeMessage_t measured;
     int32_t yaw;
     controlTargetMessage_t target;
     target.altitude = 15;
@@ -178,16 +258,16 @@ void controlSpecialTask(void *patternNumberPTR) {
 
     while (*patternNumber == 1) {
         // Increment target up to 50% and stay
-        if (xQueueReceive(xMeasuredAltitudeQueue, (void *) &altitude, (TickType_t) 10) == pdPASS) {
-            if(altitude >= 50 ) {
+        if (xQueueReceive(xMeasuredAltitudeQueue, (void *) &measured, (TickType_t) 10) == pdPASS) {
+            if(measured.altitude >= 50 ) {
                 target.altitude = 50;
-            } else if(altitude >= 40 ) {
+            } else if(measured.altitude >= 40 ) {
                 target.altitude = 55;
-            } else if(altitude >= 30) {
+            } else if(measured.altitude >= 30) {
                 target.altitude = 45;
-            } else if(altitude >= 20) {
+            } else if(measured.altitude >= 20) {
                 target.altitude = 35;
-            } else if(altitude >= 10) {
+            } else if(measured.altitude >= 10) {
                 target.altitude = 25;
             }
         }
@@ -197,7 +277,7 @@ void controlSpecialTask(void *patternNumberPTR) {
             // Get the user input event
             userInputEventMessage_t recievedEvent;
             xQueueReceive(xUserInputEventQueue, &recievedEvent, 5);
-            // Any user input goes back to landing
+            // Any user input or a fault goes back to landing
             if(recievedEvent.name != SW1) {
                 controlStartLanding();
             }
@@ -211,7 +291,9 @@ void controlSpecialTask(void *patternNumberPTR) {
 
     while (*patternNumber == 2) {
         // Increment target up to 50% and stay
-        if (xQueueReceive(xMeasuredYawQueue, (void *) &yaw, (TickType_t) 10) == pdPASS) {
+        yawMessage_t measuredYaw;
+        if (xQueueReceive(xMeasuredYawQueue, (void *) &measuredYaw, (TickType_t) 10) == pdPASS) {
+            yaw = yawBamToDeg(measuredYaw.angle);
             if (abs(yaw) >= abs(target.yaw) - 5 && abs(yaw) <= abs(target.yaw) + 5) {
                 userInputEventMessage_t dummy;
                 dummy.name = RIGHT;
@@ -225,7 +307,7 @@ void controlSpecialTask(void *patternNumberPTR) {
             // Get the user input event
             userInputEventMessage_t recievedEvent;
             xQueueReceive(xUserInputEventQueue, &recievedEvent, 5);
-            // Any user input goes back to landing
+            // Any user input or a fault goes back to landing
             if(recievedEvent.name != SW1) {
                 controlStartLanding();
             }
@@ -237,6 +319,80 @@ void controlSpecialTask(void *patternNumberPTR) {
         // Task delay
         vTaskDelay(CONTROL_UPDATE_RATE / portTICK_RATE_MS);
     }
+
+    if (*patternNumber == 3) {
+        const int32_t levels[] = FFCAL_LEVELS;
+        const uint32_t numLevels = sizeof(levels) / sizeof(levels[0]);
+        uint32_t step = 0;
+        uint32_t level = 0;
+        target.altitude = levels[0];
+        pidTorqueCalibrate(true);
+        while (1) {
+            // Dwell at each level, then hover at the last one
+            if (level < numLevels && ++step >= FFCAL_DWELL_MS / CONTROL_UPDATE_RATE) {
+                step = 0;
+                level++;
+                if (level < numLevels) {
+                    target.altitude = levels[level];
+                } else {
+                    pidTorqueCalibrate(false);
+                }
+            }
+
+            // Check for user input
+            while(uxQueueMessagesWaiting(xUserInputEventQueue) > 0) {
+                // Get the user input event
+                userInputEventMessage_t recievedEvent;
+                xQueueReceive(xUserInputEventQueue, &recievedEvent, 5);
+                // Any user input or a fault goes back to landing
+                if(recievedEvent.name != SW1) {
+                    pidTorqueCalibrateCancel();
+                    controlStartLanding();
+                }
+            }
+
+            // Send the target to the  PID task
+            xQueueSend(xControlTargetQueue, (void *) &target, 5);
+
+            // Task delay
+            vTaskDelay(CONTROL_UPDATE_RATE / portTICK_RATE_MS);
+        }
+    }
+
+    if (*patternNumber == 4) {
+        uint32_t step = 0;
+        bool tuning = false;
+        target.altitude = AUTOTUNE_ALTITUDE;
+        while (1) {
+            // Settle in the hover, then tune
+            if (!tuning && ++step >= AUTOTUNE_SETTLE_MS / CONTROL_UPDATE_RATE) {
+                tuning = true;
+                pidAutotune(true);
+            }
+            if (tuning && pidGetAutotuneState() == PID_AT_ABORTED) {
+                pidAutotune(false);
+                controlStartLanding();
+            }
+
+            // Check for user input
+            while(uxQueueMessagesWaiting(xUserInputEventQueue) > 0) {
+                // Get the user input event
+                userInputEventMessage_t recievedEvent;
+                xQueueReceive(xUserInputEventQueue, &recievedEvent, 5);
+                // Any user input or a fault goes back to landing
+                if(recievedEvent.name != SW1) {
+                    pidAutotune(false);
+                    controlStartLanding();
+                }
+            }
+
+            // Send the target to the  PID task
+            xQueueSend(xControlTargetQueue, (void *) &target, 5);
+
+            // Task delay
+            vTaskDelay(CONTROL_UPDATE_RATE / portTICK_RATE_MS);
+        }
+    }
 }
 
 //Updates the target altitude and yaw depending on the recieved button pushes.
@@ -267,11 +423,13 @@ void controlUpdateTarget(controlTargetMessage_t* target, userInputEventMessage_t
 void controlStartFlying(void){
     uartSend("Flying\r\n");
     int32_t yawInitial = 0;
+    yawMessage_t measuredYaw;
     //don't need to do this here but just wanted to use task parameters
     while(uxQueueMessagesWaiting(xMeasuredYawQueue) > 0) {
-        if(xQueueReceive(xMeasuredYawQueue, (void *) &yawInitial, (TickType_t) 10) != pdPASS) {
+        if(xQueueReceive(xMeasuredYawQueue, (void *) &measuredYaw, (TickType_t) 10) != pdPASS) {
             uartSend("yawRxFail\r\n");
         }
+        yawInitial = yawBamToDeg(measuredYaw.angle);
     }
     // Run the Flying and PID tasks
     if (pdTRUE != xTaskCreate(pidTask, "PID calculation task", TASK_STACK_DEPTH, NULL, 6, &pidTaskHandle))
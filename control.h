@@ -23,7 +23,27 @@
 #define YAW_TARGET_STEP         15
 #define ALT_TARGET_STEP         10
 #define PATTERN_LENGTH          4
-#define TAIL_YAWREF_DUTY        50  // Duty cycle when finding reference
+
+// Yaw reference search. The tail ramps from the start duty to the max
+// duty over the ramp time and holds there until the timeout. A search
+// that times out is retried after a pause, then the rig waits for the
+// reference with the rotors off.
+#define YAWREF_DUTY_START       25
+#define YAWREF_DUTY_MAX         60
+#define YAWREF_RAMP_MS          1500
+#define YAWREF_TIMEOUT_MS       8000
+#define YAWREF_RETRY_PAUSE_MS   2000
+#define YAWREF_RETRIES          2
+
+// Torque feedforward calibration (special pattern 3): altitudes (%)
+// held in turn with yaw held at 0
+#define FFCAL_LEVELS            {30, 50, 70, 50, 30}
+#define FFCAL_DWELL_MS          6000
+
+// Relay autotune (special pattern 4): hover altitude (%) and the time
+// to settle there before the relay starts
+#define AUTOTUNE_ALTITUDE       50
+#define AUTOTUNE_SETTLE_MS      8000
 /*--------------------------------------------------------------*/
 
 /* Includes -------------------------------------------------*/
@@ -70,7 +90,8 @@ void controlYawRefTask(void *pvParameters);
 
 //Special states for heli. First state brings the helicopter gently
 //to an alttude of 50% and maintains this altitude. Second state
-//maintains a slow spin indefinitely.
+//maintains a slow spin indefinitely. Third state learns the torque
+//feedforward. Fourth state runs the relay autotune.
 void controlSpecialTask(void *pvParameters);
 
 //Updates the target altitude and yaw depending on the recieved button pushes.
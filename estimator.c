@@ -0,0 +1,59 @@
+/*---------------------------------------------------------------
+               ________________
+                 _____|___
+                / |__|    \-----__|__
+                \_________/------ |
+                ____|___|____
+
+-----------------------------------------------------------------
+ ENCE 464 Group 13
+ estimator.c
+
+ Fixed point alpha-beta estimator. Tracks position and velocity
+ of a measured signal updated at a fixed rate. Position and
+ velocity carry ESTIMATOR_FRAC_BITS fraction bits, velocity is
+ per update. ESTIMATOR_USE_FLOAT keeps the state in single
+ precision on the FPU with the same fixed point interface.
+----------------------------------------------------------------*/
+
+/* Includes ----------------------------------------------------*/
+#include "main.h"
+#include "estimator.h"
+/*--------------------------------------------------------------*/
+
+/* Function definitions ----------------------------------------*/
+
+// Starts the estimate at rest at the given position
+void estimatorInit(estimatorHandle_t* h, int32_t alpha, int32_t beta, int32_t position) {
+    h->position = position;
+    h->velocity = 0;
+    h->alpha = alpha;
+    h->beta = beta;
+#if ESTIMATOR_USE_FLOAT
+    h->positionF = position;
+    h->velocityF = 0;
+    h->alphaF = alpha / (float) (1 << ESTIMATOR_GAIN_BITS);
+    h->betaF = beta / (float) (1 << ESTIMATOR_GAIN_BITS);
+#endif
+}
+
+// Predicts one update ahead and corrects with a new measurement
+void estimatorUpdate(estimatorHandle_t* h, int32_t measurement) {
+#if ESTIMATOR_USE_FLOAT
+    float predictedF = h->positionF + h->velocityF;
+    float residualF = measurement - predictedF;
+    h->positionF = predictedF + h->alphaF * residualF;
+    h->velocityF += h->betaF * residualF;
+    h->position = (int32_t) h->positionF;
+    h->velocity = (int32_t) h->velocityF;
+#else
+    // Predict
+    int32_t predicted = h->position + h->velocity;
+    int32_t residual = measurement - predicted;
+
+    // Correct
+    h->position = predicted + (int32_t) (((int64_t) h->alpha * residual) >> ESTIMATOR_GAIN_BITS);
+    h->velocity += (int32_t) (((int64_t) h->beta * residual) >> ESTIMATOR_GAIN_BITS);
+#endif
+}
+/*--------------------------------------------------------------*/
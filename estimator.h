@@ -0,0 +1,54 @@
+/*---------------------------------------------------------------
+               ________________
+                 _____|___
+                / |__|    \-----__|__
+                \_________/------ |
+                ____|___|____
+
+-----------------------------------------------------------------
+ ENCE 464 Group 13
+ estimator.h
+
+ Fixed point alpha-beta estimator. Tracks position and velocity
+ of a measured signal updated at a fixed rate. Position and
+ velocity carry ESTIMATOR_FRAC_BITS fraction bits, velocity is
+ per update. ESTIMATOR_USE_FLOAT keeps the state in single
+ precision on the FPU with the same fixed point interface.
+----------------------------------------------------------------*/
+
+#ifndef ESTIMATOR_H_
+#define ESTIMATOR_H_
+
+/* Definitions -------------------------------------------------*/
+#define ESTIMATOR_FRAC_BITS  16 // Fraction bits of position and velocity
+#define ESTIMATOR_GAIN_BITS  15 // Alpha and beta are Q15
+#ifndef ESTIMATOR_USE_FLOAT
+#define ESTIMATOR_USE_FLOAT  0  // Run the update on the FPU, may be set on the command line
+#endif
+/*--------------------------------------------------------------*/
+
+/* Type Definitions --------------------------------------------*/
+typedef struct estimatorHandle_t {
+    int32_t position;   // Estimated position
+    int32_t velocity;   // Estimated change in position per update
+    int32_t alpha;      // Position correction gain (Q15)
+    int32_t beta;       // Velocity correction gain (Q15)
+#if ESTIMATOR_USE_FLOAT
+    float positionF;    // Float state, same units as position and velocity
+    float velocityF;
+    float alphaF;
+    float betaF;
+#endif
+} estimatorHandle_t;
+/*--------------------------------------------------------------*/
+
+/* Function prototypes -----------------------------------------*/
+// Starts the estimate at rest at the given position
+void estimatorInit(estimatorHandle_t* h, int32_t alpha, int32_t beta, int32_t position);
+
+// Predicts one update ahead and corrects with a new measurement.
+// The measurement has ESTIMATOR_FRAC_BITS fraction bits.
+void estimatorUpdate(estimatorHandle_t* h, int32_t measurement);
+/*--------------------------------------------------------------*/
+
+#endif /* ESTIMATOR_H_ */
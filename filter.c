@@ -0,0 +1,257 @@
+/*---------------------------------------------------------------
+               ________________
+                 _____|___
+                / |__|    \-----__|__
+                \_________/------ |
+                ____|___|____
+
+-----------------------------------------------------------------
+ ENCE 464 Group 13
+ filter.c
+
+ Integer filter stages for sensor channels. Stages are chained
+ into a per-channel pipeline described by a table of
+ filterConfig_t. Each sample is passed through every stage in
+ order. A decimating stage only passes on every Nth result.
+----------------------------------------------------------------*/
+
+/* Includes ----------------------------------------------------*/
+#include "main.h"
+#include "filter.h"
+#include "circBufT.h"
+/*--------------------------------------------------------------*/
+
+/* Globals -----------------------------------------------------*/
+// cos(x) for x over a quarter turn in 32 steps (Q14)
+static const int16_t filterCosTable[33] = {
+        16384, 16364, 16305, 16207, 16069, 15893, 15679, 15426,
+        15137, 14811, 14449, 14053, 13623, 13160, 12665, 12140,
+        11585, 11003, 10394, 9760,  9102,  8423,  7723,  7005,
+        6270,  5520,  4756,  3981,  3196,  2404,  1606,  804,
+        0};
+/*--------------------------------------------------------------*/
+
+/* Function definitions ----------------------------------------*/
+
+// Builds a chain from a table of stage configs. Window storage for
+// boxcar and median stages is taken from the chain's pool.
+bool filterInit(filterChain_t* chain, const filterConfig_t* configs, uint32_t numStages) {
+    uint32_t used = 0;
+    uint32_t i;
+
+    if (numStages > FILTER_MAX_STAGES) {
+        return false;
+    }
+    chain->numStages = numStages;
+    chain->output = 0;
+
+    for (i = 0; i < numStages; i++) {
+        filterStage_t* stage = &chain->stages[i];
+        stage->config = &configs[i];
+
+        if (configs[i].type == FILTER_BOXCAR || configs[i].type == FILTER_MEDIAN) {
+            uint32_t length = configs[i].param;
+            if (length == 0 || used + length > FILTER_POOL_LENGTH) {
+                return false;
+            }
+            if (configs[i].type == FILTER_MEDIAN && length > FILTER_MEDIAN_MAX) {
+                return false;
+            }
+            initCircBuf(&stage->window, &chain->pool[used], length);
+            used += length;
+        }
+        if (configs[i].type == FILTER_DECIMATE && configs[i].param == 0) {
+            return false;
+        }
+        if (configs[i].type == FILTER_BIQUAD) {
+            uint32_t j;
+            for (j = 0; j < 5; j++) {
+                stage->coef[j] = configs[i].coef[j];
+            }
+        }
+        stage->bypass = (configs[i].type == FILTER_NOTCH);
+    }
+    filterReset(chain, 0);
+    return true;
+}
+
+// Sets every stage to the steady state for a constant input
+void filterReset(filterChain_t* chain, int32_t value) {
+    uint32_t i;
+    for (i = 0; i < chain->numStages; i++) {
+        filterStage_t* stage = &chain->stages[i];
+        uint32_t j;
+        switch (stage->config->type) {
+        case FILTER_BOXCAR:
+        case FILTER_MEDIAN:
+            for (j = 0; j < stage->window.size; j++) {
+                writeCircBuf(&stage->window, value);
+            }
+            break;
+        case FILTER_EMA:
+            stage->acc = value * (1 << stage->config->param);
+            break;
+        case FILTER_BIQUAD:
+        case FILTER_NOTCH:
+            stage->x1 = stage->x2 = value;
+            stage->y1 = stage->y2 = value * (1 << FILTER_STATE_BITS);
+            break;
+        case FILTER_DECIMATE:
+            stage->acc = 0;
+            stage->count = 0;
+            break;
+        }
+    }
+    chain->output = value;
+}
+
+// Median of the window. Windows are short so a copy and
+// insertion sort is cheaper than keeping a sorted list.
+static int32_t filterMedian(circBuf_t* window) {
+    int32_t sorted[FILTER_MEDIAN_MAX];
+    uint32_t i;
+    for (i = 0; i < window->size; i++) {
+        int32_t value = (int32_t) window->data[i];
+        uint32_t j = i;
+        while (j > 0 && sorted[j - 1] > value) {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = value;
+    }
+    return sorted[window->size / 2];
+}
+
+// Rounded mean of the window. The running sum is kept modulo 2^32,
+// so taken as signed it is exact for negative samples too and the
+// mean rounds half away from zero either side.
+static int32_t filterMean(const circBuf_t* window) {
+    int32_t sum = (int32_t) window->sum;
+    int32_t half = (int32_t) (window->size / 2);
+    return (sum + ((sum < 0) ? -half : half)) / (int32_t) window->size;
+}
+
+// Runs one stage. Returns false if the stage holds the sample back.
+static bool filterStep(filterStage_t* stage, int32_t* value) {
+    const filterConfig_t* config = stage->config;
+    int64_t acc;
+
+    switch (config->type) {
+    case FILTER_BOXCAR:
+        writeCircBuf(&stage->window, *value);
+        *value = filterMean(&stage->window);
+        break;
+    case FILTER_EMA:
+        // acc holds y * 2^k, so y += (x - y) / 2^k without losing the fraction
+        stage->acc += *value - (stage->acc >> config->param);
+        *value = stage->acc >> config->param;
+        break;
+    case FILTER_MEDIAN:
+        writeCircBuf(&stage->window, *value);
+        *value = filterMedian(&stage->window);
+        break;
+    case FILTER_BIQUAD:
+    case FILTER_NOTCH:
+        if (stage->bypass) {
+            // Keep the history current so the notch can start cleanly
+            stage->x2 = stage->x1;
+            stage->x1 = *value;
+            stage->y2 = stage->y1;
+            stage->y1 = *value * (1 << FILTER_STATE_BITS);
+            break;
+        }
+        // Direct form I. The output history keeps a fraction: rounded
+        // to whole counts, the feedback sticks anywhere within half a
+        // count over 1 + a1 + a2 of the settled value, tens of counts
+        // for a low notch.
+        acc = ((int64_t) stage->coef[0] * *value
+             + (int64_t) stage->coef[1] * stage->x1
+             + (int64_t) stage->coef[2] * stage->x2) * (1 << FILTER_STATE_BITS)
+            - (int64_t) stage->coef[3] * stage->y1
+            - (int64_t) stage->coef[4] * stage->y2;
+        stage->x2 = stage->x1;
+        stage->x1 = *value;
+        stage->y2 = stage->y1;
+        stage->y1 = (int32_t) ((acc + (FILTER_COEF_ONE / 2)) >> FILTER_COEF_BITS);
+        *value = (stage->y1 + (1 << (FILTER_STATE_BITS - 1))) >> FILTER_STATE_BITS;
+        break;
+    case FILTER_DECIMATE:
+        stage->acc += *value;
+        stage->count++;
+        if (stage->count < (uint32_t) config->param) {
+            return false;
+        }
+        *value = stage->acc / (int32_t) config->param;
+        stage->acc = 0;
+        stage->count = 0;
+        break;
+    }
+    return true;
+}
+
+// cos of a phase in turns (Q16), for phases up to half a turn (Q14)
+static int32_t filterCos(uint32_t phase) {
+    const uint32_t quarter = 1 << 14;
+    bool negate = false;
+    if (phase >= quarter) {
+        // cos(x) = -cos(pi - x)
+        phase = 2 * quarter - phase;
+        negate = true;
+    }
+    uint32_t index = phase >> 9;
+    int32_t frac = phase & 0x1ff;
+    int32_t value = filterCosTable[index];
+    if (index < 32) {
+        value += ((filterCosTable[index + 1] - value) * frac) >> 9;
+    }
+    return negate ? -value : value;
+}
+
+// Moves the centre of every notch stage in the chain. The notch is
+// scaled for unity gain at DC so the altitude reading is unchanged.
+void filterSetNotch(filterChain_t* chain, uint32_t freq, uint32_t sampleRate) {
+    uint32_t i;
+    for (i = 0; i < chain->numStages; i++) {
+        filterStage_t* stage = &chain->stages[i];
+        if (stage->config->type != FILTER_NOTCH) {
+            continue;
+        }
+        // Phase step per sample in turns, Q16
+        uint32_t phase = (freq << (16 - FILTER_FREQ_BITS)) / sampleRate;
+        int32_t r = stage->config->param;
+        int32_t c = filterCos(phase);
+        int32_t a1 = -((2 * r * c) >> FILTER_COEF_BITS);
+        int32_t a2 = (r * r) >> FILTER_COEF_BITS;
+        int32_t numDC = 2 * (FILTER_COEF_ONE - c);
+        if (freq == 0 || numDC <= 0) {
+            stage->bypass = true;
+            continue;
+        }
+        // Too close to DC to hold unity DC gain, leave the signal alone
+        int32_t gain = ((FILTER_COEF_ONE + a1 + a2) << FILTER_COEF_BITS) / numDC;
+        if (gain > 2 * FILTER_COEF_ONE) {
+            stage->bypass = true;
+            continue;
+        }
+        stage->coef[0] = gain;
+        stage->coef[1] = -((2 * c * gain) >> FILTER_COEF_BITS);
+        stage->coef[2] = gain;
+        stage->coef[3] = a1;
+        stage->coef[4] = a2;
+        stage->bypass = false;
+    }
+}
+
+// Passes one sample through the chain. Returns true and updates
+// chain->output when a value comes out of the last stage.
+bool filterProcess(filterChain_t* chain, int32_t sample) {
+    uint32_t i;
+    for (i = 0; i < chain->numStages; i++) {
+        if (!filterStep(&chain->stages[i], &sample)) {
+            return false;
+        }
+    }
+    chain->output = sample;
+    return true;
+}
+/*--------------------------------------------------------------*/
@@ -0,0 +1,88 @@
+/*---------------------------------------------------------------
+               ________________
+                 _____|___
+                / |__|    \-----__|__
+                \_________/------ |
+                ____|___|____
+
+-----------------------------------------------------------------
+ ENCE 464 Group 13
+ filter.h
+
+ Integer filter stages for sensor channels. Stages are chained
+ into a per-channel pipeline described by a table of
+ filterConfig_t. Each sample is passed through every stage in
+ order. A decimating stage only passes on every Nth result.
+----------------------------------------------------------------*/
+
+#ifndef FILTER_H_
+#define FILTER_H_
+
+/* Includes -----------------------------------------*/
+#include "circBufT.h"
+/*--------------------------------------------------------------*/
+
+/* Definitions -------------------------------------------------*/
+#define FILTER_MAX_STAGES    4
+#define FILTER_MEDIAN_MAX    9   // Longest median window
+#define FILTER_BOXCAR_MAX    256 // Longest boxcar the pool is sized for
+#define FILTER_POOL_LENGTH   (FILTER_BOXCAR_MAX + FILTER_MEDIAN_MAX) // Window storage shared by the stages of a chain
+#define FILTER_COEF_BITS     14 // Biquad coefficients are Q14
+#define FILTER_COEF_ONE      (1 << FILTER_COEF_BITS)
+#define FILTER_STATE_BITS    8  // Fraction bits kept in the biquad output history
+#define FILTER_FREQ_BITS     4  // Notch centre frequencies are Hz, Q4
+/*--------------------------------------------------------------*/
+
+/* Type Definitions --------------------------------------------*/
+enum filterTypes {
+    FILTER_BOXCAR,      // Moving average, param = window length
+    FILTER_EMA,         // Exponential average, alpha = 1/2^param
+    FILTER_MEDIAN,      // Median, param = window length (odd)
+    FILTER_BIQUAD,      // IIR, coef = b0 b1 b2 a1 a2 (Q14). b2 = a2 = 0 for first order
+    FILTER_DECIMATE,    // Mean of each param samples, one output per param inputs
+    FILTER_NOTCH        // Notch, param = pole radius (Q14). Centre set by filterSetNotch
+};
+
+typedef struct filterConfig_t {
+    enum filterTypes type;
+    int32_t param;
+    int16_t coef[5];
+} filterConfig_t;
+
+typedef struct filterStage_t {
+    const filterConfig_t* config;
+    circBuf_t window;       // Boxcar and median sample window
+    int32_t acc;            // EMA accumulator (Q param) or decimator sum
+    uint32_t count;         // Samples in the decimator sum
+    int32_t coef[5];        // Biquad and notch coefficients in use (Q14)
+    int32_t x1, x2, y1, y2; // Biquad history, y with FILTER_STATE_BITS fraction bits
+    bool bypass;            // Notch has no centre set and passes samples through
+} filterStage_t;
+
+typedef struct filterChain_t {
+    filterStage_t stages[FILTER_MAX_STAGES];
+    uint32_t numStages;
+    int32_t output;         // Last value out of the chain
+    uint32_t pool[FILTER_POOL_LENGTH];
+} filterChain_t;
+/*--------------------------------------------------------------*/
+
+/* Function prototypes -----------------------------------------*/
+// Builds a chain from a table of stage configs. Returns false if
+// the table does not fit in FILTER_MAX_STAGES / FILTER_POOL_LENGTH.
+bool filterInit(filterChain_t* chain, const filterConfig_t* configs, uint32_t numStages);
+
+// Sets every stage to the steady state for a constant input
+void filterReset(filterChain_t* chain, int32_t value);
+
+// Moves the centre of every notch stage in the chain. A frequency of
+// 0 bypasses the notch. freq is Hz (Q FILTER_FREQ_BITS) and must be
+// below half the sample rate of the stage.
+void filterSetNotch(filterChain_t* chain, uint32_t freq, uint32_t sampleRate);
+
+// Passes one sample through the chain. Returns true and updates
+// chain->output when a value comes out of the last stage.
+bool filterProcess(filterChain_t* chain, int32_t sample);
+/*--------------------------------------------------------------*/
+
+#endif /* FILTER_H_ */
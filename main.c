@@ -27,7 +27,6 @@ extern QueueHandle_t xUserInputEventQueue = NULL;
 extern QueueHandle_t xControlTargetQueue = NULL;
 extern QueueHandle_t xAltitudeADCQueue = NULL;
 extern QueueHandle_t xMeasuredAltitudeQueue = NULL;
-extern QueueHandle_t xYawEncoderQueue = NULL;
 extern QueueHandle_t xMeasuredYawQueue = NULL;
 extern QueueHandle_t xPWMQueue = NULL;
 extern QueueHandle_t xTelemetryQueue = NULL;
@@ -48,6 +47,13 @@ int main(void) {
     // Set the clock rate to 80 MHz
     SysCtlClockSet (SYSCTL_SYSDIV_2_5 | SYSCTL_USE_PLL | SYSCTL_OSC_MAIN | SYSCTL_XTAL_16MHZ);
 
+    // Start the cycle counter used for timing measurements
+    HWREG(CORE_DEMCR) |= CORE_DEMCR_TRCENA;
+    HWREG(CORE_DWT_CTRL) |= CORE_DWT_CTRL_CYCCNTENA;
+
+    // Create queues before any peripheral can raise an interrupt
+    createQueues();
+
     // Initialize the world
     altitudeInitADC();
     userInputInit();
@@ -56,7 +62,6 @@ int main(void) {
     uartInit();
 
     // Create FreeRTOS stuff
-    createQueues();
     createTasks();
 
     ctrlYawRefSmph = xSemaphoreCreateBinary();
@@ -80,10 +85,14 @@ void taskCpuUsage(void *pvParameters) {
 void createQueues(void) {
     xUserInputEventQueue = xQueueCreate(3, sizeof(userInputEventMessage_t));
     xControlTargetQueue = xQueueCreate(3, sizeof(controlTargetMessage_t));
-    xMeasuredAltitudeQueue = xQueueCreate(5, sizeof(int32_t));
-    xAltitudeADCQueue = xQueueCreate(12, sizeof(uint32_t));
-    xYawEncoderQueue = xQueueCreate(40, sizeof(uint8_t));
-    xMeasuredYawQueue = xQueueCreate(5, sizeof(int32_t));
+    // Mailbox, overwritten with the latest altitude
+    xMeasuredAltitudeQueue = xQueueCreate(1, sizeof(altitudeMessage_t));
+#if ALT_ADC_USE_UDMA
+    xAltitudeADCQueue = xQueueCreate(2 * ALT_ADC_COUNT, sizeof(altitudeADCBlock_t));
+#else
+    xAltitudeADCQueue = xQueueCreate(ALT_ADC_QUEUE_LENGTH, sizeof(uint32_t));
+#endif
+    xMeasuredYawQueue = xQueueCreate(5, sizeof(yawMessage_t));
     xPWMQueue = xQueueCreate(10, sizeof(pwmUpdateMessage_t));
     xTelemetryQueue = xQueueCreate(20, sizeof(telemetryMessage_t));
 }
@@ -96,8 +105,10 @@ void createTasks(void) {
     if (pdTRUE != xTaskCreate(userInputPollTask, "User input polling task", TASK_STACK_DEPTH, NULL, 2, NULL))
     { while(1);}               // Oh no! Must not have had enough memory to create the task.
 
+#if !ALT_ADC_TIMER_TRIGGER
     if (pdTRUE != xTaskCreate(altitudeADCSamplingTask, "Altitude sampling task", TASK_STACK_DEPTH, NULL, 6, NULL))
     { while(1);}               // Oh no! Must not have had enough memory to create the task.
+#endif
 
     if (pdTRUE != xTaskCreate(altitudeAvgTask, "Altitude averaging task", TASK_STACK_DEPTH, NULL, 5, NULL))
     { while(1);}               // Oh no! Must not have had enough memory to create the task.
@@ -18,6 +18,8 @@
 // hardware specific
 #include "inc/hw_memmap.h"
 #include "inc/hw_types.h"
+#include "inc/hw_adc.h"
+#include "inc/hw_gpio.h"
 #include "inc/tm4c123gh6pm.h"
 // Drivers
 #include "driverlib/gpio.h"
@@ -28,6 +30,9 @@
 #include "driverlib/pwm.h"
 #include "driverlib/adc.h"
 #include "driverlib/uart.h"
+#include "driverlib/timer.h"
+#include "driverlib/udma.h"
+#include "driverlib/qei.h"
 #include "utils/ustdlib.h"
 #include "ustdlib.h"
 // FreeRTOS
@@ -39,7 +44,8 @@
 
 /* Constants ---------------------------------------------------*/
 enum flightModes {LANDED, FLYING, LANDING, YAWREF, SPECIAL};
-enum userInputNames {UP, DOWN, LEFT, RIGHT, SW1, SW2, NUM_INPUTS};
+// FAULT is not a physical input: it asks any flying state to land
+enum userInputNames {UP, DOWN, LEFT, RIGHT, SW1, SW2, NUM_INPUTS, FAULT};
 enum userInputActions {BUT_RELEASED, BUT_PUSHED, SWITCHED_ON, SWITCHED_OFF};
 /*--------------------------------------------------------------*/
 
@@ -91,6 +97,10 @@ enum userInputActions {BUT_RELEASED, BUT_PUSHED, SWITCHED_ON, SWITCHED_OFF};
 /*--------------------------------------------------------------*/
 
 /* PWM Hardware Details ----------------------------------------*/
+// PWM clock, shared by both PWM modules
+#define PWM_CLOCK_DIV           SYSCTL_PWMDIV_64
+#define PWM_CLOCK_DIVISOR       64
+
 // Main rotor PWM: PC5, J4-05
 #define PWM_MAIN_BASE           PWM0_BASE
 #define PWM_MAIN_GEN            PWM_GEN_3
@@ -124,6 +134,36 @@ enum userInputActions {BUT_RELEASED, BUT_PUSHED, SWITCHED_ON, SWITCHED_OFF};
 #define ALTITUDE_ADC_STEP       0
 #define ALTITUDE_ADC_PRIORITY   0
 
+// Altitude ADC sample timer: Timer0A, triggers ADC0 conversions directly
+#define ALTITUDE_TIMER_BASE     TIMER0_BASE
+#define ALTITUDE_TIMER_PERIPH   SYSCTL_PERIPH_TIMER0
+#define ALTITUDE_TIMER          TIMER_A
+#define ALTITUDE_TIMER_TRIGGER  ADC_TRIGGER_TIMER
+
+// Altitude limit comparators: sequence 2 converts AIN9 into digital
+// comparator 0 (ceiling) and 1 (floor) on the same timer trigger
+#define ALTITUDE_CMP_SEQ_NUM    2
+#define ALTITUDE_CMP_PRIORITY   1
+#define ALTITUDE_CMP_INT_GROUP  INT_ADC0SS2
+#define ALTITUDE_CMP_INT_FLAG   ADC_INT_DCON_SS2
+#define ALTITUDE_CMP_CEILING    0
+#define ALTITUDE_CMP_FLOOR      1
+
+// Altitude ADC uDMA: sequence 3 FIFO is read by uDMA channel 17
+#define ALTITUDE_DMA_PERIPH     SYSCTL_PERIPH_UDMA
+#define ALTITUDE_DMA_CHANNEL    UDMA_CHANNEL_ADC3
+
+// Second altitude ADC for interleaved sampling: ADC1 sequence 3 on AIN9,
+// triggered by PWM0 generator 0, read by uDMA channel 27
+#define ALTITUDE_ADC1_BASE      ADC1_BASE
+#define ALTITUDE_ADC1_PERIPH    SYSCTL_PERIPH_ADC1
+#define ALTITUDE_ADC1_TRIGGER   (ADC_TRIGGER_PWM0 | ADC_TRIGGER_PWM_MOD0)
+#define ALTITUDE_PWM_TRIG_BASE  PWM0_BASE
+#define ALTITUDE_PWM_TRIG_GEN   PWM_GEN_0
+#define ALTITUDE_PWM_TRIG_PERIPH SYSCTL_PERIPH_PWM0
+#define ALTITUDE_DMA1_CHANNEL   27
+#define ALTITUDE_DMA1_ASSIGN    UDMA_CH27_ADC1_3
+
 // Yaw reference pin:
 #define YAW_REF_BASE            GPIO_PORTC_BASE
 #define YAW_REF_PERIPH          SYSCTL_PERIPH_GPIOC
@@ -136,6 +176,36 @@ enum userInputActions {BUT_RELEASED, BUT_PUSHED, SWITCHED_ON, SWITCHED_OFF};
 #define YAW_QUAD_PIN_A          GPIO_PIN_0
 #define YAW_QUAD_PIN_B          GPIO_PIN_1
 #define YAW_QUAD_INT_GROUP      INT_GPIOB
+
+// Yaw hardware decoder (YAW_USE_QEI). PB0/PB1 have no QEI function
+// and PC5 is the main rotor PWM, so the encoder moves to QEI0,
+// PhA0:PD6 PhB0:PD7. PD7 is an NMI pin and has to be unlocked.
+#define YAW_QEI_BASE            QEI0_BASE
+#define YAW_QEI_PERIPH          SYSCTL_PERIPH_QEI0
+#define YAW_QEI_GPIO_BASE       GPIO_PORTD_BASE
+#define YAW_QEI_GPIO_PERIPH     SYSCTL_PERIPH_GPIOD
+#define YAW_QEI_PIN_A           GPIO_PIN_6
+#define YAW_QEI_PIN_B           GPIO_PIN_7
+#define YAW_QEI_PIN_A_CONFIG    GPIO_PD6_PHA0
+#define YAW_QEI_PIN_B_CONFIG    GPIO_PD7_PHB0
+
+// Yaw edge timestamps, free running at the system clock
+#define YAW_TIMER_BASE          TIMER1_BASE
+#define YAW_TIMER_PERIPH        SYSCTL_PERIPH_TIMER1
+#define YAW_TIMER               TIMER_A
+/*--------------------------------------------------------------*/
+
+/* Cycle counter -----------------------------------------------*/
+// Cortex-M4 DWT cycle counter, started in main and used to time
+// interrupt handlers and the control loop
+#define CORE_DEMCR              0xE000EDFC
+#define CORE_DEMCR_TRCENA       0x01000000
+#define CORE_DWT_CTRL           0xE0001000
+#define CORE_DWT_CTRL_CYCCNTENA 0x00000001
+#define CORE_DWT_CYCCNT         0xE0001004
+// SysTick counts down from its reload value to each RTOS tick
+#define CORE_ST_RELOAD          0xE000E014
+#define CORE_ST_CURRENT         0xE000E018
 /*--------------------------------------------------------------*/
 
 /* USB UART Communications -------------------------------------*/
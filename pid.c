@@ -22,28 +22,455 @@
 #include "yaw.h"
 #include "uart.h"
 #include "control.h"
+#if PID_USE_DSP && !defined(__TI_ARM__) && defined(__ARM_FEATURE_DSP)
+#include <arm_acle.h>
+#endif
+/*--------------------------------------------------------------*/
+
+/* DSP operations ----------------------------------------------*/
+// SMLAD: acc + lo(x)*lo(y) + hi(x)*hi(y), SMLABB: acc + lo(x)*lo(y),
+// QADD: saturating add, SSAT16: saturate to int16
+#if PID_USE_DSP && defined(__TI_ARM__)
+#define PID_SMLAD(x, y, acc)    _smlad(x, y, acc)
+#define PID_SMLABB(x, y, acc)   _smlabb(x, y, acc)
+#define PID_QADD(a, b)          _sadd(a, b)
+#define PID_SSAT16(x)           _ssata(x, 0, 16)
+#elif PID_USE_DSP && defined(__ARM_FEATURE_DSP)
+#define PID_SMLAD(x, y, acc)    __smlad(x, y, acc)
+#define PID_SMLABB(x, y, acc)   __smlabb(x, y, acc)
+#define PID_QADD(a, b)          __qadd(a, b)
+#define PID_SSAT16(x)           __ssat(x, 16)
+#elif !PID_USE_FLOAT
+// Portable versions with the same results, for the fixed point kernel
+static int32_t pidSat16(int32_t x) {
+    return (x > INT16_MAX) ? INT16_MAX : (x < INT16_MIN) ? INT16_MIN : x;
+}
+static int32_t pidQadd(int32_t a, int32_t b) {
+    int64_t sum = (int64_t) a + b;
+    return (sum > INT32_MAX) ? INT32_MAX : (sum < INT32_MIN) ? INT32_MIN : (int32_t) sum;
+}
+#define PID_SMLAD(x, y, acc)    ((acc) + (int16_t) (x) * (int16_t) (y) \
+                                 + (int16_t) ((x) >> 16) * (int16_t) ((y) >> 16))
+#define PID_SMLABB(x, y, acc)   ((acc) + (int16_t) (x) * (int16_t) (y))
+#define PID_QADD(a, b)          pidQadd(a, b)
+#define PID_SSAT16(x)           pidSat16(x)
+#endif
+// Two int16 into one word, a in the low half
+#define PID_PACK(a, b)          ((uint32_t) (uint16_t) (a) | ((uint32_t) (uint16_t) (b) << 16))
+/*--------------------------------------------------------------*/
+
+/* Globals -----------------------------------------------------*/
+static pidTiming_t pidTiming;
+
+// Torque feedforward gains (Q15), kept between flights
+static int32_t pidTorqueQ = (PID_FF_GAIN << PID_GAIN_BITS) / 1000;
+static int32_t pidTorqueRateQ = (PID_FF_RATE_GAIN << PID_GAIN_BITS) / 1000;
+static volatile enum pidCalRequests pidTorqueRequest = PID_CAL_STOP;
+
+// Autotune request from the control task, and its progress
+static volatile bool pidAutotuneRequest = false;
+static volatile enum pidTuneStates pidAutotuneState = PID_AT_IDLE;
+
+// Tuning rules (per 1000): kp share of Ku, Ti and Td shares of Tu
+static const int32_t pidTuneRules[PID_NUM_RULES][3] = {
+    {600, 500, 125},    // PID_RULE_ZIEGLER_NICHOLS
+    {455, 2200, 159},   // PID_RULE_TYREUS_LUYBEN
+    {200, 500, 333},    // PID_RULE_NO_OVERSHOOT
+};
+
+// Gain schedules from the bottom of the span to the top. Both start
+// flat at the tuned gains, rows are retuned at each breakpoint.
+static const pidGains_t pidMainSchedule[PID_SCHEDULE_POINTS] = {
+    {MAIN_PROP_GAIN, MAIN_INT_GAIN, MAIN_DIFF_GAIN},    // 0
+    {MAIN_PROP_GAIN, MAIN_INT_GAIN, MAIN_DIFF_GAIN},    // 25
+    {MAIN_PROP_GAIN, MAIN_INT_GAIN, MAIN_DIFF_GAIN},    // 50
+    {MAIN_PROP_GAIN, MAIN_INT_GAIN, MAIN_DIFF_GAIN},    // 75
+    {MAIN_PROP_GAIN, MAIN_INT_GAIN, MAIN_DIFF_GAIN},    // 100
+};
+static const pidGains_t pidTailSchedule[PID_SCHEDULE_POINTS] = {
+    {TAIL_PROP_GAIN, TAIL_INT_GAIN, TAIL_DIFF_GAIN},
+    {TAIL_PROP_GAIN, TAIL_INT_GAIN, TAIL_DIFF_GAIN},
+    {TAIL_PROP_GAIN, TAIL_INT_GAIN, TAIL_DIFF_GAIN},
+    {TAIL_PROP_GAIN, TAIL_INT_GAIN, TAIL_DIFF_GAIN},
+    {TAIL_PROP_GAIN, TAIL_INT_GAIN, TAIL_DIFF_GAIN},
+};
+
+// Controller for each axis
+static const pidConfig_t pidConfigs[PID_NUM_AXES] = {
+#if PID_CASCADE
+    // Rate target from altitude
+    [PID_MAIN] = {
+        .kp = MAIN_OUTER_GAIN,
+        .minDuty = -MAIN_RATE_MAX, .maxDuty = MAIN_RATE_MAX,
+        .setpointWeight = MAIN_SETPOINT_WEIGHT,
+        .useRate = true,
+        .errorBits = PID_OUTER_ERROR_BITS,
+    },
+    // Rate target from yaw
+    [PID_TAIL] = {
+        .kp = TAIL_OUTER_GAIN,
+        .minDuty = -TAIL_RATE_MAX, .maxDuty = TAIL_RATE_MAX,
+        .setpointWeight = TAIL_SETPOINT_WEIGHT,
+        .useRate = true, .isAngle = true,
+        .errorBits = PID_OUTER_ERROR_BITS,
+    },
+#else
+    [PID_MAIN] = {
+        .kp = MAIN_PROP_GAIN, .ki = MAIN_INT_GAIN, .kd = MAIN_DIFF_GAIN,
+        .offset = MAIN_DUTY_OFFSET,
+        .minDuty = MAIN_MIN_DUTY, .maxDuty = MAIN_MAX_DUTY,
+        .integralMax = MAIN_ERROR_MAX,
+        .integralStart = -(MAIN_DUTY_OFFSET*1000/2 / MAIN_INT_GAIN),
+        .setpointWeight = MAIN_SETPOINT_WEIGHT,
+        .diffFilter = MAIN_DIFF_FILTER,
+        .windupGain = MAIN_WINDUP_GAIN,
+        .useRate = true,
+        .schedule = PID_SCHEDULE_ENABLE ? pidMainSchedule : NULL,
+    },
+    [PID_TAIL] = {
+        .kp = TAIL_PROP_GAIN, .ki = TAIL_INT_GAIN, .kd = TAIL_DIFF_GAIN,
+        .offset = TAIL_DUTY_OFFSET,
+        .minDuty = TAIL_MIN_DUTY, .maxDuty = TAIL_MAX_DUTY,
+        .integralMax = TAIL_ERROR_MAX,
+        .setpointWeight = TAIL_SETPOINT_WEIGHT,
+        .diffFilter = TAIL_DIFF_FILTER,
+        .windupGain = TAIL_WINDUP_GAIN,
+        .useRate = true, .isAngle = true,
+        .schedule = PID_SCHEDULE_ENABLE ? pidTailSchedule : NULL,
+    },
+#endif
+    // Main duty from vertical velocity
+    [PID_MAIN_RATE] = {
+        .kp = MAIN_RATE_PROP_GAIN, .ki = MAIN_RATE_INT_GAIN, .kd = MAIN_RATE_DIFF_GAIN,
+        .offset = MAIN_DUTY_OFFSET,
+        .minDuty = MAIN_MIN_DUTY, .maxDuty = MAIN_MAX_DUTY,
+        .integralMax = MAIN_RATE_ERROR_MAX,
+        .integralStart = MAIN_RATE_INT_START,
+        .setpointWeight = 1000,
+        .diffFilter = RATE_DIFF_FILTER,
+        .windupGain = MAIN_WINDUP_GAIN,
+        .inputBits = PID_DIFF_FRAC_BITS,
+        .errorBits = PID_RATE_ERROR_BITS,
+        .integralShift = PID_RATE_INT_SHIFT,
+        .integralMs = PID_RATE_DELAY,
+    },
+    // Tail duty from yaw rate
+    [PID_TAIL_RATE] = {
+        .kp = TAIL_RATE_PROP_GAIN, .ki = TAIL_RATE_INT_GAIN, .kd = TAIL_RATE_DIFF_GAIN,
+        .offset = TAIL_DUTY_OFFSET,
+        .minDuty = TAIL_MIN_DUTY, .maxDuty = TAIL_MAX_DUTY,
+        .integralMax = TAIL_RATE_ERROR_MAX,
+        .setpointWeight = 1000,
+        .diffFilter = RATE_DIFF_FILTER,
+        .windupGain = TAIL_WINDUP_GAIN,
+        .inputBits = PID_DIFF_FRAC_BITS,
+        .errorBits = PID_RATE_ERROR_BITS,
+        .integralShift = PID_RATE_INT_SHIFT,
+        .integralMs = PID_RATE_DELAY,
+    },
+};
+
+// Every configured gain has to fit its kernel gain
+PID_GAIN_CHECK(pidCheckMainP, MAIN_PROP_GAIN * 1000, PID_GAIN_BITS);
+PID_GAIN_CHECK(pidCheckMainI, MAIN_INT_GAIN * 1000, PID_GAIN_BITS);
+PID_GAIN_CHECK(pidCheckMainD, MAIN_DIFF_GAIN * 1000, PID_KD_BITS);
+PID_GAIN_CHECK(pidCheckTailP, TAIL_PROP_GAIN * 1000, PID_GAIN_BITS);
+PID_GAIN_CHECK(pidCheckTailI, TAIL_INT_GAIN * 1000, PID_GAIN_BITS);
+PID_GAIN_CHECK(pidCheckTailD, TAIL_DIFF_GAIN * 1000, PID_KD_BITS);
+PID_GAIN_CHECK(pidCheckMainOuter, MAIN_OUTER_GAIN * 1000, PID_GAIN_BITS - PID_OUTER_ERROR_BITS);
+PID_GAIN_CHECK(pidCheckTailOuter, TAIL_OUTER_GAIN * 1000, PID_GAIN_BITS - PID_OUTER_ERROR_BITS);
+PID_GAIN_CHECK(pidCheckMainRateP, MAIN_RATE_PROP_GAIN * 1000, PID_GAIN_BITS - PID_RATE_ERROR_BITS);
+PID_GAIN_CHECK(pidCheckMainRateI, MAIN_RATE_INT_GAIN * PID_RATE_DELAY,
+               PID_GAIN_BITS - PID_RATE_ERROR_BITS + PID_RATE_INT_SHIFT);
+PID_GAIN_CHECK(pidCheckTailRateP, TAIL_RATE_PROP_GAIN * 1000, PID_GAIN_BITS - PID_RATE_ERROR_BITS);
+PID_GAIN_CHECK(pidCheckTailRateI, TAIL_RATE_INT_GAIN * PID_RATE_DELAY,
+               PID_GAIN_BITS - PID_RATE_ERROR_BITS + PID_RATE_INT_SHIFT);
 /*--------------------------------------------------------------*/
 
 /* Function definitions ----------------------------------------*/
 
+// Records the start and end of one control period
+static void pidTimingUpdate(uint32_t jitter, uint32_t latency) {
+    if (pidTiming.cycles == 0 || jitter < pidTiming.jitterMin) {
+        pidTiming.jitterMin = jitter;
+    }
+    if (jitter > pidTiming.jitterMax) {
+        pidTiming.jitterMax = jitter;
+    }
+    pidTiming.jitterSum += jitter;
+    if (latency > pidTiming.latencyMax) {
+        pidTiming.latencyMax = latency;
+    }
+    if (latency > PID_PERIOD_CYCLES) {
+        pidTiming.misses++;
+    }
+    pidTiming.cycles++;
+}
+
+// Cycle count at the tick edge that released the task. SysTick has
+// counted reload - current cycles since the last edge, and any whole
+// ticks the wake-up was late are added on. A tick between the reads
+// would split them, so they are taken again.
+static uint32_t pidReleaseCycles(TickType_t releaseTick) {
+    TickType_t tick;
+    uint32_t now;
+    uint32_t sinceEdge;
+    do {
+        tick = xTaskGetTickCount();
+        now = HWREG(CORE_DWT_CYCCNT);
+        sinceEdge = HWREG(CORE_ST_RELOAD) - HWREG(CORE_ST_CURRENT);
+    } while (tick != xTaskGetTickCount());
+    return now - sinceEdge - (tick - releaseTick) * (configCPU_CLOCK_HZ / configTICK_RATE_HZ);
+}
+
+// Gain per 1000000 to fixed point with the given fraction bits, rounded
+static int32_t pidGainQ(int32_t k, uint8_t bits) {
+    int64_t scaled = (int64_t) k * (1 << bits);
+    return (int32_t) ((scaled + ((scaled < 0) ? -500000 : 500000)) / 1000000);
+}
+
+// Integral gain per period, per 1000000
+static int32_t pidKiPeriod(const pidConfig_t* config, int32_t ki) {
+    return (config->integralMs != 0) ? ki * config->integralMs : ki * 1000;
+}
+
+// Sets up a controller from its config
+void pidInit(pidHandle_t* h, const pidConfig_t* config) {
+    *h = (pidHandle_t) {0};
+    h->config = config;
+    h->integralError = config->integralStart;
+    h->duty = config->offset;
+    h->setpointQ = ((1000 - config->setpointWeight) << 10) / 1000;
+    pidSetGains(h, config->kp, config->ki, config->kd);
+}
+
+// Sets the gains (per 1000) and their fixed point forms
+void pidSetGains(pidHandle_t* h, int32_t kp, int32_t ki, int32_t kd) {
+    const pidConfig_t* config = h->config;
+    const uint8_t errorBits = config->errorBits;
+    h->kp = kp;
+    h->ki = ki;
+    h->kd = kd;
+    h->kiPeriod = pidKiPeriod(config, ki);
+    // Integral change that takes windupGain of one duty step back off
+    // the output
+    h->windupQ = (ki != 0)
+               ? (int32_t) (((int64_t) config->windupGain * 1000 << (16 + errorBits)) / h->kiPeriod)
+               : 0;
+    // Hold the integral's largest share of the output
+    h->integralMax = (ki != 0)
+                   ? (int32_t) ((int64_t) config->integralMax * pidKiPeriod(config, config->ki)
+                                / h->kiPeriod)
+                   : config->integralMax;
+    h->gainsPI = PID_PACK(pidGainQ(kp * 1000, PID_GAIN_BITS - errorBits),
+                          pidGainQ(h->kiPeriod, PID_GAIN_BITS - errorBits + config->integralShift));
+    h->kdQ = pidGainQ(kd * 1000, PID_KD_BITS);
+#if PID_USE_FLOAT
+    h->kpF = kp / (1000.0f * (1 << PID_DIFF_FRAC_BITS));
+    h->kiF = h->kiPeriod / (1000000.0f * (1 << errorBits));
+    h->kdF = kd / (1000.0f * (1 << PID_DIFF_FRAC_BITS));
+#endif
+}
+
+// Sets new gains without a step in the output
+static void pidTransfer(pidHandle_t* h, int32_t kp, int32_t ki, int32_t kd) {
+    // Bumpless transfer: the integral takes up the change in the P and D
+    // terms so the output stays where it was
+    // output, per 1000000 and with errorBits
+    if (ki != 0) {
+        const int64_t diffScale = (int64_t) 1000 * (1 << h->config->errorBits);
+        const int64_t kiPeriod = pidKiPeriod(h->config, ki);
+        int64_t output = (int64_t) h->propError * h->kp * 1000
+                       + (int64_t) h->integralError * h->kiPeriod
+                       + (((int64_t) h->diffError * h->kd * diffScale) >> PID_DIFF_FRAC_BITS);
+        int64_t others = (int64_t) h->propError * kp * 1000
+                       + (((int64_t) h->diffError * kd * diffScale) >> PID_DIFF_FRAC_BITS);
+        // Rounded, so a run of transfers does not drift
+        int64_t integral = output - others;
+        h->integralError = (int32_t) ((integral + ((integral < 0) ? -kiPeriod : kiPeriod) / 2)
+                                      / kiPeriod);
+    }
+    pidSetGains(h, kp, ki, kd);
+    if      (h->integralError >  h->integralMax) {h->integralError =  h->integralMax;}
+    else if (h->integralError < -h->integralMax) {h->integralError = -h->integralMax;}
+}
+
+#if PID_FF_ENABLE
+// Takes a new torque feedforward gain at the given main duty. The tail
+// integral gives back what the feedforward takes over, so the tail duty
+// does not step.
+static void pidTorqueApply(pidHandle_t* tail, int32_t torqueQ, int32_t mainDuty) {
+    int32_t change = (mainDuty * (torqueQ - pidTorqueQ) + (1 << (PID_GAIN_BITS - 1))) >> PID_GAIN_BITS;
+    if (tail->kiPeriod != 0) {
+        tail->integralError -= (int32_t) ((int64_t) change * 1000000 * (1 << tail->config->errorBits)
+                                          / tail->kiPeriod);
+        if      (tail->integralError >  tail->integralMax) {tail->integralError =  tail->integralMax;}
+        else if (tail->integralError < -tail->integralMax) {tail->integralError = -tail->integralMax;}
+    }
+    pidTorqueQ = torqueQ;
+}
+#endif
+
+// Control loop timing
+const pidTiming_t* pidGetTiming(void) {
+    return &pidTiming;
+}
+
+// Starts or ends learning the torque feedforward gain. The PID task
+// takes the samples and fits the gain when it sees the change.
+void pidTorqueCalibrate(bool on) {
+    pidTorqueRequest = on ? PID_CAL_RUN : PID_CAL_STOP;
+}
+
+// Ends learning the torque feedforward gain, throwing the samples away
+void pidTorqueCalibrateCancel(void) {
+    pidTorqueRequest = PID_CAL_CANCEL;
+}
+
+// Torque feedforward gain (per 1000 of main duty)
+int32_t pidGetTorqueGain(void) {
+    return (pidTorqueQ * 1000) >> PID_GAIN_BITS;
+}
+
+// Starts or stops the relay autotune. The PID task runs it, the state
+// is set here so a caller never sees the result of an earlier run.
+void pidAutotune(bool on) {
+    if (on) {
+        pidAutotuneState = PID_AT_RUNNING;
+    }
+    pidAutotuneRequest = on;
+}
+
+// Progress of the last autotune
+enum pidTuneStates pidGetAutotuneState(void) {
+    return pidAutotuneState;
+}
+
+// Starts a relay about bias. h is the loop driving the rotor, its
+// integral is held while the relay has the rotor.
+static void pidRelayStart(pidRelay_t* r, const pidHandle_t* h, int32_t bias,
+                          int32_t amplitude, int32_t hysteresis) {
+    *r = (pidRelay_t) {0};
+    r->bias = bias;
+    r->amplitude = amplitude;
+    r->hysteresis = hysteresis << PID_DIFF_FRAC_BITS;
+    r->sign = 1;
+    r->savedIntegral = h->integralError;
+}
+
+// One period of the relay. Switches with hysteresis on the error (Q8)
+// and times each oscillation from one switch up to the next.
+static int32_t pidRelayStep(pidRelay_t* r, int32_t error) {
+    r->time++;
+    if (error > r->errorMax) {r->errorMax = error;}
+    if (error < r->errorMin) {r->errorMin = error;}
+    if (r->sign > 0 && error < -r->hysteresis) {
+        r->sign = -1;
+    } else if (r->sign < 0 && error > r->hysteresis) {
+        r->sign = 1;
+        if (r->lastRise != 0) {
+            if (r->cycles >= PID_AT_SKIP_CYCLES) {
+                r->periodSum += r->time - r->lastRise;
+                r->amplitudeSum += (r->errorMax - r->errorMin) / 2;
+            }
+            r->cycles++;
+        }
+        r->lastRise = r->time;
+        r->errorMax = r->errorMin = error;
+    }
+    return r->bias + r->sign * r->amplitude;
+}
+
+// Gains (per 1000) from a finished relay by PID_AUTOTUNE_RULE, reported
+// over UART. Returns false if the relay gave nothing to go on.
+static bool pidRelayTune(const pidRelay_t* r, const char* name, pidGains_t* gains) {
+    const int32_t* rule = pidTuneRules[PID_AUTOTUNE_RULE];
+    const uint32_t measured = PID_AT_CYCLES;
+    int32_t a = r->amplitudeSum / measured;
+    if (a <= 0 || r->periodSum == 0) {
+        return false;
+    }
+    // Ku = 4d / (pi a), per 1000, pi as 355/113
+    int32_t ku = (int32_t) (((int64_t) 4 * 1000 * 113 * r->amplitude << PID_DIFF_FRAC_BITS)
+                            / ((int64_t) 355 * a));
+    int32_t tu = r->periodSum * PID_LOOP_DELAY / measured;
+    int32_t ti = rule[1] * tu / 1000;
+    int32_t td = rule[2] * tu / 1000;
+    int32_t kp = rule[0] * ku / 1000;
+    int32_t ki = (ti > 0) ? kp * PID_TASK_DELAY / ti : 0;
+    // Negative like the hand tuned kd, to suit the sign of diffError
+    int32_t kd = -(kp * td / PID_TASK_DELAY);
+    // The kernel takes gains below 1000
+    gains->kp = (kp > 999) ? 999 : kp;
+    gains->ki = (ki > 999) ? 999 : ki;
+    gains->kd = (kd < -999) ? -999 : kd;
+
+    char str[48];
+    usprintf(str, "pidAT %s Ku %d Tu %dms\r\n", name, ku, tu);
+    uartSend(str);
+    usprintf(str, "pidAT %s kp %d ki %d kd %d\r\n", name, gains->kp, gains->ki, gains->kd);
+    uartSend(str);
+    return true;
+}
+
+#if PID_CASCADE
+// Rate target (Q8 per second) of an outer P loop, from the weighted
+// error so no resolution is lost on the way to the inner loop
+static int32_t pidRateTarget(const pidHandle_t* h) {
+    int32_t target = (int32_t) (((int64_t) h->weightedError * h->kp) / 1000);
+    int32_t maxRate = h->config->maxDuty * (1 << PID_DIFF_FRAC_BITS);
+    int32_t minRate = h->config->minDuty * (1 << PID_DIFF_FRAC_BITS);
+    if      (target > maxRate) {target = maxRate;}
+    else if (target < minRate) {target = minRate;}
+    return target;
+}
+#endif
+
 // Task: defines pid handles for main and tail rotors. Receieves current
 // and target values for each rotor. Sends calculated pwm values to the
-// pwm queue
+// pwm queue. Released every PID_LOOP_DELAY ms of absolute time, so the
+// period does not stretch with the time each cycle takes. With
+// PID_CASCADE the position loops run every PID_CASCADE_DIVIDER periods
+// and set the targets of the rate loops, which drive the rotors.
 void pidTask(void *pvParameters) {
-    pidHandle_t altitude = {0};
-    altitude.kp = MAIN_PROP_GAIN;
-    altitude.ki = MAIN_INT_GAIN;
-    altitude.integralError = -(MAIN_DUTY_OFFSET*1000/2 / MAIN_INT_GAIN);
-    altitude.kd = MAIN_DIFF_GAIN;
-    altitude.offset = MAIN_DUTY_OFFSET;
-    pidHandle_t yaw = {0};
-    yaw.kp = TAIL_PROP_GAIN;
-    yaw.ki = TAIL_INT_GAIN;
-    yaw.kd = TAIL_DIFF_GAIN;
-    yaw.offset = TAIL_DUTY_OFFSET;
-
-    int i;
+    pidHandle_t altitude;
+    pidHandle_t yaw;
+    pidInit(&altitude, &pidConfigs[PID_MAIN]);
+    pidInit(&yaw, &pidConfigs[PID_TAIL]);
+#if PID_CASCADE
+    pidHandle_t altitudeRate;
+    pidHandle_t yawRate;
+    pidInit(&altitudeRate, &pidConfigs[PID_MAIN_RATE]);
+    pidInit(&yawRate, &pidConfigs[PID_TAIL_RATE]);
+    pidHandle_t* mainLoop = &altitudeRate;
+    pidHandle_t* tailLoop = &yawRate;
+#else
+    pidHandle_t* mainLoop = &altitude;
+    pidHandle_t* tailLoop = &yaw;
+#endif
+
+    int i = 0;
+    // Torque calibration: tail duty against main duty, fitted through
+    // the origin
+    bool calibrating = false;
+    uint32_t calSamples = 0;
+    uint64_t calSumXX = 0;
+    int64_t calSumXY = 0;
+    int32_t yawPeak = 0;
+    // Autotune: the axis under the relay, PID_NUM_AXES for none
+    bool tuneRequested = false;
+    int tuneAxis = PID_NUM_AXES;
+    int tuneStart = 0;
+    pidRelay_t relay = {0};
+    pidGains_t mainGains;
+    pidGains_t tailGains;
+    TickType_t lastWake = xTaskGetTickCount();
+    vTaskDelayUntil(&lastWake, PID_LOOP_DELAY / portTICK_RATE_MS);
     while (1) {
+        // Each period is timed from the tick edge it was released on, so
+        // a late first wake-up does not shift the later ones
+        uint32_t start = HWREG(CORE_DWT_CYCCNT);
+        uint32_t release = pidReleaseCycles(lastWake);
         i++;
         // Get target
         while(uxQueueMessagesWaiting(xControlTargetQueue) > 0) {
@@ -52,74 +479,357 @@ void pidTask(void *pvParameters) {
                 uartSend("targetRxFail\r\n");
             }
             altitude.target = recievedTarget.altitude;
-            yaw.target = recievedTarget.yaw;
+            yaw.target = yawDegToBam(recievedTarget.yaw);
         }
         // Get current position values
         while(uxQueueMessagesWaiting(xMeasuredAltitudeQueue) > 0) {
-            if(xQueueReceive(xMeasuredAltitudeQueue, (void *) &altitude.current, (TickType_t) 10) != pdPASS) {
+            altitudeMessage_t measured;
+            if(xQueueReceive(xMeasuredAltitudeQueue, (void *) &measured, (TickType_t) 10) != pdPASS) {
                 uartSend("altCurrentRxFail\r\n");
             }
+            altitude.current = measured.altitude;
+            altitude.rate = measured.velocity;
         }
         while(uxQueueMessagesWaiting(xMeasuredYawQueue) > 0) {
-            if(xQueueReceive(xMeasuredYawQueue, (void *) &yaw.current, (TickType_t) 10) != pdPASS) {
+            yawMessage_t measured;
+            if(xQueueReceive(xMeasuredYawQueue, (void *) &measured, (TickType_t) 10) != pdPASS) {
                 uartSend("yawRxFail\r\n");
             }
+            yaw.current = measured.angle;
+            yaw.rate = measured.rate;
         }
 
+#if PID_CASCADE
+        if ((i - 1) % PID_CASCADE_DIVIDER == 0) {
+            // Outer loops: rate targets from the position errors
+            uint32_t outerStart = HWREG(CORE_DWT_CYCCNT);
+            pidCalcErrors(&altitude);
+            pidCalcErrors(&yaw);
+            altitudeRate.target = pidRateTarget(&altitude);
+            yawRate.target = pidRateTarget(&yaw);
+            pidTiming.outerCycles = HWREG(CORE_DWT_CYCCNT) - outerStart;
+        }
+        // Inner loops on the estimated rates (Q8 per second)
+        uint32_t innerStart = HWREG(CORE_DWT_CYCCNT);
+        altitudeRate.current = altitude.rate * (1 << (PID_DIFF_FRAC_BITS - ALT_FRAC_BITS));
+        yawRate.current = yaw.rate;
+#else
+        uint32_t innerStart = HWREG(CORE_DWT_CYCCNT);
+#endif
         // Calculate the errors
-        pidCalcErrors(&altitude);
-        pidCalcErrors(&yaw);
+        pidCalcErrors(mainLoop);
+        pidCalcErrors(tailLoop);
+#if PID_SCHEDULE_BY_DUTY
+        int32_t scheduleIndex = pwmGetMainDuty();
+#else
+        int32_t scheduleIndex = altitude.current;
+#endif
+        pidSchedule(mainLoop, scheduleIndex);
+        pidSchedule(tailLoop, scheduleIndex);
 
-        if (altitude.integralError >  MAIN_ERROR_MAX) {altitude.integralError =  MAIN_ERROR_MAX;}
-        if (altitude.integralError < -MAIN_ERROR_MAX) {altitude.integralError = -MAIN_ERROR_MAX;}
-        if (yaw.integralError >  TAIL_ERROR_MAX) {yaw.integralError =  TAIL_ERROR_MAX;}
-        if (yaw.integralError < -TAIL_ERROR_MAX) {yaw.integralError = -TAIL_ERROR_MAX;}
+#if PID_AUTOTUNE_ENABLE
+        // Relay autotune takes over one rotor at a time. The loop keeps
+        // running underneath and the kernel puts out the relay duty.
+        bool request = pidAutotuneRequest;
+        if (request && !tuneRequested) {
+            tuneAxis = PID_MAIN;
+            tuneStart = i;
+            pidRelayStart(&relay, mainLoop, mainLoop->duty, PID_AT_MAIN_RELAY, PID_AT_MAIN_HYST);
+            pidAutotuneState = PID_AT_RUNNING;
+        }
+        tuneRequested = request;
+        if (tuneAxis != PID_NUM_AXES) {
+            pidHandle_t* tuneLoop = (tuneAxis == PID_MAIN) ? mainLoop : tailLoop;
+            bool finished = false;
+            // Abort on a stop request or outside the safe envelope
+            if (!request ||
+                altitude.current < PID_AT_ALT_MIN || altitude.current > PID_AT_ALT_MAX ||
+                abs(yaw.error) > (PID_AT_YAW_MAX << PID_DIFF_FRAC_BITS) ||
+                i - tuneStart > PID_AT_TIMEOUT_MS / PID_LOOP_DELAY) {
+                tuneLoop->integralError = relay.savedIntegral;
+                tuneLoop->hold = false;
+                tuneAxis = PID_NUM_AXES;
+                pidAutotuneState = PID_AT_ABORTED;
+                uartSend("pidAT abort\r\n");
+            } else {
+                int32_t duty = pidRelayStep(&relay, (tuneAxis == PID_MAIN) ? altitude.error : yaw.error);
+                if      (duty > tuneLoop->config->maxDuty) {duty = tuneLoop->config->maxDuty;}
+                else if (duty < tuneLoop->config->minDuty) {duty = tuneLoop->config->minDuty;}
+                tuneLoop->hold = true;
+                tuneLoop->holdDuty = duty;
+                finished = (relay.cycles >= PID_AT_SKIP_CYCLES + PID_AT_CYCLES);
+            }
+            if (finished) {
+                tuneLoop->integralError = relay.savedIntegral;
+                tuneLoop->hold = false;
+                if (tuneAxis == PID_MAIN && pidRelayTune(&relay, "main", &mainGains)) {
+                    // Main done, on to the tail
+                    tuneAxis = PID_TAIL;
+                    tuneStart = i;
+                    pidRelayStart(&relay, tailLoop, tailLoop->duty, PID_AT_TAIL_RELAY, PID_AT_TAIL_HYST);
+                } else if (tuneAxis == PID_TAIL && pidRelayTune(&relay, "tail", &tailGains)) {
+#if PID_AUTOTUNE_APPLY && !PID_CASCADE
+                    pidTransfer(&altitude, mainGains.kp, mainGains.ki, mainGains.kd);
+                    pidTransfer(&yaw, tailGains.kp, tailGains.ki, tailGains.kd);
+                    altitude.fixedGains = true;
+                    yaw.fixedGains = true;
+                    uartSend("pidAT applied\r\n");
+#endif
+                    tuneAxis = PID_NUM_AXES;
+                    pidAutotuneState = PID_AT_DONE;
+                } else {
+                    tuneAxis = PID_NUM_AXES;
+                    pidAutotuneState = PID_AT_ABORTED;
+                    uartSend("pidAT no oscillation\r\n");
+                }
+            }
+        }
+#endif
 
         // Calculate the PWM duty cycles
         pwmUpdateMessage_t pwm;
-        pwm.main = pidCalcDutyCycle(&altitude);
-        pwm.tail = pidCalcDutyCycle(&yaw);
+#if PID_KERNEL_CHECK
+        // Before the kernel, which may wind back the integrals. The tail
+        // uses last period's feedforward.
+        uint32_t referenceStart = HWREG(CORE_DWT_CYCCNT);
+        int16_t referenceMain = pidCalcDutyCycle(mainLoop);
+        int16_t referenceTail = pidCalcDutyCycle(tailLoop);
+        pidTiming.referenceCycles = HWREG(CORE_DWT_CYCCNT) - referenceStart;
+#endif
+        uint32_t kernelStart = HWREG(CORE_DWT_CYCCNT);
+        pidCalcDutyCycles(mainLoop, tailLoop, &pwm.main, &pwm.tail);
+        pidTiming.kernelCycles = HWREG(CORE_DWT_CYCCNT) - kernelStart;
+        pidTiming.innerCycles = HWREG(CORE_DWT_CYCCNT) - innerStart;
+#if PID_KERNEL_CHECK
+        // The reference truncates P+I and D apart, so may be 2 below
+        if (abs(pwm.main - referenceMain) > 2 || abs(pwm.tail - referenceTail) > 2) {
+            pidTiming.mismatches++;
+        }
+#endif
 
         // Send calculated values to the the pwm update task
         xQueueSend(xPWMQueue, (void *) &pwm, (TickType_t) 10);
+        pidTimingUpdate(start - release, HWREG(CORE_DWT_CYCCNT) - release);
+
+        // Largest yaw error since the last report
+        if (abs(yaw.error) > yawPeak) {
+            yawPeak = abs(yaw.error);
+        }
+#if PID_FF_ENABLE
+        enum pidCalRequests calRequest = pidTorqueRequest;
+        if (calRequest == PID_CAL_RUN) {
+            if (!calibrating) {
+                calibrating = true;
+                calSamples = 0;
+                calSumXX = 0;
+                calSumXY = 0;
+            }
+            // Only steady hover with neither rotor at a limit
+            if (abs(yaw.error) < (PID_FF_CAL_YAW_BAND << PID_DIFF_FRAC_BITS) &&
+                abs(yaw.rate) < PID_FF_CAL_RATE_BAND &&
+                pwm.main > MAIN_MIN_DUTY && pwm.main < MAIN_MAX_DUTY &&
+                pwm.tail > TAIL_MIN_DUTY && pwm.tail < TAIL_MAX_DUTY) {
+                int32_t tailTorque = pwm.tail - TAIL_DUTY_OFFSET;
+                calSumXX += pwm.main * pwm.main;
+                calSumXY += pwm.main * tailTorque;
+                calSamples++;
+            }
+        } else if (calibrating) {
+            calibrating = false;
+            char cal[32];
+            if (calRequest == PID_CAL_CANCEL) {
+                // Keep the gain there was before
+                usprintf(cal, "pidFF cal cancelled\r\n");
+            } else if (calSamples >= PID_FF_CAL_MIN_SAMPLES && calSumXX > 0) {
+                pidTorqueApply(tailLoop, (int32_t) (calSumXY * (1 << PID_GAIN_BITS) / (int64_t) calSumXX),
+                               pwm.main);
+                usprintf(cal, "pidFF cal %d/1000 n%d\r\n", pidGetTorqueGain(), calSamples);
+            } else {
+                usprintf(cal, "pidFF cal fail n%d\r\n", calSamples);
+            }
+            uartSend(cal);
+        }
+#endif
 
         // Print a bunch of shit
-        if (i % 10 == 0) {
-            char str[14];
+        if (i % (PID_REPORT_DIVIDER * PID_CASCADE_DIVIDER) == 0) {
+            char str[48];
             usprintf(str, "Alt: %d [%d] %4d\r\n", altitude.current, altitude.target, pwm.main);
             uartSend(str);
-            usprintf(str, "Yaw: %d [%d] %4d, %4d\r\n\r\n", yaw.current, yaw.target, pwm.tail, yaw.integralError);
+            usprintf(str, "Yaw: %d [%d] %4d, %4d\r\n\r\n", yawBamToDeg(yaw.current),
+                     yawBamToDeg(yaw.target), pwm.tail, tailLoop->integralError);
             uartSend(str);
+            // Release jitter min/mean/max and worst latency (us)
+            char timing[64];
+            const uint32_t cyclesPerUs = configCPU_CLOCK_HZ / 1000000;
+            usprintf(timing, "pidT %d/%d/%d %dus %dmiss\r\n",
+                     pidTiming.jitterMin / cyclesPerUs,
+                     (uint32_t) (pidTiming.jitterSum / pidTiming.cycles) / cyclesPerUs,
+                     pidTiming.jitterMax / cyclesPerUs,
+                     pidTiming.latencyMax / cyclesPerUs, pidTiming.misses);
+            uartSend(timing);
+            // Cycles per control step, against the reference if it is run
+            usprintf(timing, "pidK %dcyc %s\r\n", pidTiming.kernelCycles,
+                     PID_USE_FLOAT ? "float" : "fixed");
+            uartSend(timing);
+#if PID_CASCADE
+            // Cost of each loop, the outer at 1/PID_CASCADE_DIVIDER the rate
+            usprintf(timing, "pidC out %dcyc in %dcyc\r\n",
+                     pidTiming.outerCycles, pidTiming.innerCycles);
+#else
+            usprintf(timing, "pidC %dcyc\r\n", pidTiming.innerCycles);
+#endif
+            uartSend(timing);
+            // Feedforward gain and the worst yaw error it left
+            usprintf(timing, "pidFF %d/1000 pk %ddeg\r\n", pidGetTorqueGain(),
+                     (yawPeak + (1 << (PID_DIFF_FRAC_BITS - 1))) >> PID_DIFF_FRAC_BITS);
+            uartSend(timing);
+            yawPeak = 0;
+            // Encoder integrity counters, so lost edges show before a fault
+            const yawIntegrity_t* integrity = yawGetIntegrity();
+            usprintf(timing, "yawInt %d ill %d rep %d max %d flt\r\n", integrity->illegal,
+                     integrity->repeats, integrity->windowMax, integrity->faults);
+            uartSend(timing);
+#if PID_KERNEL_CHECK
+            usprintf(timing, "pidRef %dcyc %dmis\r\n",
+                     pidTiming.referenceCycles, pidTiming.mismatches);
+            uartSend(timing);
+#endif
         }
-        //Task delay
-        vTaskDelay(PID_TASK_DELAY / portTICK_RATE_MS);
+        //Wait for the next release
+        vTaskDelayUntil(&lastWake, PID_LOOP_DELAY / portTICK_RATE_MS);
     }
 }
 
 // Current PID error calculators
 void pidCalcErrors(pidHandle_t* h) {
-    int prevAltError = h->propError;
-    h->propError = h->target - h->current; // calculate proportional error
-    if(h->propError > 180) {
-        h->propError -= 360;
+    const pidConfig_t* config = h->config;
+    const int32_t scale = PID_DIFF_FRAC_BITS - config->inputBits;
+    const int32_t shift = PID_DIFF_FRAC_BITS - config->errorBits;
+    const int32_t half = 1 << (shift - 1);
+    int32_t diff;
+
+    if (config->isAngle) {
+        // Binary angles wrap by themselves, the difference is the short way round
+        h->error = yawBamToDegQ8((yawBam_t) ((uint32_t) h->target - (uint32_t) h->current));
+        h->weightedError = h->error;
+    } else {
+        h->error = (h->target - h->current) * (1 << scale);
+        // P sees setpointWeight of the target and all of the measurement
+        h->weightedError = h->error - ((h->target * h->setpointQ * (1 << scale)) >> 10);
+    }
+    // calculate proportional error, rounded to errorBits
+    h->propError = (h->weightedError + half) >> shift;
+
+    // calculate total integral error from the full error
+    h->integralError += (h->error + half) >> shift;
+    if      (h->integralError >  h->integralMax) {h->integralError =  h->integralMax;}
+    else if (h->integralError < -h->integralMax) {h->integralError = -h->integralMax;}
+
+    // Derivative on the measurement, so target steps give no kick. The
+    // error falls as the measurement rises.
+    if (config->useRate) {
+        diff = -(h->rate * PID_TASK_DELAY / 1000);
+    } else if (config->isAngle) {
+        diff = -yawBamToDegQ8((yawBam_t) ((uint32_t) h->current - (uint32_t) h->prevCurrent));
+    } else {
+        diff = -((h->current - h->prevCurrent) * (1 << scale));
+    }
+    h->prevCurrent = h->current;
+    h->diffError += (diff - h->diffError) >> config->diffFilter;
+}
+
+// Moves the gains along the axis schedule to the given altitude or duty,
+// without a step in the output. Breakpoints are evenly spaced so the
+// cost is the same wherever index falls.
+void pidSchedule(pidHandle_t* h, int32_t index) {
+    const pidGains_t* schedule = h->config->schedule;
+    if (schedule == NULL || h->fixedGains) {
+        return;
+    }
+    if      (index < 0)                 {index = 0;}
+    else if (index > PID_SCHEDULE_SPAN) {index = PID_SCHEDULE_SPAN;}
+    int32_t point = index / PID_SCHEDULE_STEP;
+    if (point > PID_SCHEDULE_POINTS - 2) {
+        point = PID_SCHEDULE_POINTS - 2;
     }
-    if (h->propError <= -180) {
-        h->propError += 360;
+    int32_t frac = index - point * PID_SCHEDULE_STEP;
+    const pidGains_t* lo = &schedule[point];
+    const pidGains_t* hi = &schedule[point + 1];
+    int32_t kp = lo->kp + (hi->kp - lo->kp) * frac / PID_SCHEDULE_STEP;
+    int32_t ki = lo->ki + (hi->ki - lo->ki) * frac / PID_SCHEDULE_STEP;
+    int32_t kd = lo->kd + (hi->kd - lo->kd) * frac / PID_SCHEDULE_STEP;
+    if (kp == h->kp && ki == h->ki && kd == h->kd) {
+        return;
     }
-    h->integralError += h->propError; // calculate total integral error
-    h->diffError = h->propError - prevAltError; // calculate differential error
+    pidTransfer(h, kp, ki, kd);
 }
 
 // Uses PID control to calculate duty cycle for each rotor
 int16_t pidCalcDutyCycle(pidHandle_t* h) {
+    // P and I per 1000000 and with errorBits
+    int64_t termsPI = (int64_t) h->propError * h->kp * 1000
+                    + (int64_t) h->integralError * h->kiPeriod;
     // Update main rotor duty cycle, impose limits
-    int16_t dutyCycle =
-            (h->propError * h->kp/1000) +
-            (h->integralError * h->ki/1000) +
-            (h->diffError * h->kd/1000) +
-            h->offset;
-    if      (dutyCycle > MAIN_MAX_DUTY) {dutyCycle = MAIN_MAX_DUTY;}
-    else if (dutyCycle < MAIN_MIN_DUTY) {dutyCycle = MAIN_MIN_DUTY;}
+    int32_t dutyCycle =
+            (int32_t) ((termsPI >> h->config->errorBits) / 1000000) +
+            ((h->diffError * h->kd/1000) >> PID_DIFF_FRAC_BITS) +
+            h->config->offset + h->feedforward;
+    if      (dutyCycle > h->config->maxDuty) {dutyCycle = h->config->maxDuty;}
+    else if (dutyCycle < h->config->minDuty) {dutyCycle = h->config->minDuty;}
     return dutyCycle;
 }
+
+// Limits an output and winds the integral back by windupGain of the
+// amount it was over
+static int16_t pidLimit(pidHandle_t* h, int32_t dutyCycle) {
+    int32_t limited = dutyCycle;
+    if      (limited > h->config->maxDuty) {limited = h->config->maxDuty;}
+    else if (limited < h->config->minDuty) {limited = h->config->minDuty;}
+    h->integralError += (int32_t) (((int64_t) (limited - dutyCycle) * h->windupQ) >> 16);
+    h->duty = limited;
+    return limited;
+}
+
+#if PID_USE_FLOAT
+// One axis of the float kernel. P takes the weighted error with its
+// fraction rather than the rounded propError.
+static int16_t pidKernelAxis(pidHandle_t* h) {
+    float duty = h->kpF * h->weightedError + h->kiF * h->integralError
+               + h->kdF * h->diffError + h->config->offset + h->feedforward;
+    return pidLimit(h, (int32_t) (duty + ((duty < 0) ? -0.5f : 0.5f)));
+}
+#else
+// One axis of the kernel. P and I go through one dual multiply-accumulate,
+// D through a single one, all landing in Q15.
+static int16_t pidKernelAxis(pidHandle_t* h) {
+    uint32_t errorsPI = PID_PACK(PID_SSAT16(h->propError),
+                                 PID_SSAT16(h->integralError >> h->config->integralShift));
+    int32_t diff = PID_SSAT16(h->diffError >> (PID_DIFF_FRAC_BITS - PID_KERNEL_DIFF_BITS));
+    int32_t acc = PID_SMLAD(errorsPI, h->gainsPI, 1 << (PID_GAIN_BITS - 1));
+    acc = PID_SMLABB(diff, h->kdQ, acc);
+    return pidLimit(h, PID_QADD(acc >> PID_GAIN_BITS, h->config->offset + h->feedforward));
+}
+#endif
+
+// Fixed point kernel: duty cycles for both rotors in one pass with no
+// division. Winds back the integrals of any output over its limits.
+void pidCalcDutyCycles(pidHandle_t* mainAxis, pidHandle_t* tailAxis,
+                       int16_t* mainDuty, int16_t* tailDuty) {
+    *mainDuty = pidKernelAxis(mainAxis);
+    if (mainAxis->hold) {
+        *mainDuty = mainAxis->holdDuty;
+    }
+#if PID_FF_ENABLE
+    // Tail duty for the torque of the main duty actually applied
+    int32_t change = *mainDuty - tailAxis->ffPrevInput;
+    tailAxis->ffPrevInput = *mainDuty;
+    tailAxis->feedforward = (*mainDuty * pidTorqueQ + change * pidTorqueRateQ
+                             + (1 << (PID_GAIN_BITS - 1))) >> PID_GAIN_BITS;
+#endif
+    *tailDuty = pidKernelAxis(tailAxis);
+    if (tailAxis->hold) {
+        *tailDuty = tailAxis->holdDuty;
+    }
+}
 /*--------------------------------------------------------------*/
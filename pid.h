@@ -10,57 +10,270 @@
  pid.c
 
  Module handles PID calculations for both main and tail
- rotors. Calculates resulting PWM values for main and tail
+ rotors. Calculates resulting PWM values for main and tail.
+ Both axes go through one fixed point kernel. Gains are
+ held in Q15 (kd in Q11) and the terms are summed with the
+ M4 dual multiply-accumulate where the compiler offers it.
+ PID_USE_FLOAT builds a single precision kernel instead.
+ Each controller is a pidHandle_t set up from a row of the
+ pidConfig_t table, which holds its gains and limits.
 ----------------------------------------------------------------*/
 #ifndef PID_H_
 #define PID_H_
 /* Macro Definitions -------------------------------------------*/
+#define PID_RIG             2     // Which heli the gains are for
+
+#if PID_RIG == 1
+#define MAIN_PROP_GAIN      (180/2)
+#define MAIN_DIFF_GAIN      (-50/2)
+#define MAIN_INT_GAIN       5
+#define MAIN_ERROR_MAX      (50*1000 / MAIN_INT_GAIN)
+#define MAIN_DUTY_OFFSET    20    // Duty cycle offset to offset gravity
+
+// Tail rotor
+#define TAIL_PROP_GAIN      (200/2)
+#define TAIL_DIFF_GAIN      (-200)
+#define TAIL_INT_GAIN       (20/2)
+#define TAIL_DUTY_OFFSET    5
+#define TAIL_ERROR_MAX      (50*1000/ TAIL_INT_GAIN)  // Max duty component / ki
+#else
 //Heli 2 WORKING GAINS:
 #define MAIN_PROP_GAIN      180
-#define MAIN_DIFF_GAIN      -50
+#define MAIN_DIFF_GAIN      (-50)
 #define MAIN_INT_GAIN       5
 #define MAIN_ERROR_MAX      (30*1000 / MAIN_INT_GAIN)
 #define MAIN_DUTY_OFFSET    20    // Duty cycle offset to offset gravity
 
 // Tail rotor
 #define TAIL_PROP_GAIN      180
-#define TAIL_DIFF_GAIN      -200
+#define TAIL_DIFF_GAIN      (-200)
 #define TAIL_INT_GAIN       8
 #define TAIL_DUTY_OFFSET    5
 #define TAIL_ERROR_MAX      (40*1000/ TAIL_INT_GAIN)  // Max duty component / ki
+#endif
+
+// Gain scheduling. Each axis has a row of gains at PID_SCHEDULE_POINTS
+// evenly spaced breakpoints over 0 to PID_SCHEDULE_SPAN of altitude (or
+// main duty), interpolated each period. The integral is adjusted so the
+// output does not jump when the gains move.
+#define PID_SCHEDULE_ENABLE 1
+#define PID_SCHEDULE_BY_DUTY 0    // Index by main duty instead of altitude
+#define PID_SCHEDULE_POINTS 5
+#define PID_SCHEDULE_SPAN   100   // Altitude percent or duty
+#define PID_SCHEDULE_STEP   (PID_SCHEDULE_SPAN / (PID_SCHEDULE_POINTS - 1))
+
+// Share of the target in the proportional term (per 1000). Less than
+// 1000 softens the response to target steps. Angle axes must use 1000.
+#define MAIN_SETPOINT_WEIGHT 1000
+#define TAIL_SETPOINT_WEIGHT 1000
+// Derivative low pass, alpha = 1/2^bits
+#define MAIN_DIFF_FILTER    0     // Rate is already filtered by the estimator
+#define TAIL_DIFF_FILTER    1
+// Back-calculation anti-windup: share of any output over the limits
+// taken off the integral each period (per 1000)
+#define MAIN_WINDUP_GAIN    300
+#define TAIL_WINDUP_GAIN    300
+
+// Main rotor torque feedforward. The tail duty takes PID_FF_GAIN/1000
+// of the main duty and PID_FF_RATE_GAIN/1000 of its change per period,
+// in the same step the main duty is worked out. pidTorqueCalibrate
+// learns the gain from steady hover and keeps it until reset.
+#define PID_FF_ENABLE       1
+#define PID_FF_GAIN         0
+#define PID_FF_RATE_GAIN    0
+#define PID_FF_CAL_YAW_BAND 3         // (degrees) Steady hover for a sample
+#define PID_FF_CAL_RATE_BAND (5 << 8) // (deg/s Q8)
+#define PID_FF_CAL_MIN_SAMPLES 50
+
+// Relay feedback autotune (special pattern 4). Each axis in turn is
+// driven by a relay of +-PID_AT_*_RELAY duty about its hover duty while
+// the other stays under PID control. The ultimate gain and period of
+// the oscillation give the gains by PID_AUTOTUNE_RULE.
+#define PID_AUTOTUNE_ENABLE 1
+#define PID_AUTOTUNE_RULE   PID_RULE_TYREUS_LUYBEN
+#define PID_AUTOTUNE_APPLY  0     // Fly on the new gains until landing
+#define PID_AT_MAIN_RELAY   8     // (duty) Relay amplitude
+#define PID_AT_TAIL_RELAY   8
+#define PID_AT_MAIN_HYST    1     // (%) Relay hysteresis
+#define PID_AT_TAIL_HYST    2     // (degrees)
+#define PID_AT_SKIP_CYCLES  2     // Oscillations to settle before measuring
+#define PID_AT_CYCLES       4     // Oscillations measured
+#define PID_AT_TIMEOUT_MS   30000 // Per axis
+#define PID_AT_ALT_MIN      15    // (%) Abort outside these altitudes
+#define PID_AT_ALT_MAX      85
+#define PID_AT_YAW_MAX      60    // (degrees) Abort on a larger yaw error
+
+#define PID_TASK_DELAY      40    // (ms) Control period
+#define PID_REPORT_DIVIDER  10    // Control periods per telemetry report
 
-#define PID_TASK_DELAY      40
-
-//#define MAIN_PROP_GAIN      180/2
-//#define MAIN_DIFF_GAIN      -50/2
-//#define MAIN_INT_GAIN       5
-//#define MAIN_ERROR_MAX      (50*1000 / MAIN_INT_GAIN)
-//#define MAIN_DUTY_OFFSET    20    // Duty cycle offset to offset gravity
-//
-//// Tail rotor
-//#define TAIL_PROP_GAIN      200/2
-//#define TAIL_DIFF_GAIN      -200
-//#define TAIL_INT_GAIN       20/2
-//#define TAIL_DUTY_OFFSET    5
-//#define TAIL_ERROR_MAX      (50*1000/ TAIL_INT_GAIN)  // Max duty component / ki
-//
-//#define PID_TASK_DELAY      40
+// Cascaded loops. The position loops above become P loops that set a
+// rate target every PID_TASK_DELAY, and inner PID loops drive the
+// rotors from the estimated rates every PID_RATE_DELAY. The inner gains
+// start from the position gains split at the outer gain. The rates and
+// their targets stay in Q8 and the inner errors keep PID_RATE_ERROR_BITS
+// through the kernel.
+#define PID_CASCADE         0
+#define PID_RATE_DELAY      10    // (ms) Inner loop period, the yaw sensor period
+#define MAIN_OUTER_GAIN     1500  // Rate target per unit of error (per 1000 per s)
+#define TAIL_OUTER_GAIN     2000
+#define PID_OUTER_ERROR_BITS 2    // Outer gains may then be up to 4000
+#define MAIN_RATE_MAX       40    // (%/s) Rate target limits
+#define TAIL_RATE_MAX       90    // (deg/s)
+#define PID_RATE_ERROR_BITS 4     // Fraction bits of the inner propError and integralError
+#define PID_RATE_INT_SHIFT  6     // Inner integralError >> shift goes into the kernel
+// Inner integral gains are per 1000 per second, the position ki per
+// period being far below one at the inner period
+#define MAIN_RATE_PROP_GAIN (MAIN_PROP_GAIN * 1000 / MAIN_OUTER_GAIN)
+#define MAIN_RATE_INT_GAIN  ((MAIN_INT_GAIN * 1000 * 1000 / PID_TASK_DELAY + MAIN_OUTER_GAIN / 2) \
+                             / MAIN_OUTER_GAIN)
+#define MAIN_RATE_DIFF_GAIN 0
+#define MAIN_RATE_ERROR_MAX ((30*1000*1000 / (MAIN_RATE_INT_GAIN * PID_RATE_DELAY)) \
+                             << PID_RATE_ERROR_BITS)
+#define MAIN_RATE_INT_START (-((MAIN_DUTY_OFFSET*1000*1000/2 / (MAIN_RATE_INT_GAIN * PID_RATE_DELAY)) \
+                               << PID_RATE_ERROR_BITS))
+#define TAIL_RATE_PROP_GAIN (TAIL_PROP_GAIN * 1000 / TAIL_OUTER_GAIN)
+#define TAIL_RATE_INT_GAIN  ((TAIL_INT_GAIN * 1000 * 1000 / PID_TASK_DELAY + TAIL_OUTER_GAIN / 2) \
+                             / TAIL_OUTER_GAIN)
+#define TAIL_RATE_DIFF_GAIN 0
+#define TAIL_RATE_ERROR_MAX ((40*1000*1000 / (TAIL_RATE_INT_GAIN * PID_RATE_DELAY)) \
+                             << PID_RATE_ERROR_BITS)
+#define RATE_DIFF_FILTER    2
+
+#if PID_CASCADE
+#define PID_CASCADE_DIVIDER (PID_TASK_DELAY / PID_RATE_DELAY)
+#else
+#define PID_CASCADE_DIVIDER 1
+#endif
+#define PID_LOOP_DELAY      (PID_TASK_DELAY / PID_CASCADE_DIVIDER) // (ms) Task period
+#define PID_PERIOD_CYCLES   (configCPU_CLOCK_HZ / 1000 * PID_LOOP_DELAY)
+#define PID_DIFF_FRAC_BITS  8     // Fraction bits of diffError and rate
+
+// Fixed point kernel. Gains above are per 1000 and must be below 1000
+// in size, times 2^errorBits for a loop that keeps fraction bits in
+// its errors. pid.c checks each one with PID_GAIN_CHECK. The kernel
+// takes diffError to PID_KERNEL_DIFF_BITS.
+#define PID_USE_DSP         1     // Use SMLAD/SSAT/QADD intrinsics if available
+#define PID_GAIN_BITS       15
+#define PID_KERNEL_DIFF_BITS 4
+#define PID_KD_BITS         (PID_GAIN_BITS - PID_KERNEL_DIFF_BITS)
+// Fails to compile unless gain k (per 1000000) fits a Q bits kernel gain
+#define PID_GAIN_Q(k, bits) ((int64_t) (k) * (1 << (bits)) / 1000000)
+#define PID_GAIN_CHECK(name, k, bits) \
+    typedef char name[(PID_GAIN_Q(k, bits) < 32768 && PID_GAIN_Q(k, bits) > -32768) ? 1 : -1]
+// Also run pidCalcDutyCycle each period and count cycles and mismatches
+#define PID_KERNEL_CHECK    0
+
+// Single precision kernel on the M4F FPU. The port only stacks FPU
+// registers for a task that has run an FPU instruction (lazy stacking),
+// so keep float maths to the PID task and the estimators and out of
+// the other tasks and all interrupt handlers. May be set on the
+// command line to build both kernels from one tree.
+#ifndef PID_USE_FLOAT
+#define PID_USE_FLOAT       0
+#endif
 /*--------------------------------------------------------------*/
 
 /* Type definitions --------------------------------------------*/
+// PID_MAIN and PID_TAIL are the position loops, the rate loops are
+// only used with PID_CASCADE
+enum pidAxes {PID_MAIN, PID_TAIL, PID_MAIN_RATE, PID_TAIL_RATE, PID_NUM_AXES};
+enum pidTuneRules {PID_RULE_ZIEGLER_NICHOLS, PID_RULE_TYREUS_LUYBEN, PID_RULE_NO_OVERSHOOT,
+                   PID_NUM_RULES};
+enum pidTuneStates {PID_AT_IDLE, PID_AT_RUNNING, PID_AT_DONE, PID_AT_ABORTED};
+enum pidCalRequests {PID_CAL_STOP, PID_CAL_RUN, PID_CAL_CANCEL};
+
+// Gains per 1000 at one schedule breakpoint
+typedef struct pidGains_t {
+    int16_t kp;
+    int16_t ki;
+    int16_t kd;
+} pidGains_t;
+
+typedef struct pidConfig_t {
+    int32_t kp;             // Gains per 1000
+    int32_t ki;
+    int32_t kd;
+    int32_t offset;         // Duty cycle added to the output
+    int32_t minDuty;        // Output limits
+    int32_t maxDuty;
+    int32_t integralMax;    // Hard limit on integralError at gain ki
+    int32_t integralStart;  // integralError at start
+    int32_t setpointWeight; // Share of the target in P (per 1000)
+    uint8_t diffFilter;     // Derivative low pass, alpha = 1/2^diffFilter
+    int32_t windupGain;     // Back-calculation gain (per 1000)
+    bool useRate;           // Take the derivative from rate instead of the measurement
+    bool isAngle;           // current and target are binary angles
+    uint8_t inputBits;      // Fraction bits of current and target
+    uint8_t errorBits;      // Fraction bits kept in propError and integralError
+    uint8_t integralShift;  // integralError >> integralShift goes into the kernel
+    int32_t integralMs;     // ki is per second at this period, 0 for ki per period
+    const pidGains_t* schedule; // PID_SCHEDULE_POINTS rows, or NULL for fixed gains
+} pidConfig_t;
+
 typedef struct pidHandle_t {
-    int32_t current;        // Current altitude (percent)
-    int32_t target;         // Target altitude
-    int32_t propError;      // Proportional error (degrees)
-    int32_t integralError;  // Integral error
-    int32_t diffError;      // differential error
-    int16_t duty;
+    const pidConfig_t* config;
+    int32_t current;        // Current altitude (percent) or yaw (yawBam_t)
+    int32_t prevCurrent;    // current at the last period
+    int32_t target;         // Target altitude or yaw
+    int32_t error;          // Target - current (Q8)
+    int32_t weightedError;  // error with the setpoint weight (Q8)
+    int32_t propError;      // weightedError to config errorBits
+    int32_t integralError;  // Integral of error to config errorBits
+    int32_t diffError;      // Filtered derivative of the measurement, per PID period (Q8)
+    int32_t rate;           // Measured rate of change per second (Q8)
+    int16_t duty;           // Last output
+    int32_t feedforward;    // Duty added to the output this period
+    int16_t ffPrevInput;    // Feedforward input last period
+    bool fixedGains;        // Gains set at runtime, the schedule is not followed
+    bool hold;              // Put out holdDuty instead (autotune relay)
+    int16_t holdDuty;
     int32_t kp;
     int32_t ki;
     int32_t kd;
-    int32_t offset;
+    int32_t kiPeriod;       // ki per period, per 1000000
+    int32_t integralMax;    // config integralMax for the present ki
+    int32_t setpointQ;      // (1000 - setpointWeight) / 1000 (Q10)
+    int32_t windupQ;        // Integral change per duty over the limits (Q16)
+    uint32_t gainsPI;       // kp | ki << 16, Q15 less errorBits, packed for SMLAD
+    int16_t kdQ;            // kd (Q11)
+#if PID_USE_FLOAT
+    float kpF;              // kp per unit of weightedError (Q8)
+    float kiF;              // ki per unit of integralError
+    float kdF;              // kd per unit of diffError (Q8)
+#endif
 } pidHandle_t;
 
+// Control loop timing, in CPU cycles from each release
+typedef struct pidTiming_t {
+    uint32_t cycles;        // Control periods run
+    uint32_t misses;        // Periods that finished after the next release
+    uint32_t jitterMin;     // Release to start of the period
+    uint32_t jitterMax;
+    uint64_t jitterSum;
+    uint32_t latencyMax;    // Release to the duty cycles being sent
+    uint32_t kernelCycles;  // Last pidCalcDutyCycles run
+    uint32_t outerCycles;   // Last run of both outer loops (PID_CASCADE)
+    uint32_t innerCycles;   // Last run of both rotor loops, errors to duty
+    uint32_t referenceCycles; // Last two pidCalcDutyCycle runs (PID_KERNEL_CHECK)
+    uint32_t mismatches;    // Duty more than 2 from pidCalcDutyCycle (PID_KERNEL_CHECK)
+} pidTiming_t;
+
+// One relay feedback experiment
+typedef struct pidRelay_t {
+    int32_t bias;           // Duty the relay switches about
+    int32_t amplitude;      // Duty either side of bias
+    int32_t hysteresis;     // (Q8)
+    int32_t sign;           // Present relay side
+    uint32_t time;          // Periods since the start
+    uint32_t lastRise;      // time of the last switch up, 0 for none
+    int32_t errorMax;       // Error range of this oscillation (Q8)
+    int32_t errorMin;
+    uint32_t cycles;        // Oscillations seen
+    uint32_t periodSum;     // Over the measured oscillations (periods)
+    int32_t amplitudeSum;   // Half peak to peak error (Q8)
+    int32_t savedIntegral;  // Put back when the relay lets go
+} pidRelay_t;
+
 /* External globals ----------------------------------------*/
 extern QueueHandle_t xYawDegreesQueue;
 extern QueueHandle_t xAltQueue;
@@ -74,8 +287,33 @@ extern QueueHandle_t xControlTargetQueue;
 void pidTask(void *pvParameters);
 // Current PID error calculators
 void pidCalcErrors(pidHandle_t* h);
-// Uses PID control to calculate duty cycle for each rotor
+// Sets up a controller from its config
+void pidInit(pidHandle_t* h, const pidConfig_t* config);
+// Sets the gains (per 1000) and their fixed point forms
+void pidSetGains(pidHandle_t* h, int32_t kp, int32_t ki, int32_t kd);
+// Moves the gains along the axis schedule to the given altitude or duty,
+// without a step in the output
+void pidSchedule(pidHandle_t* h, int32_t index);
+// Uses PID control to calculate duty cycle for each rotor. Reference
+// version with a divide per term.
 int16_t pidCalcDutyCycle(pidHandle_t* h);
+// Fixed point kernel: duty cycles for both rotors in one pass with no
+// division. Winds back the integrals of any output over its limits.
+void pidCalcDutyCycles(pidHandle_t* mainAxis, pidHandle_t* tailAxis,
+                       int16_t* mainDuty, int16_t* tailDuty);
+// Control loop timing
+const pidTiming_t* pidGetTiming(void);
+// Starts or ends learning the torque feedforward gain. When it ends the
+// gain is fitted to the steady hover samples taken in between.
+void pidTorqueCalibrate(bool on);
+// Ends learning the torque feedforward gain and keeps the old gain
+void pidTorqueCalibrateCancel(void);
+// Torque feedforward gain (per 1000 of main duty)
+int32_t pidGetTorqueGain(void);
+// Starts or stops the relay autotune. Stopping a run aborts it.
+void pidAutotune(bool on);
+// Progress of the last autotune
+enum pidTuneStates pidGetAutotuneState(void);
 /*--------------------------------------------------------------*/
 
 #endif /* PID_H_ */
@@ -22,26 +22,49 @@
 #include "uart.h"
 /*--------------------------------------------------------------*/
 
-//Recieves PWM vaues from queue and updates the main and tail rotor PWM
+/* Globals -----------------------------------------------------*/
+static volatile uint32_t pwmMainDuty = 0;           // Last requested main duty
+static volatile uint32_t pwmMainLimit = MAIN_MAX_DUTY;
+/*--------------------------------------------------------------*/
+
+//Recieves PWM vaues from queue and updates the main and tail rotor PWM.
+//Blocks on the queue so new duty cycles are applied as soon as they
+//are sent.
 void pwmTask(void *pvParameters) {
     while(1) {
         pwmUpdateMessage_t recievedMessage;
-        while(uxQueueMessagesWaiting(xPWMQueue) > 0) {
-            if(xQueueReceive(xPWMQueue, (void *) &recievedMessage, (TickType_t) 10) != pdPASS) {
-                uartSend("pwmRxFail\r\n");
-            }
+        if(xQueueReceive(xPWMQueue, (void *) &recievedMessage, portMAX_DELAY) == pdPASS) {
             pwmUpdateTail(recievedMessage.tail);
             pwmUpdateMain(recievedMessage.main);
         }
-        vTaskDelay(PWM_UPDATE_RATE / portTICK_RATE_MS);
     }
 }
 
-// Update main PWM duty cycle
+// Update main PWM duty cycle, capped by pwmLimitMain
 void pwmUpdateMain (uint32_t duty) {
     // Calculate the PWM period corresponding to the freq.
     uint32_t pwmPeriod = PWMGenPeriodGet(PWM_MAIN_BASE, PWM_MAIN_GEN);
-    PWMPulseWidthSet(PWM_MAIN_BASE, PWM_MAIN_OUTNUM, (pwmPeriod * duty) / 100);
+    uint32_t limit;
+    pwmMainDuty = duty;
+
+    // Write again if the limit changed part way through, so a cap
+    // set from an interrupt is never overwritten
+    do {
+        limit = pwmMainLimit;
+        PWMPulseWidthSet(PWM_MAIN_BASE, PWM_MAIN_OUTNUM,
+                         (pwmPeriod * ((duty > limit) ? limit : duty)) / 100);
+    } while (limit != pwmMainLimit);
+}
+
+// Last requested main duty cycle, before any cap
+uint32_t pwmGetMainDuty (void) {
+    return pwmMainDuty;
+}
+
+// Caps the main duty cycle and applies the cap at once
+void pwmLimitMain (uint32_t maxDuty) {
+    pwmMainLimit = maxDuty;
+    pwmUpdateMain(pwmMainDuty);
 }
 
 // Update tail PWM duty cycle
@@ -62,7 +85,7 @@ void pwmInit (void) {
     SysCtlPeripheralEnable(PWM_TAIL_PERIPH_PWM);
 
     // Set the clock divider for PWM
-    SysCtlPWMClockSet(SYSCTL_PWMDIV_64);
+    SysCtlPWMClockSet(PWM_CLOCK_DIV);
 
     // GPIO configuration
     GPIOPinConfigure(PWM_MAIN_GPIO_CONFIG);
@@ -84,7 +107,7 @@ void pwmInit (void) {
     PWMOutputState(PWM_MAIN_BASE, PWM_MAIN_OUTBIT, true);
 
     // Set PWM frequency
-    uint32_t pwmPeriphFreq = SysCtlClockGet() / 64;
+    uint32_t pwmPeriphFreq = SysCtlClockGet() / PWM_CLOCK_DIVISOR;
     uint32_t pwmPeriod = pwmPeriphFreq / PWM_FREQ;
     PWMGenPeriodSet(PWM_MAIN_BASE, PWM_MAIN_GEN, pwmPeriod);
     PWMGenPeriodSet(PWM_TAIL_BASE, PWM_TAIL_GEN, pwmPeriod);
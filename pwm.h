@@ -21,7 +21,6 @@
 
 /* Definitions -------------------------------------------------*/
 #define PWM_FREQ           100
-#define PWM_UPDATE_RATE    40 // ms between duty cycle update
 // Duty cycle limits
 #define MAIN_MAX_DUTY       98          // Maximum duty cycle
 #define MAIN_MIN_DUTY       2           // Minimum duty cycle
@@ -52,9 +51,16 @@ void pwmTask(void *pvParameters);
 // Setup of PWM generators
 void pwmInit (void);
 
-// Update main PWM duty cycle
+// Update main PWM duty cycle, capped by pwmLimitMain
 void pwmUpdateMain (uint32_t duty);
 
+// Last requested main duty cycle, before any cap
+uint32_t pwmGetMainDuty (void);
+
+// Caps the main duty cycle and applies the cap at once. Safe to call
+// from an interrupt.
+void pwmLimitMain (uint32_t maxDuty);
+
 // Update tail PWM duty cycle
 void pwmUpdateTail (uint32_t duty);
 /*--------------------------------------------------------------*/
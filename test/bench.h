@@ -0,0 +1,84 @@
+/*---------------------------------------------------------------
+               ________________
+                 _____|___
+                / |__|    \-----__|__
+                \_________/------ |
+                ____|___|____
+
+-----------------------------------------------------------------
+ ENCE 464 Group 13
+ bench.h
+
+ Timing for the host benchmarks. Each bench_*.c is one program
+ that prints the cost of a routine against the code it replaced.
+ Figures are host nanoseconds, built without the sanitizers, and
+ only the ratios carry over to the TM4C123.
+----------------------------------------------------------------*/
+#ifndef BENCH_H_
+#define BENCH_H_
+
+/* Includes ----------------------------------------------------*/
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include "tiva.h"
+#include "rtos.h"
+#include "stubs.h"
+/*--------------------------------------------------------------*/
+
+/* Definitions -------------------------------------------------*/
+#define BENCH_ROUNDS    7       // The best round is kept
+#define BENCH_PASSES    200000  // Passes per round
+#define BENCH_INPUT_LENGTH 1024 // Input readings, a power of 2
+#define BENCH_INPUT(pass) benchInput[(pass) & (BENCH_INPUT_LENGTH - 1)]
+/*--------------------------------------------------------------*/
+
+/* Timing ------------------------------------------------------*/
+// Results are written here so the compiler keeps the work
+static volatile int32_t benchSink;
+
+static uint64_t benchNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+// Nanoseconds per pass of body, best of BENCH_ROUNDS rounds of
+// passes. setup runs before each round and is not timed.
+#define BENCH_NS(passes, setup, body) ({ \
+    double benchBest = 1e30; \
+    int benchRound; \
+    for (benchRound = 0; benchRound < BENCH_ROUNDS; benchRound++) { \
+        uint32_t benchPass; \
+        uint64_t benchStart; \
+        double benchCost; \
+        setup; \
+        benchStart = benchNow(); \
+        for (benchPass = 0; benchPass < (uint32_t) (passes); benchPass++) { \
+            body; \
+        } \
+        benchCost = (double) (benchNow() - benchStart) / (passes); \
+        if (benchCost < benchBest) { \
+            benchBest = benchCost; \
+        } \
+    } \
+    benchBest; \
+})
+/*--------------------------------------------------------------*/
+
+/* Input -------------------------------------------------------*/
+// Repeatable ADC-like readings, filled before timing so the
+// generator is not part of the cost
+static int32_t benchInput[BENCH_INPUT_LENGTH];
+
+static inline void benchFillInput(void) {
+    uint32_t random = 464;
+    uint32_t i;
+    for (i = 0; i < BENCH_INPUT_LENGTH; i++) {
+        random = random * 1103515245 + 12345;
+        benchInput[i] = 2000 + (int32_t) ((random >> 16) & 0x1ff);
+    }
+}
+/*--------------------------------------------------------------*/
+
+#endif /* BENCH_H_ */
@@ -0,0 +1,72 @@
+/*---------------------------------------------------------------
+               ________________
+                 _____|___
+                / |__|    \-----__|__
+                \_________/------ |
+                ____|___|____
+
+-----------------------------------------------------------------
+ ENCE 464 Group 13
+ bench_circBuf.c
+
+ Cost of a window average per update: the running sum against
+ the old calcAvgAltADC sum over the buffer, for window lengths
+ up to FILTER_BOXCAR_MAX
+----------------------------------------------------------------*/
+
+/* Includes ----------------------------------------------------*/
+#include "bench.h"
+#include "../circBufT.c"
+#include "../filter.h"
+/*--------------------------------------------------------------*/
+
+/* Reference ---------------------------------------------------*/
+// The buffer and average this replaced, as they were before the
+// running sum: writes only store, the average reads every entry
+static void benchOldWrite(circBuf_t* buffer, uint32_t entry) {
+    buffer->data[buffer->windex] = entry;
+    buffer->windex++;
+    if (buffer->windex >= buffer->size)
+       buffer->windex = 0;
+}
+
+static uint32_t benchOldRead(circBuf_t* buffer) {
+    uint32_t entry = buffer->data[buffer->rindex];
+    buffer->rindex++;
+    if (buffer->rindex >= buffer->size)
+       buffer->rindex = 0;
+    return entry;
+}
+
+static uint32_t benchOldAverage(circBuf_t* altBuf) {
+    uint32_t sum = 0;
+    uint32_t i;
+    for (i = 0; i < altBuf->size; i++) {
+        sum += benchOldRead(altBuf);
+    }
+    return (2 * sum + altBuf->size) / 2 / altBuf->size;
+}
+/*--------------------------------------------------------------*/
+
+int main(void) {
+    static const uint32_t lengths[] = {8, 16, 32, 64, 128, FILTER_BOXCAR_MAX};
+    static uint32_t data[FILTER_BOXCAR_MAX];
+    circBuf_t buffer;
+    uint32_t i;
+
+    benchFillInput();
+    printf("circBuf: ns per update (one write and one average)\n");
+    printf("%8s %10s %10s %8s\n", "length", "old", "running", "ratio");
+    for (i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+        double oldCost = BENCH_NS(BENCH_PASSES, initCircBuf(&buffer, data, lengths[i]), {
+            benchOldWrite(&buffer, BENCH_INPUT(benchPass));
+            benchSink = benchOldAverage(&buffer);
+        });
+        double newCost = BENCH_NS(BENCH_PASSES, initCircBuf(&buffer, data, lengths[i]), {
+            writeCircBuf(&buffer, BENCH_INPUT(benchPass));
+            benchSink = meanCircBuf(&buffer);
+        });
+        printf("%8u %10.1f %10.1f %7.1fx\n", (unsigned) lengths[i], oldCost, newCost, oldCost / newCost);
+    }
+    return 0;
+}
@@ -0,0 +1,34 @@
+/*---------------------------------------------------------------
+               ________________
+                 _____|___
+                / |__|    \-----__|__
+                \_________/------ |
+                ____|___|____
+
+-----------------------------------------------------------------
+ ENCE 464 Group 13
+ bench_estimator.c
+
+ Cost of one alpha-beta estimator update with the altitude gains.
+ bench_estimatorFloat.c builds the same with ESTIMATOR_USE_FLOAT.
+----------------------------------------------------------------*/
+
+/* Includes ----------------------------------------------------*/
+#include "bench.h"
+#include "../estimator.c"
+#include "../altitude.h"
+/*--------------------------------------------------------------*/
+
+int main(void) {
+    estimatorHandle_t estimate;
+    benchFillInput();
+    // Altitudes as the altitude task gives them, 0 to 64 percent with
+    // ESTIMATOR_FRAC_BITS fraction bits
+    double cost = BENCH_NS(BENCH_PASSES,
+            estimatorInit(&estimate, ALT_EST_ALPHA, ALT_EST_BETA, 32 << ESTIMATOR_FRAC_BITS), {
+        estimatorUpdate(&estimate, (BENCH_INPUT(benchPass) - 2000) << (ESTIMATOR_FRAC_BITS - 3));
+        benchSink = estimate.position;
+    });
+    printf("estimator (%s): %.1fns per update\n", ESTIMATOR_USE_FLOAT ? "float" : "fixed", cost);
+    return 0;
+}
@@ -0,0 +1,19 @@
+/*---------------------------------------------------------------
+               ________________
+                 _____|___
+                / |__|    \-----__|__
+                \_________/------ |
+                ____|___|____
+
+-----------------------------------------------------------------
+ ENCE 464 Group 13
+ bench_estimatorFloat.c
+
+ Estimator update cost with the state in single precision
+----------------------------------------------------------------*/
+
+/* Includes ----------------------------------------------------*/
+// Keep the state in floats behind the fixed point interface
+#define ESTIMATOR_USE_FLOAT 1
+#include "bench_estimator.c"
+/*--------------------------------------------------------------*/
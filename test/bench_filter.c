@@ -0,0 +1,156 @@
+/*---------------------------------------------------------------
+               ________________
+                 _____|___
+                / |__|    \-----__|__
+                \_________/------ |
+                ____|___|____
+
+-----------------------------------------------------------------
+ ENCE 464 Group 13
+ bench_filter.c
+
+ Cost per sample and measured group delay of each filter stage,
+ alone and as the altitude chain, then the notch response around
+ the rotor frequencies it tracks
+----------------------------------------------------------------*/
+
+/* Includes ----------------------------------------------------*/
+#include <math.h>
+#include "bench.h"
+#include "../filter.c"
+#include "../altitude.h"
+/*--------------------------------------------------------------*/
+
+/* Definitions -------------------------------------------------*/
+#define BENCH_RATE_HZ       ALT_ADC_STREAM_RATE_HZ
+#define BENCH_NOTCH_HZ      20      // A rotor frequency the notch might track
+#define BENCH_STEP          4096
+#define BENCH_SETTLE        4000    // Samples to follow the step for
+/*--------------------------------------------------------------*/
+
+/* Stages ------------------------------------------------------*/
+typedef struct benchStage_t {
+    const char* name;
+    filterConfig_t config[2];
+    uint32_t numStages;
+} benchStage_t;
+
+static const benchStage_t benchStages[] = {
+        {"boxcar 10",   {{FILTER_BOXCAR, ALT_ADC_BUF_LENGTH}}, 1},
+        {"boxcar 256",  {{FILTER_BOXCAR, FILTER_BOXCAR_MAX}}, 1},
+        {"ema 1/8",     {{FILTER_EMA, 3}}, 1},
+        {"median 5",    {{FILTER_MEDIAN, 5}}, 1},
+        {"median 9",    {{FILTER_MEDIAN, FILTER_MEDIAN_MAX}}, 1},
+        // Butterworth low pass, 20Hz at 500Hz
+        {"biquad",      {{FILTER_BIQUAD, 0, {219, 437, 219, -26992, 11483}}}, 1},
+        {"decimate 4",  {{FILTER_DECIMATE, 4}}, 1},
+        {"notch",       {{FILTER_NOTCH, ALT_NOTCH_RADIUS}}, 1},
+        {"altitude",    {{FILTER_NOTCH, ALT_NOTCH_RADIUS}, {FILTER_BOXCAR, ALT_ADC_BUF_LENGTH}}, 2},
+};
+#define BENCH_NUM_STAGES    (sizeof(benchStages) / sizeof(benchStages[0]))
+
+static void benchStageInit(filterChain_t* chain, const benchStage_t* stage) {
+    filterInit(chain, stage->config, stage->numStages);
+    filterSetNotch(chain, BENCH_NOTCH_HZ << FILTER_FREQ_BITS, BENCH_RATE_HZ);
+}
+/*--------------------------------------------------------------*/
+
+/* Measures ----------------------------------------------------*/
+// Group delay at DC in samples from the step response. For a unity
+// gain linear filter the area between the settled value and the
+// response is the centroid of the impulse response. Measuring from
+// the settled value keeps a rounding offset out of the delay; the
+// offset is given separately. A decimator holds its last output in
+// between, as the consumer sees it.
+static double benchGroupDelay(const benchStage_t* stage, int32_t* offset) {
+    static int32_t response[BENCH_SETTLE];
+    filterChain_t chain;
+    double area = 0;
+    int32_t settled;
+    uint32_t i;
+    benchStageInit(&chain, stage);
+    for (i = 0; i < BENCH_SETTLE; i++) {
+        filterProcess(&chain, BENCH_STEP);
+        response[i] = chain.output;
+    }
+    settled = response[BENCH_SETTLE - 1];
+    for (i = 0; i < BENCH_SETTLE; i++) {
+        area += 1.0 - (double) response[i] / settled;
+    }
+    *offset = settled - BENCH_STEP;
+    return area;
+}
+
+// Gain in dB of the notch at freq (Hz) with its centre at centre
+// (Hz), from the output amplitude once settled
+static double benchNotchGain(double centre, double freq) {
+    static const filterConfig_t config[] = {{FILTER_NOTCH, ALT_NOTCH_RADIUS}};
+    const double amplitude = 400;
+    filterChain_t chain;
+    double in = 0, out = 0;
+    uint32_t i;
+    filterInit(&chain, config, 1);
+    filterSetNotch(&chain, (uint32_t) (centre * (1 << FILTER_FREQ_BITS)), BENCH_RATE_HZ);
+    filterReset(&chain, 2000);
+    for (i = 0; i < 4 * BENCH_RATE_HZ; i++) {
+        double x = amplitude * sin(2 * M_PI * freq * i / BENCH_RATE_HZ);
+        filterProcess(&chain, 2000 + (int32_t) lround(x));
+        if (i >= 2 * BENCH_RATE_HZ) {
+            double y = chain.output - 2000;
+            in += x * x;
+            out += y * y;
+        }
+    }
+    return 10 * log10(out / in);
+}
+/*--------------------------------------------------------------*/
+
+int main(void) {
+    filterChain_t chain;
+    uint32_t i;
+
+    benchFillInput();
+    printf("filter: per sample cost and DC group delay at %dHz\n", BENCH_RATE_HZ);
+    printf("%-12s %8s %10s %8s %8s\n", "stage", "ns", "delay", "ms", "offset");
+    for (i = 0; i < BENCH_NUM_STAGES; i++) {
+        const benchStage_t* stage = &benchStages[i];
+        double cost = BENCH_NS(BENCH_PASSES, benchStageInit(&chain, stage), {
+            filterProcess(&chain, BENCH_INPUT(benchPass));
+            benchSink = chain.output;
+        });
+        int32_t offset;
+        double delay = benchGroupDelay(stage, &offset);
+        printf("%-12s %8.1f %10.2f %8.2f %8d\n", stage->name, cost, delay,
+               delay * 1000 / BENCH_RATE_HZ, (int) offset);
+    }
+
+    // The rotor frequencies at 20%, 50% and 100% duty
+    static const double centres[] = {12, 27, 43};
+    static const double offsets[] = {0, 0.5, 1, 2, 5, 10};
+    static const filterConfig_t notch[] = {{FILTER_NOTCH, ALT_NOTCH_RADIUS}};
+    uint32_t j;
+    printf("\nnotch: gain (dB) at centre + offset (Hz), r = %d (Q14)\n", ALT_NOTCH_RADIUS);
+    printf("%8s", "centre");
+    for (j = 0; j < sizeof(offsets) / sizeof(offsets[0]); j++) {
+        printf(" %+7.1f", offsets[j]);
+    }
+    printf("\n");
+    for (i = 0; i < sizeof(centres) / sizeof(centres[0]); i++) {
+        printf("%8.0f", centres[i]);
+        for (j = 0; j < sizeof(offsets) / sizeof(offsets[0]); j++) {
+            printf(" %7.1f", benchNotchGain(centres[i], centres[i] + offsets[j]));
+        }
+        printf("\n");
+    }
+
+    double bypassCost = BENCH_NS(BENCH_PASSES, filterInit(&chain, notch, 1), {
+        filterProcess(&chain, BENCH_INPUT(benchPass));
+        benchSink = chain.output;
+    });
+    double retuneCost = BENCH_NS(BENCH_PASSES, filterInit(&chain, notch, 1), {
+        filterSetNotch(&chain, (12 + (benchPass & 31)) << FILTER_FREQ_BITS, BENCH_RATE_HZ);
+        benchSink = chain.stages[0].coef[1];
+    });
+    printf("notch: %.1fns per sample bypassed, %.1fns per retune\n", bypassCost, retuneCost);
+    return 0;
+}
@@ -0,0 +1,92 @@
+/*---------------------------------------------------------------
+               ________________
+                 _____|___
+                / |__|    \-----__|__
+                \_________/------ |
+                ____|___|____
+
+-----------------------------------------------------------------
+ ENCE 464 Group 13
+ bench_pid.c
+
+ Cost of one pass of the PID kernel for both axes against the
+ per-axis division of pidCalcDutyCycle. bench_pidFloat.c builds
+ the same with PID_USE_FLOAT.
+----------------------------------------------------------------*/
+
+/* Includes ----------------------------------------------------*/
+#include "bench.h"
+#include "../pid.c"
+/*--------------------------------------------------------------*/
+
+/* Helpers -----------------------------------------------------*/
+// Errors for the period, spread over the range the axes see in
+// flight: up to 50% and 90 degrees off (Q8)
+static void benchSetErrors(pidHandle_t* h, uint32_t pass) {
+    const pidConfig_t* config = h->config;
+    int32_t error = (BENCH_INPUT(pass) - 2256) * 50;
+    h->weightedError = error;
+    h->propError = error >> (PID_DIFF_FRAC_BITS - config->errorBits);
+    h->integralError = (BENCH_INPUT(pass + 1) - 2256) * 8;
+    h->diffError = (BENCH_INPUT(pass + 2) - 2256) * 2;
+}
+
+// pidCalcDutyCycle with its divisor read at run time. x86-64 folds
+// the constant 64 bit division into a multiply, but a 32 bit target
+// has no such shortcut and calls __aeabi_ldivmod, so this is the
+// nearer stand-in for the old path on the M4.
+static volatile int64_t benchMillion = 1000000;
+
+static int16_t benchDivideDutyCycle(pidHandle_t* h) {
+    int64_t termsPI = (int64_t) h->propError * h->kp * 1000
+                    + (int64_t) h->integralError * h->kiPeriod;
+    int32_t dutyCycle =
+            (int32_t) ((termsPI >> h->config->errorBits) / benchMillion) +
+            ((h->diffError * h->kd/1000) >> PID_DIFF_FRAC_BITS) +
+            h->config->offset + h->feedforward;
+    if      (dutyCycle > h->config->maxDuty) {dutyCycle = h->config->maxDuty;}
+    else if (dutyCycle < h->config->minDuty) {dutyCycle = h->config->minDuty;}
+    return dutyCycle;
+}
+/*--------------------------------------------------------------*/
+
+int main(void) {
+    pidHandle_t mainAxis;
+    pidHandle_t tailAxis;
+    int16_t mainDuty;
+    int16_t tailDuty;
+
+    benchFillInput();
+    pidInit(&mainAxis, &pidConfigs[PID_MAIN]);
+    pidInit(&tailAxis, &pidConfigs[PID_TAIL]);
+
+    double oldCost = BENCH_NS(BENCH_PASSES, , {
+        benchSetErrors(&mainAxis, benchPass);
+        benchSetErrors(&tailAxis, benchPass + 3);
+        benchSink = pidCalcDutyCycle(&mainAxis) + pidCalcDutyCycle(&tailAxis);
+    });
+    double divideCost = BENCH_NS(BENCH_PASSES, , {
+        benchSetErrors(&mainAxis, benchPass);
+        benchSetErrors(&tailAxis, benchPass + 3);
+        benchSink = benchDivideDutyCycle(&mainAxis) + benchDivideDutyCycle(&tailAxis);
+    });
+    double newCost = BENCH_NS(BENCH_PASSES, , {
+        benchSetErrors(&mainAxis, benchPass);
+        benchSetErrors(&tailAxis, benchPass + 3);
+        pidCalcDutyCycles(&mainAxis, &tailAxis, &mainDuty, &tailDuty);
+        benchSink = mainDuty + tailDuty;
+    });
+    double setCost = BENCH_NS(BENCH_PASSES, , {
+        benchSetErrors(&mainAxis, benchPass);
+        benchSetErrors(&tailAxis, benchPass + 3);
+        benchSink = mainAxis.propError + tailAxis.propError;
+    });
+    // The cost of setting the errors is taken off both
+    oldCost -= setCost;
+    divideCost -= setCost;
+    newCost -= setCost;
+    printf("pid kernel (%s): %.1fns for both axes\n", PID_USE_FLOAT ? "float" : "fixed", newCost);
+    printf("  pidCalcDutyCycle: %.1fns (%.2fx), with a real divide %.1fns (%.2fx)\n",
+           oldCost, oldCost / newCost, divideCost, divideCost / newCost);
+    return 0;
+}
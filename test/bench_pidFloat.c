@@ -0,0 +1,19 @@
+/*---------------------------------------------------------------
+               ________________
+                 _____|___
+                / |__|    \-----__|__
+                \_________/------ |
+                ____|___|____
+
+-----------------------------------------------------------------
+ ENCE 464 Group 13
+ bench_pidFloat.c
+
+ PID kernel cost in single precision
+----------------------------------------------------------------*/
+
+/* Includes ----------------------------------------------------*/
+// Build the float kernel in place of the fixed point one
+#define PID_USE_FLOAT 1
+#include "bench_pid.c"
+/*--------------------------------------------------------------*/
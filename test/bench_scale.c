@@ -0,0 +1,57 @@
+/*---------------------------------------------------------------
+               ________________
+                 _____|___
+                / |__|    \-----__|__
+                \_________/------ |
+                ____|___|____
+
+-----------------------------------------------------------------
+ ENCE 464 Group 13
+ bench_scale.c
+
+ Cost of mapping one ADC reading to altitude against the old
+ per-sample division. bench_scaleLut.c builds the same with
+ ALT_SCALE_USE_LUT.
+----------------------------------------------------------------*/
+
+/* Includes ----------------------------------------------------*/
+#include "bench.h"
+#include "../altitude.c"
+/*--------------------------------------------------------------*/
+
+/* Reference ---------------------------------------------------*/
+// The ground and full height readings were set at run time and read
+// from memory, so the old mapping divided by a value the compiler
+// could not fold. Volatile keeps it from folding them here.
+static volatile int32_t benchAt0 = 2500;
+static volatile int32_t benchAt100 = 2500 - ALT_ADC_SWING;
+
+// The mapping this replaced, clamp included
+static int32_t benchOldScale(int32_t adc) {
+    int32_t altitude = 100 * (benchAt0 - adc) / (benchAt0 - benchAt100);
+    if (altitude > 250 || altitude < 5) {
+        altitude = 0;
+    }
+    return altitude;
+}
+/*--------------------------------------------------------------*/
+
+int main(void) {
+    benchFillInput();
+    // Readings from ground to a little over full height
+    uint32_t i;
+    for (i = 0; i < BENCH_INPUT_LENGTH; i++) {
+        benchInput[i] = benchAt0 - (benchInput[i] - 2000) * (ALT_ADC_SWING + 40) / 512;
+    }
+    altitudeInitScale(benchAt0);
+
+    double oldCost = BENCH_NS(BENCH_PASSES, , {
+        benchSink = benchOldScale(BENCH_INPUT(benchPass));
+    });
+    double newCost = BENCH_NS(BENCH_PASSES, , {
+        benchSink = altitudeScale(BENCH_INPUT(benchPass));
+    });
+    printf("scale (%s): %.1fns per reading, old division %.1fns, %.2fx\n",
+           ALT_SCALE_USE_LUT ? "table" : "reciprocal", newCost, oldCost, oldCost / newCost);
+    return 0;
+}
@@ -0,0 +1,24 @@
+/*---------------------------------------------------------------
+               ________________
+                 _____|___
+                / |__|    \-----__|__
+                \_________/------ |
+                ____|___|____
+
+-----------------------------------------------------------------
+ ENCE 464 Group 13
+ bench_scaleLut.c
+
+ Altitude mapping cost through the calibration table
+----------------------------------------------------------------*/
+
+/* Includes ----------------------------------------------------*/
+#include "bench.h"
+#include "FreeRTOS.h"
+#include "queue.h"
+#include "../altitude.h"
+// Map through altScaleTable, the default table is the linear mapping
+#undef ALT_SCALE_USE_LUT
+#define ALT_SCALE_USE_LUT 1
+#include "bench_scale.c"
+/*--------------------------------------------------------------*/
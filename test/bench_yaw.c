@@ -0,0 +1,88 @@
+/*---------------------------------------------------------------
+               ________________
+                 _____|___
+                / |__|    \-----__|__
+                \_________/------ |
+                ____|___|____
+
+-----------------------------------------------------------------
+ ENCE 464 Group 13
+ bench_yaw.c
+
+ Cost per encoder edge of yawIntHandler against the old path: two
+ GPIOPinRead and a queue send in the handler, then a queue receive
+ and decode in the yaw task
+----------------------------------------------------------------*/
+
+/* Includes ----------------------------------------------------*/
+#include "bench.h"
+#include "FreeRTOS.h"
+#include "queue.h"
+#include "semphr.h"
+#include "../yaw.h"
+#include "../yaw.c"
+/*--------------------------------------------------------------*/
+
+/* Reference ---------------------------------------------------*/
+#define BENCH_GPIO_B    1
+
+// Quadrature state (lookup table order) as the A and B pin levels
+static const uint8_t benchPinStates[4] = {
+        0, YAW_QUAD_PIN_B, YAW_QUAD_PIN_A | YAW_QUAD_PIN_B, YAW_QUAD_PIN_A};
+
+static QueueHandle_t benchEncoderQueue;
+static encoderHandle_t benchOldState;
+static int32_t benchOldPosition;
+
+// The handler this replaced
+static void benchOldIntHandler(void) {
+    GPIOIntClear(YAW_QUAD_BASE, YAW_QUAD_PIN_A | YAW_QUAD_PIN_B);
+    uint8_t a = GPIOPinRead(YAW_QUAD_BASE, YAW_QUAD_PIN_A);
+    uint8_t b = GPIOPinRead(YAW_QUAD_BASE, YAW_QUAD_PIN_B);
+    uint8_t input = a | b;
+    xQueueSendFromISR(benchEncoderQueue, &input, pdFALSE);
+}
+
+// Its share of the old yaw task: one receive and decode per edge,
+// then the angle with a division
+static int32_t benchOldConsume(void) {
+    xQueueReceive(benchEncoderQueue, (void *) &benchOldState.pins, 0);
+    benchOldPosition += yawChange(&benchOldState);
+    int32_t angle = (benchOldPosition * YAW_SCALE_NUM / YAW_SCALE_DEN) % 360;
+    if (abs(angle) > 180) {
+        angle += (angle > 0) ? -360 : 360;
+    }
+    return angle;
+}
+/*--------------------------------------------------------------*/
+
+int main(void) {
+    hostReset();
+    hostRtosReset();
+    hostStubsReset();
+    yawInit();
+    benchEncoderQueue = xQueueCreate(16, sizeof(uint8_t));
+
+    // One quadrature step forward per pass
+    double setCost = BENCH_NS(BENCH_PASSES, , {
+        hostGpio[BENCH_GPIO_B].pins = benchPinStates[benchPass & 3];
+        benchSink = hostGpio[BENCH_GPIO_B].pins;
+    });
+    double oldCost = BENCH_NS(BENCH_PASSES, , {
+        hostGpio[BENCH_GPIO_B].pins = benchPinStates[benchPass & 3];
+        benchOldIntHandler();
+        benchSink = benchOldConsume();
+    });
+    double newCost = BENCH_NS(BENCH_PASSES, , {
+        hostGpio[BENCH_GPIO_B].pins = benchPinStates[benchPass & 3];
+        yawIntHandler();
+        benchSink = yawCount;
+    });
+    oldCost -= setCost;
+    newCost -= setCost;
+    printf("yaw edge: %.1fns in yawIntHandler, old handler and queue %.1fns, %.2fx\n",
+           newCost, oldCost, oldCost / newCost);
+    printf("  %u edges, %u illegal, %u repeats\n", (unsigned) yawEdgeSeq,
+           (unsigned) yawIntegrity.illegal, (unsigned) yawIntegrity.repeats);
+    return 0;
+}
@@ -0,0 +1,170 @@
+/*---------------------------------------------------------------
+               ________________
+                 _____|___
+                / |__|    \-----__|__
+                \_________/------ |
+                ____|___|____
+
+-----------------------------------------------------------------
+ ENCE 464 Group 13
+ rtos.c
+
+ Host stand-in for the FreeRTOS calls the modules make. Queues
+ are plain ring buffers and time only moves in task delays.
+----------------------------------------------------------------*/
+
+/* Includes ----------------------------------------------------*/
+#include <stdlib.h>
+#include <string.h>
+#include "rtos.h"
+/*--------------------------------------------------------------*/
+
+/* Globals -----------------------------------------------------*/
+struct hostQueue_t {
+    UBaseType_t length;
+    UBaseType_t itemSize;
+    UBaseType_t count;
+    UBaseType_t head;       // Oldest item
+    uint8_t* items;
+};
+
+hostDelayHook_t hostDelayHook;
+
+static TickType_t hostTicks;
+static jmp_buf hostTaskReturn;
+/*--------------------------------------------------------------*/
+
+/* Host control ------------------------------------------------*/
+// Runs a task function until its delay hook calls hostTaskExit
+void hostTaskRun(void (*task)(void*), void* parameters) {
+    if (setjmp(hostTaskReturn) == 0) {
+        task(parameters);
+    }
+}
+
+// Ends the task run by hostTaskRun
+void hostTaskExit(void) {
+    longjmp(hostTaskReturn, 1);
+}
+
+// Back to tick 0 with no hook
+void hostRtosReset(void) {
+    hostTicks = 0;
+    hostDelayHook = NULL;
+}
+/*--------------------------------------------------------------*/
+
+/* Queues ------------------------------------------------------*/
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+    QueueHandle_t queue = calloc(1, sizeof(*queue));
+    queue->length = length;
+    queue->itemSize = itemSize;
+    queue->items = calloc(length, itemSize ? itemSize : 1);
+    return queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t wait) {
+    (void) wait;
+    if (queue->count == queue->length) {
+        return errQUEUE_FULL;
+    }
+    UBaseType_t tail = (queue->head + queue->count) % queue->length;
+    if (item != NULL && queue->itemSize > 0) {
+        memcpy(&queue->items[tail * queue->itemSize], item, queue->itemSize);
+    }
+    queue->count++;
+    return pdPASS;
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void* item, BaseType_t* woken) {
+    if (woken != NULL) {
+        *woken = pdTRUE;
+    }
+    return xQueueSend(queue, item, 0);
+}
+
+// Only for queues of length one, as on the target
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void* item) {
+    if (queue->length != 1) {
+        abort();
+    }
+    queue->count = 0;
+    return xQueueSend(queue, item, 0);
+}
+
+// Blocking on an empty queue lets time pass a tick at a time, so the
+// delay hook can raise the interrupts that fill it
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t wait) {
+    while (queue->count == 0) {
+        if (wait == 0 || hostDelayHook == NULL) {
+            return pdFAIL;
+        }
+        if (wait != portMAX_DELAY) {
+            wait--;
+        }
+        vTaskDelay(1);
+    }
+    if (item != NULL && queue->itemSize > 0) {
+        memcpy(item, &queue->items[queue->head * queue->itemSize], queue->itemSize);
+    }
+    queue->head = (queue->head + 1) % queue->length;
+    queue->count--;
+    return pdPASS;
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue) {
+    queue->count = 0;
+    queue->head = 0;
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    return queue->count;
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+    free(queue->items);
+    free(queue);
+}
+/*--------------------------------------------------------------*/
+
+/* Semaphores --------------------------------------------------*/
+SemaphoreHandle_t xSemaphoreCreateBinary(void) {
+    return xQueueCreate(1, 0);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t wait) {
+    return xQueueReceive(semaphore, NULL, wait);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+    return xQueueSend(semaphore, NULL, 0);
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t semaphore, BaseType_t* woken) {
+    return xQueueSendFromISR(semaphore, NULL, woken);
+}
+/*--------------------------------------------------------------*/
+
+/* Tasks -------------------------------------------------------*/
+TickType_t xTaskGetTickCount(void) {
+    return hostTicks;
+}
+
+void vTaskDelay(TickType_t ticks) {
+    hostTicks += ticks;
+    if (hostDelayHook != NULL) {
+        hostDelayHook(hostTicks);
+    }
+}
+
+void vTaskDelayUntil(TickType_t* previousWake, TickType_t increment) {
+    *previousWake += increment;
+    if ((int32_t) (*previousWake - hostTicks) > 0) {
+        hostTicks = *previousWake;
+    }
+    if (hostDelayHook != NULL) {
+        hostDelayHook(hostTicks);
+    }
+}
+/*--------------------------------------------------------------*/
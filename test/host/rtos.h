@@ -0,0 +1,83 @@
+/*---------------------------------------------------------------
+               ________________
+                 _____|___
+                / |__|    \-----__|__
+                \_________/------ |
+                ____|___|____
+
+-----------------------------------------------------------------
+ ENCE 464 Group 13
+ rtos.h
+
+ Host stand-in for the FreeRTOS calls the modules make. There
+ is one thread. A task delay moves the tick count on and calls
+ the test's delay hook, which runs the plant models and
+ interrupts and can end a task loop with hostTaskExit. A
+ receive from an empty queue waits out its timeout a tick at a
+ time the same way, and fails at once if there is no hook.
+----------------------------------------------------------------*/
+#ifndef HOST_RTOS_H_
+#define HOST_RTOS_H_
+
+/* Includes ----------------------------------------------------*/
+#include <stdint.h>
+#include <stdbool.h>
+#include <setjmp.h>
+#include "FreeRTOSConfig.h"
+/*--------------------------------------------------------------*/
+
+/* Definitions -------------------------------------------------*/
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+typedef uint32_t TickType_t;
+typedef struct hostQueue_t* QueueHandle_t;
+typedef struct hostQueue_t* SemaphoreHandle_t;
+typedef void* TaskHandle_t;
+
+#define pdFALSE                 ((BaseType_t) 0)
+#define pdTRUE                  ((BaseType_t) 1)
+#define pdPASS                  pdTRUE
+#define pdFAIL                  pdFALSE
+#define errQUEUE_FULL           pdFALSE
+#define portMAX_DELAY           ((TickType_t) 0xffffffffUL)
+#define portTICK_RATE_MS        ((TickType_t) 1000 / configTICK_RATE_HZ)
+#define portTICK_PERIOD_MS      portTICK_RATE_MS
+#define portYIELD_FROM_ISR(x)   ((void) (x))
+#define taskENTER_CRITICAL()
+#define taskEXIT_CRITICAL()
+/*--------------------------------------------------------------*/
+
+/* Host control ------------------------------------------------*/
+// Called after every task delay with the new tick count
+typedef void (*hostDelayHook_t)(TickType_t now);
+extern hostDelayHook_t hostDelayHook;
+
+// Runs a task function until its delay hook calls hostTaskExit
+void hostTaskRun(void (*task)(void*), void* parameters);
+// Ends the task run by hostTaskRun, from inside its delay hook
+void hostTaskExit(void);
+// Back to tick 0 with no hook
+void hostRtosReset(void);
+/*--------------------------------------------------------------*/
+
+/* FreeRTOS ----------------------------------------------------*/
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize);
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t wait);
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void* item, BaseType_t* woken);
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void* item);
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t wait);
+BaseType_t xQueueReset(QueueHandle_t queue);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+void vQueueDelete(QueueHandle_t queue);
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t wait);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore);
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t semaphore, BaseType_t* woken);
+
+TickType_t xTaskGetTickCount(void);
+void vTaskDelay(TickType_t ticks);
+void vTaskDelayUntil(TickType_t* previousWake, TickType_t increment);
+/*--------------------------------------------------------------*/
+
+#endif /* HOST_RTOS_H_ */
@@ -0,0 +1,110 @@
+/*---------------------------------------------------------------
+               ________________
+                 _____|___
+                / |__|    \-----__|__
+                \_________/------ |
+                ____|___|____
+
+-----------------------------------------------------------------
+ ENCE 464 Group 13
+ stubs.c
+
+ Host stand-ins for main.c, pwm.c and uart.c
+----------------------------------------------------------------*/
+
+/* Includes ----------------------------------------------------*/
+#include <string.h>
+#include "main.h"
+#include "altitude.h"
+#include "userInput.h"
+#include "control.h"
+#include "pid.h"
+#include "pwm.h"
+#include "yaw.h"
+#include "uart.h"
+#include "stubs.h"
+/*--------------------------------------------------------------*/
+
+/* Globals -----------------------------------------------------*/
+QueueHandle_t xUserInputEventQueue = NULL;
+QueueHandle_t xControlTargetQueue = NULL;
+QueueHandle_t xAltitudeADCQueue = NULL;
+QueueHandle_t xMeasuredAltitudeQueue = NULL;
+QueueHandle_t xMeasuredYawQueue = NULL;
+QueueHandle_t xPWMQueue = NULL;
+QueueHandle_t xTelemetryQueue = NULL;
+SemaphoreHandle_t ctrlYawRefSmph = NULL;
+
+uint32_t hostMainDuty;
+uint32_t hostMainLimit;
+char hostUartLog[HOST_UART_LOG_SIZE];
+void (*hostPwmLimitHook)(uint32_t maxDuty);
+static uint32_t hostUartLength;
+/*--------------------------------------------------------------*/
+
+/* Host control ------------------------------------------------*/
+static void hostQueueRenew(QueueHandle_t* queue, UBaseType_t length, UBaseType_t itemSize) {
+    if (*queue != NULL) {
+        vQueueDelete(*queue);
+    }
+    *queue = xQueueCreate(length, itemSize);
+}
+
+// Creates the queues as main.c does and clears the stub state
+void hostStubsReset(void) {
+    hostQueueRenew(&xUserInputEventQueue, 3, sizeof(userInputEventMessage_t));
+    hostQueueRenew(&xControlTargetQueue, 3, sizeof(controlTargetMessage_t));
+    hostQueueRenew(&xMeasuredAltitudeQueue, 1, sizeof(altitudeMessage_t));
+#if ALT_ADC_USE_UDMA
+    hostQueueRenew(&xAltitudeADCQueue, 2 * ALT_ADC_COUNT, sizeof(altitudeADCBlock_t));
+#else
+    hostQueueRenew(&xAltitudeADCQueue, ALT_ADC_QUEUE_LENGTH, sizeof(uint32_t));
+#endif
+    hostQueueRenew(&xMeasuredYawQueue, 5, sizeof(yawMessage_t));
+    hostQueueRenew(&xPWMQueue, 10, sizeof(pwmUpdateMessage_t));
+    hostQueueRenew(&xTelemetryQueue, 20, sizeof(telemetryMessage_t));
+    if (ctrlYawRefSmph != NULL) {
+        vQueueDelete(ctrlYawRefSmph);
+    }
+    ctrlYawRefSmph = xSemaphoreCreateBinary();
+
+    hostMainDuty = 0;
+    hostMainLimit = MAIN_MAX_DUTY;
+    hostPwmLimitHook = NULL;
+    hostUartLength = 0;
+    hostUartLog[0] = '\0';
+}
+
+// True if a line containing text was sent to the UART
+bool hostUartSent(const char* text) {
+    return strstr(hostUartLog, text) != NULL;
+}
+
+// Forgets what was sent, so a long run can look at its last lines
+void hostUartClear(void) {
+    hostUartLength = 0;
+    hostUartLog[0] = '\0';
+}
+/*--------------------------------------------------------------*/
+
+/* PWM and UART ------------------------------------------------*/
+uint32_t pwmGetMainDuty (void) {
+    return hostMainDuty;
+}
+
+void pwmLimitMain (uint32_t maxDuty) {
+    if (hostPwmLimitHook != NULL) {
+        hostPwmLimitHook(maxDuty);
+    }
+    hostMainLimit = maxDuty;
+}
+
+// Keeps the log, dropping text once it is full
+void uartSend(char* payload) {
+    size_t length = strlen(payload);
+    if (hostUartLength + length < HOST_UART_LOG_SIZE) {
+        memcpy(&hostUartLog[hostUartLength], payload, length + 1);
+        hostUartLength += length;
+    }
+}
+/*--------------------------------------------------------------*/
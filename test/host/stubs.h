@@ -0,0 +1,41 @@
+/*---------------------------------------------------------------
+               ________________
+                 _____|___
+                / |__|    \-----__|__
+                \_________/------ |
+                ____|___|____
+
+-----------------------------------------------------------------
+ ENCE 464 Group 13
+ stubs.h
+
+ Host stand-ins for main.c, pwm.c and uart.c: the queue handles
+ and the PWM and UART calls the modules under test make.
+----------------------------------------------------------------*/
+#ifndef HOST_STUBS_H_
+#define HOST_STUBS_H_
+
+/* Includes ----------------------------------------------------*/
+#include <stdint.h>
+#include <stdbool.h>
+/*--------------------------------------------------------------*/
+
+/* Host control ------------------------------------------------*/
+#define HOST_UART_LOG_SIZE  65536
+
+extern uint32_t hostMainDuty;           // Returned by pwmGetMainDuty
+extern uint32_t hostMainLimit;          // Last pwmLimitMain cap
+extern char hostUartLog[HOST_UART_LOG_SIZE];
+// Called by pwmLimitMain before the new cap is taken, so a test can
+// land an interrupt part way through lifting or setting the cap
+extern void (*hostPwmLimitHook)(uint32_t maxDuty);
+
+// Creates the queues as main.c does and clears the stub state
+void hostStubsReset(void);
+// True if a line containing text was sent to the UART
+bool hostUartSent(const char* text);
+// Forgets what was sent, so a long run can look at its last lines
+void hostUartClear(void);
+/*--------------------------------------------------------------*/
+
+#endif /* HOST_STUBS_H_ */
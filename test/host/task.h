@@ -0,0 +1,2 @@
+// Host build: see rtos.h
+#include "rtos.h"
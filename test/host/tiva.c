@@ -0,0 +1,560 @@
+/*---------------------------------------------------------------
+               ________________
+                 _____|___
+                / |__|    \-----__|__
+                \_________/------ |
+                ____|___|____
+
+-----------------------------------------------------------------
+ ENCE 464 Group 13
+ tiva.c
+
+ Host stand-in for the TivaWare driverlib. The drivers write
+ their configuration into the peripheral structs, and the
+ host* functions act as the converters, uDMA controller and
+ encoder decoder would.
+----------------------------------------------------------------*/
+
+/* Includes ----------------------------------------------------*/
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include "tiva.h"
+/*--------------------------------------------------------------*/
+
+/* Globals -----------------------------------------------------*/
+#define HOST_REGISTERS  64
+
+hostAdc_t hostAdc[2];
+hostTimer_t hostTimer[2];
+hostDmaChannel_t hostDma[HOST_DMA_CHANNELS];
+void* hostDmaControlBase;
+hostQei_t hostQei;
+hostGpio_t hostGpio[6];
+hostPwmGen_t hostPwmGen;
+uint32_t hostPwmClock;
+hostHandler_t hostIntHandler[HOST_NUM_INTS];
+bool hostIntEnabled[HOST_NUM_INTS];
+bool hostIntPending[HOST_NUM_INTS];
+uint8_t hostIntPriority[HOST_NUM_INTS];
+uint32_t hostPinConfig[8];
+uint32_t hostPinConfigs;
+
+// Registers written through HWREG, by address
+static uint32_t hostRegAddress[HOST_REGISTERS];
+static volatile uint32_t hostRegValue[HOST_REGISTERS];
+static uint32_t hostRegs;
+
+static const uint32_t hostGpioBases[6] = {
+        GPIO_PORTA_BASE, GPIO_PORTB_BASE, GPIO_PORTC_BASE,
+        GPIO_PORTD_BASE, GPIO_PORTE_BASE, GPIO_PORTF_BASE};
+/*--------------------------------------------------------------*/
+
+/* Lookup ------------------------------------------------------*/
+static void hostFail(const char* what, uint32_t value) {
+    fprintf(stderr, "host: %s 0x%08x\n", what, value);
+    abort();
+}
+
+static hostAdc_t* hostAdcOf(uint32_t base) {
+    if (base == ADC0_BASE) {return &hostAdc[0];}
+    if (base == ADC1_BASE) {return &hostAdc[1];}
+    hostFail("no ADC at", base);
+    return NULL;
+}
+
+// NVIC interrupt number of an ADC sequence
+static uint32_t hostAdcInt(uint32_t base, uint32_t seq) {
+    return ((base == ADC0_BASE) ? INT_ADC0SS0 : INT_ADC1SS0) + seq;
+}
+
+// Runs an interrupt's handler now, or once it is enabled again
+static void hostIntRaise(uint32_t interrupt) {
+    if (!hostIntEnabled[interrupt]) {
+        hostIntPending[interrupt] = true;
+    } else if (hostIntHandler[interrupt] != NULL) {
+        hostIntHandler[interrupt]();
+    }
+}
+
+static hostTimer_t* hostTimerOf(uint32_t base) {
+    if (base == TIMER0_BASE) {return &hostTimer[0];}
+    if (base == TIMER1_BASE) {return &hostTimer[1];}
+    hostFail("no timer at", base);
+    return NULL;
+}
+
+static hostGpio_t* hostGpioOf(uint32_t base) {
+    uint32_t i;
+    for (i = 0; i < 6; i++) {
+        if (hostGpioBases[i] == base) {
+            return &hostGpio[i];
+        }
+    }
+    hostFail("no GPIO port at", base);
+    return NULL;
+}
+
+static hostDmaControl_t* hostDmaControlOf(uint32_t channel) {
+    hostDmaChannel_t* ch = &hostDma[channel & 0x1f];
+    return (channel & UDMA_ALT_SELECT) ? &ch->alt : &ch->pri;
+}
+
+static void hostCheckQei(uint32_t base) {
+    if (base != QEI0_BASE) {
+        hostFail("no QEI at", base);
+    }
+}
+/*--------------------------------------------------------------*/
+
+/* Host control ------------------------------------------------*/
+// Word at a register address
+volatile uint32_t* hostRegister(uint32_t address) {
+    uint32_t i;
+    for (i = 0; i < hostRegs; i++) {
+        if (hostRegAddress[i] == address) {
+            return &hostRegValue[i];
+        }
+    }
+    if (hostRegs == HOST_REGISTERS) {
+        hostFail("out of registers at", address);
+    }
+    hostRegAddress[hostRegs] = address;
+    hostRegValue[hostRegs] = 0;
+    return &hostRegValue[hostRegs++];
+}
+
+// Back to power on
+void hostReset(void) {
+    uint32_t i;
+    memset(hostAdc, 0, sizeof(hostAdc));
+    memset(hostTimer, 0, sizeof(hostTimer));
+    memset(hostDma, 0, sizeof(hostDma));
+    hostDmaControlBase = NULL;
+    memset(&hostQei, 0, sizeof(hostQei));
+    memset(hostGpio, 0, sizeof(hostGpio));
+    for (i = 0; i < 6; i++) {
+        hostGpio[i].base = hostGpioBases[i];
+    }
+    memset(&hostPwmGen, 0, sizeof(hostPwmGen));
+    hostPwmClock = 0;
+    memset(hostIntHandler, 0, sizeof(hostIntHandler));
+    memset(hostIntEnabled, 0, sizeof(hostIntEnabled));
+    memset(hostIntPending, 0, sizeof(hostIntPending));
+    memset(hostIntPriority, 0, sizeof(hostIntPriority));
+    hostPinConfigs = 0;
+    hostRegs = 0;
+    // ADC0 sequence 3 is the default peripheral on channel 17
+    hostDma[UDMA_CHANNEL_ADC3].adcBase = ADC0_BASE;
+}
+
+// Moves one item into the active control structure of a channel.
+// A full structure stops and the other takes over, as in ping-pong
+// mode, and the ADC sequence interrupt is raised.
+static void hostDmaRequest(hostDmaChannel_t* ch, uint32_t value, uint32_t base) {
+    hostDmaControl_t* active = ch->useAlt ? &ch->alt : &ch->pri;
+    if (!ch->enabled || active->mode != UDMA_MODE_PINGPONG) {
+        // Nothing armed, the request is lost
+        return;
+    }
+    active->dst[active->count++] = value;
+    if (active->count == active->size) {
+        active->mode = UDMA_MODE_STOP;
+        ch->useAlt = !ch->useAlt;
+        if (hostAdcOf(base)->seq[3].intEnabled) {
+            hostIntRaise(hostAdcInt(base, 3));
+        }
+    }
+}
+
+// One sequence 3 conversion
+void hostAdcConvert(uint32_t base, uint32_t value) {
+    hostAdcSeq_t* seq = &hostAdcOf(base)->seq[3];
+    uint32_t i;
+    if (!seq->enabled) {
+        return;
+    }
+    if (seq->dmaEnabled) {
+        for (i = 0; i < HOST_DMA_CHANNELS; i++) {
+            if (hostDma[i].adcBase == base) {
+                hostDmaRequest(&hostDma[i], value, base);
+                return;
+            }
+        }
+        hostFail("no uDMA channel for ADC", base);
+    }
+    seq->fifo = value;
+    if (seq->intEnabled) {
+        hostIntRaise(hostAdcInt(base, 3));
+    }
+}
+
+// One comparator sequence conversion. Each step sends the value to its
+// comparator, which interrupts once on entering its band.
+void hostAdcCompare(uint32_t base, uint32_t seqNum, uint32_t value) {
+    hostAdc_t* adc = hostAdcOf(base);
+    hostAdcSeq_t* seq = &adc->seq[seqNum];
+    uint32_t step;
+    bool raised = false;
+    if (!seq->enabled) {
+        return;
+    }
+    for (step = 0; step < HOST_ADC_STEPS; step++) {
+        uint32_t config = seq->steps[step];
+        if ((config & ADC_CTL_CMP0) == ADC_CTL_CMP0) {
+            uint32_t comp = (config >> 16) & 0x7;
+            bool inBand = (adc->cmpConfig[comp] == ADC_COMP_INT_LOW_HONCE)
+                        ? value < adc->cmpLow[comp] : value >= adc->cmpHigh[comp];
+            if (inBand && !(adc->cmpInBand & (1 << comp))) {
+                adc->cmpStatus |= 1 << comp;
+                raised = true;
+            }
+            if (inBand) {
+                adc->cmpInBand |= 1 << comp;
+            } else {
+                adc->cmpInBand &= ~(1 << comp);
+            }
+        }
+        if (config & ADC_CTL_END) {
+            break;
+        }
+    }
+    if (raised) {
+        adc->intStatusEx |= ADC_INT_DCON_SS0 << seqNum;
+        if (seq->cmpIntEnabled) {
+            hostIntRaise(hostAdcInt(base, seqNum));
+        }
+    }
+}
+
+// Quadrature edges seen by the QEI
+void hostQeiMove(int32_t edges) {
+    hostQei.position += (uint32_t) edges;
+    hostQei.velocity = (uint32_t) abs(edges);
+    hostQei.direction = (edges < 0) ? -1 : 1;
+}
+/*--------------------------------------------------------------*/
+
+/* sysctl ------------------------------------------------------*/
+void SysCtlPeripheralEnable(uint32_t periph) {
+    (void) periph;
+}
+
+bool SysCtlPeripheralReady(uint32_t periph) {
+    (void) periph;
+    return true;
+}
+
+uint32_t SysCtlClockGet(void) {
+    return HOST_CLOCK_HZ;
+}
+
+void SysCtlPWMClockSet(uint32_t config) {
+    hostPwmClock = config;
+}
+/*--------------------------------------------------------------*/
+
+/* interrupt ---------------------------------------------------*/
+void IntRegister(uint32_t interrupt, hostHandler_t handler) {
+    hostIntHandler[interrupt] = handler;
+}
+
+void IntEnable(uint32_t interrupt) {
+    hostIntEnabled[interrupt] = true;
+    if (hostIntPending[interrupt]) {
+        hostIntPending[interrupt] = false;
+        hostIntRaise(interrupt);
+    }
+}
+
+void IntDisable(uint32_t interrupt) {
+    hostIntEnabled[interrupt] = false;
+}
+
+void IntPrioritySet(uint32_t interrupt, uint8_t priority) {
+    hostIntPriority[interrupt] = priority;
+}
+/*--------------------------------------------------------------*/
+
+/* gpio --------------------------------------------------------*/
+void GPIOPinTypeGPIOInput(uint32_t base, uint8_t pins) {
+    hostGpioOf(base)->inputs |= pins;
+}
+
+// PD7 is locked at reset, its commit bit has to be set first
+void GPIOPinTypeQEI(uint32_t base, uint8_t pins) {
+    if (base == GPIO_PORTD_BASE && (pins & GPIO_PIN_7) &&
+        !(*hostRegister(GPIO_PORTD_BASE + GPIO_O_CR) & GPIO_PIN_7)) {
+        hostFail("PD7 still locked, pins", pins);
+    }
+    hostGpioOf(base)->qei |= pins;
+}
+
+void GPIOPinConfigure(uint32_t config) {
+    if (hostPinConfigs < 8) {
+        hostPinConfig[hostPinConfigs++] = config;
+    }
+}
+
+int32_t GPIOPinRead(uint32_t base, uint8_t pins) {
+    return hostGpioOf(base)->pins & pins;
+}
+
+void GPIOIntTypeSet(uint32_t base, uint8_t pins, uint32_t type) {
+    (void) pins;
+    hostGpioOf(base)->intType = type;
+}
+
+void GPIOIntEnable(uint32_t base, uint32_t pins) {
+    hostGpioOf(base)->intEnabled |= pins;
+}
+
+void GPIOIntClear(uint32_t base, uint32_t pins) {
+    (void) base;
+    (void) pins;
+}
+/*--------------------------------------------------------------*/
+
+/* adc ---------------------------------------------------------*/
+void ADCHardwareOversampleConfigure(uint32_t base, uint32_t factor) {
+    hostAdcOf(base)->oversample = factor;
+}
+
+void ADCSequenceConfigure(uint32_t base, uint32_t seq, uint32_t trigger, uint32_t priority) {
+    hostAdcOf(base)->seq[seq].trigger = trigger;
+    hostAdcOf(base)->seq[seq].priority = priority;
+}
+
+void ADCSequenceStepConfigure(uint32_t base, uint32_t seq, uint32_t step, uint32_t config) {
+    hostAdcOf(base)->seq[seq].steps[step] = config;
+}
+
+void ADCSequenceEnable(uint32_t base, uint32_t seq) {
+    hostAdcOf(base)->seq[seq].enabled = true;
+}
+
+void ADCSequenceDMAEnable(uint32_t base, uint32_t seq) {
+    hostAdcOf(base)->seq[seq].dmaEnabled = true;
+}
+
+int32_t ADCSequenceDataGet(uint32_t base, uint32_t seq, uint32_t* buffer) {
+    *buffer = hostAdcOf(base)->seq[seq].fifo;
+    return 1;
+}
+
+void ADCProcessorTrigger(uint32_t base, uint32_t seq) {
+    (void) seq;
+    hostAdcOf(base)->processorTriggers++;
+}
+
+// Registers and enables the sequence interrupt in the NVIC
+void ADCIntRegister(uint32_t base, uint32_t seq, hostHandler_t handler) {
+    IntRegister(hostAdcInt(base, seq), handler);
+    IntEnable(hostAdcInt(base, seq));
+}
+
+void ADCIntEnable(uint32_t base, uint32_t seq) {
+    hostAdcOf(base)->seq[seq].intEnabled = true;
+}
+
+void ADCIntClear(uint32_t base, uint32_t seq) {
+    hostAdcOf(base)->seq[seq].intClears++;
+}
+
+void ADCIntClearEx(uint32_t base, uint32_t flags) {
+    hostAdcOf(base)->intStatusEx &= ~flags;
+}
+
+void ADCComparatorConfigure(uint32_t base, uint32_t comp, uint32_t config) {
+    hostAdcOf(base)->cmpConfig[comp] = config;
+}
+
+void ADCComparatorRegionSet(uint32_t base, uint32_t comp, uint32_t low, uint32_t high) {
+    hostAdcOf(base)->cmpLow[comp] = low;
+    hostAdcOf(base)->cmpHigh[comp] = high;
+}
+
+void ADCComparatorReset(uint32_t base, uint32_t comp, bool trigger, bool interrupt) {
+    (void) trigger;
+    if (interrupt) {
+        hostAdcOf(base)->cmpInBand &= ~(1 << comp);
+    }
+}
+
+void ADCComparatorIntEnable(uint32_t base, uint32_t seq) {
+    hostAdcOf(base)->seq[seq].cmpIntEnabled = true;
+}
+
+uint32_t ADCComparatorIntStatus(uint32_t base) {
+    return hostAdcOf(base)->cmpStatus;
+}
+
+void ADCComparatorIntClear(uint32_t base, uint32_t status) {
+    hostAdcOf(base)->cmpStatus &= ~status;
+}
+/*--------------------------------------------------------------*/
+
+/* timer -------------------------------------------------------*/
+void TimerConfigure(uint32_t base, uint32_t config) {
+    hostTimerOf(base)->config = config;
+}
+
+void TimerLoadSet(uint32_t base, uint32_t timer, uint32_t value) {
+    (void) timer;
+    hostTimerOf(base)->load = value;
+}
+
+uint32_t TimerLoadGet(uint32_t base, uint32_t timer) {
+    (void) timer;
+    return hostTimerOf(base)->load;
+}
+
+uint32_t TimerValueGet(uint32_t base, uint32_t timer) {
+    (void) timer;
+    return hostTimerOf(base)->value;
+}
+
+void TimerControlTrigger(uint32_t base, uint32_t timer, bool enable) {
+    (void) timer;
+    hostTimerOf(base)->trigger = enable;
+}
+
+void TimerEnable(uint32_t base, uint32_t timer) {
+    (void) timer;
+    hostTimerOf(base)->enabled = true;
+}
+/*--------------------------------------------------------------*/
+
+/* udma --------------------------------------------------------*/
+void uDMAEnable(void) {
+}
+
+// The control table must be 1024 byte aligned
+void uDMAControlBaseSet(void* base) {
+    hostDmaControlBase = base;
+}
+
+void uDMAChannelAssign(uint32_t mapping) {
+    if (mapping == UDMA_CH27_ADC1_3) {
+        hostDma[27].adcBase = ADC1_BASE;
+    }
+}
+
+void uDMAChannelAttributeDisable(uint32_t channel, uint32_t attr) {
+    hostDma[channel & 0x1f].attrDisabled |= attr;
+}
+
+void uDMAChannelControlSet(uint32_t channel, uint32_t control) {
+    hostDmaControlOf(channel)->control = control;
+}
+
+void uDMAChannelTransferSet(uint32_t channel, uint32_t mode, void* src, void* dst, uint32_t size) {
+    hostDmaControl_t* control = hostDmaControlOf(channel);
+    (void) src;
+    control->mode = mode;
+    control->dst = dst;
+    control->size = size;
+    control->count = 0;
+}
+
+uint32_t uDMAChannelModeGet(uint32_t channel) {
+    return hostDmaControlOf(channel)->mode;
+}
+
+void uDMAChannelEnable(uint32_t channel) {
+    hostDma[channel & 0x1f].enabled = true;
+}
+/*--------------------------------------------------------------*/
+
+/* qei ---------------------------------------------------------*/
+void QEIConfigure(uint32_t base, uint32_t config, uint32_t maxPosition) {
+    hostCheckQei(base);
+    hostQei.config = config;
+    hostQei.maxPosition = maxPosition;
+}
+
+void QEIVelocityConfigure(uint32_t base, uint32_t divider, uint32_t period) {
+    hostCheckQei(base);
+    hostQei.velDiv = divider;
+    hostQei.velPeriod = period;
+}
+
+void QEIPositionSet(uint32_t base, uint32_t position) {
+    hostCheckQei(base);
+    hostQei.position = position;
+}
+
+uint32_t QEIPositionGet(uint32_t base) {
+    hostCheckQei(base);
+    return hostQei.position;
+}
+
+uint32_t QEIVelocityGet(uint32_t base) {
+    hostCheckQei(base);
+    return hostQei.velocity;
+}
+
+int32_t QEIDirectionGet(uint32_t base) {
+    hostCheckQei(base);
+    return hostQei.direction;
+}
+
+void QEIVelocityEnable(uint32_t base) {
+    hostCheckQei(base);
+    hostQei.velEnabled = true;
+}
+
+void QEIEnable(uint32_t base) {
+    hostCheckQei(base);
+    hostQei.enabled = true;
+}
+
+uint32_t QEIIntStatus(uint32_t base, bool masked) {
+    hostCheckQei(base);
+    (void) masked;
+    return hostQei.intStatus;
+}
+
+void QEIIntClear(uint32_t base, uint32_t flags) {
+    hostCheckQei(base);
+    hostQei.intStatus &= ~flags;
+}
+/*--------------------------------------------------------------*/
+
+/* pwm ---------------------------------------------------------*/
+void PWMGenConfigure(uint32_t base, uint32_t gen, uint32_t config) {
+    hostPwmGen.base = base;
+    hostPwmGen.gen = gen;
+    hostPwmGen.config = config;
+}
+
+void PWMGenPeriodSet(uint32_t base, uint32_t gen, uint32_t period) {
+    (void) base;
+    (void) gen;
+    hostPwmGen.period = period;
+}
+
+void PWMGenIntTrigEnable(uint32_t base, uint32_t gen, uint32_t flags) {
+    (void) base;
+    (void) gen;
+    hostPwmGen.trigger = flags;
+}
+
+void PWMGenEnable(uint32_t base, uint32_t gen) {
+    (void) base;
+    (void) gen;
+    hostPwmGen.enabled = true;
+}
+/*--------------------------------------------------------------*/
+
+/* ustdlib -----------------------------------------------------*/
+// usprintf does not know the buffer size either, so the tests run
+// under the address sanitizer to catch any message that overruns
+int usprintf(char* buffer, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    int length = vsprintf(buffer, format, args);
+    va_end(args);
+    return length;
+}
+/*--------------------------------------------------------------*/
@@ -0,0 +1,353 @@
+/*---------------------------------------------------------------
+               ________________
+                 _____|___
+                / |__|    \-----__|__
+                \_________/------ |
+                ____|___|____
+
+-----------------------------------------------------------------
+ ENCE 464 Group 13
+ tiva.h
+
+ Host stand-in for the TivaWare headers and driverlib. Every
+ inc/ and driverlib/ header the modules include comes here.
+ Peripherals are plain structs the tests can read and drive:
+ the drivers write their configuration into them and the
+ host* functions play the part of the hardware.
+----------------------------------------------------------------*/
+#ifndef HOST_TIVA_H_
+#define HOST_TIVA_H_
+
+/* Includes ----------------------------------------------------*/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stddef.h>
+/*--------------------------------------------------------------*/
+
+/* Registers ---------------------------------------------------*/
+// Any address reads and writes a word kept by the stand-in
+#define HWREG(x)                (*hostRegister((uint32_t) (x)))
+
+// Memory map
+#define GPIO_PORTA_BASE         0x40004000
+#define GPIO_PORTB_BASE         0x40005000
+#define GPIO_PORTC_BASE         0x40006000
+#define GPIO_PORTD_BASE         0x40007000
+#define GPIO_PORTE_BASE         0x40024000
+#define GPIO_PORTF_BASE         0x40025000
+#define UART0_BASE              0x4000C000
+#define TIMER0_BASE             0x40030000
+#define TIMER1_BASE             0x40031000
+#define ADC0_BASE               0x40038000
+#define ADC1_BASE               0x40039000
+#define PWM0_BASE               0x40028000
+#define PWM1_BASE               0x40029000
+#define QEI0_BASE               0x4002C000
+
+// GPIO
+#define GPIO_O_LOCK             0x520
+#define GPIO_O_CR               0x524
+#define GPIO_LOCK_KEY           0x4C4F434B
+#define GPIO_PIN_0              0x01
+#define GPIO_PIN_1              0x02
+#define GPIO_PIN_2              0x04
+#define GPIO_PIN_3              0x08
+#define GPIO_PIN_4              0x10
+#define GPIO_PIN_5              0x20
+#define GPIO_PIN_6              0x40
+#define GPIO_PIN_7              0x80
+#define GPIO_RISING_EDGE        0x4
+#define GPIO_BOTH_EDGES         0x1
+#define GPIO_PC5_M0PWM7         0x00021404
+#define GPIO_PF1_M1PWM5         0x00050405
+#define GPIO_PD6_PHA0           0x00031806
+#define GPIO_PD7_PHB0           0x00031C06
+
+// Interrupts
+#define INT_GPIOB               17
+#define INT_GPIOC               18
+#define INT_GPIOD               19
+#define INT_GPIOF               46
+#define INT_ADC0SS0             30
+#define INT_ADC0SS2             32
+#define INT_ADC1SS0             64
+#define HOST_NUM_INTS           80
+
+// System control
+#define SYSCTL_PERIPH_ADC0      0xf0003800
+#define SYSCTL_PERIPH_ADC1      0xf0003801
+#define SYSCTL_PERIPH_GPIOA     0xf0000800
+#define SYSCTL_PERIPH_GPIOB     0xf0000801
+#define SYSCTL_PERIPH_GPIOC     0xf0000802
+#define SYSCTL_PERIPH_GPIOD     0xf0000803
+#define SYSCTL_PERIPH_GPIOE     0xf0000804
+#define SYSCTL_PERIPH_GPIOF     0xf0000805
+#define SYSCTL_PERIPH_PWM0      0xf0004000
+#define SYSCTL_PERIPH_PWM1      0xf0004001
+#define SYSCTL_PERIPH_QEI0      0xf0004400
+#define SYSCTL_PERIPH_TIMER0    0xf0000400
+#define SYSCTL_PERIPH_TIMER1    0xf0000401
+#define SYSCTL_PERIPH_UART0     0xf0001800
+#define SYSCTL_PERIPH_UDMA      0xf0000c00
+#define SYSCTL_PWMDIV_64        0x001A0000
+#define HOST_CLOCK_HZ           80000000
+
+// ADC
+#define ADC_O_SSFIFO3           0x0A8
+#define ADC_CTL_CH9             0x09
+#define ADC_CTL_IE              0x40
+#define ADC_CTL_END             0x20
+#define ADC_CTL_CMP0            0x00080000
+#define ADC_CTL_CMP1            0x00090000
+#define ADC_TRIGGER_PROCESSOR   0x0
+#define ADC_TRIGGER_TIMER       0x5
+#define ADC_TRIGGER_PWM0        0x6
+#define ADC_TRIGGER_PWM_MOD0    0x0
+#define ADC_COMP_INT_LOW_HONCE  0x14
+#define ADC_COMP_INT_HIGH_HONCE 0x1C
+#define ADC_INT_DCON_SS0        0x00010000
+#define ADC_INT_DCON_SS2        0x00040000
+#define HOST_ADC_SEQS           4
+#define HOST_ADC_STEPS          8
+#define HOST_ADC_CMPS           8
+
+// Timers
+#define TIMER_A                 0x00ff
+#define TIMER_CFG_PERIODIC      0x00000022
+#define TIMER_CFG_PERIODIC_UP   0x00000032
+
+// uDMA
+#define UDMA_CHANNEL_ADC3       17
+#define UDMA_CH27_ADC1_3        0x0001001b
+#define UDMA_PRI_SELECT         0x00000000
+#define UDMA_ALT_SELECT         0x00000020
+#define UDMA_MODE_STOP          0x00000000
+#define UDMA_MODE_PINGPONG      0x00000003
+#define UDMA_ATTR_USEBURST      0x00000001
+#define UDMA_ATTR_ALTSELECT     0x00000002
+#define UDMA_ATTR_HIGH_PRIORITY 0x00000004
+#define UDMA_ATTR_REQMASK       0x00000008
+#define UDMA_SIZE_32            0x22000000
+#define UDMA_SRC_INC_NONE       0x0c000000
+#define UDMA_DST_INC_32         0x80000000
+#define UDMA_ARB_1              0x00000000
+#define HOST_DMA_CHANNELS       32
+
+// QEI
+#define QEI_CONFIG_CAPTURE_A_B  0x00000008
+#define QEI_CONFIG_NO_RESET     0x00000000
+#define QEI_CONFIG_QUADRATURE   0x00000000
+#define QEI_CONFIG_SWAP         0x00000002
+#define QEI_VELDIV_1            0x00000000
+#define QEI_INTERROR            0x00000008
+
+// PWM
+#define PWM_GEN_0               0x00000040
+#define PWM_GEN_2               0x000000C0
+#define PWM_GEN_3               0x00000100
+#define PWM_OUT_5               0x000000C5
+#define PWM_OUT_7               0x00000107
+#define PWM_OUT_5_BIT           0x00000020
+#define PWM_OUT_7_BIT           0x00000080
+#define PWM_GEN_MODE_DOWN       0x00000000
+#define PWM_GEN_MODE_NO_SYNC    0x00000000
+#define PWM_TR_CNT_ZERO         0x00000100
+/*--------------------------------------------------------------*/
+
+/* Peripheral state --------------------------------------------*/
+typedef void (*hostHandler_t)(void);
+
+typedef struct hostAdcSeq_t {
+    uint32_t trigger;
+    uint32_t priority;
+    uint32_t steps[HOST_ADC_STEPS];
+    bool enabled;
+    bool dmaEnabled;
+    bool intEnabled;
+    bool cmpIntEnabled;
+    uint32_t fifo;          // Last result, read by ADCSequenceDataGet
+    uint32_t intClears;     // ADCIntClear calls
+} hostAdcSeq_t;
+
+typedef struct hostAdc_t {
+    uint32_t oversample;
+    hostAdcSeq_t seq[HOST_ADC_SEQS];
+    uint32_t cmpConfig[HOST_ADC_CMPS];
+    uint32_t cmpLow[HOST_ADC_CMPS];
+    uint32_t cmpHigh[HOST_ADC_CMPS];
+    uint32_t cmpInBand;     // Comparators in their band, a HONCE comparator is disarmed
+    uint32_t cmpStatus;     // Pending comparator interrupts
+    uint32_t intStatusEx;   // Pending sequence level flags (DCINSS etc.)
+    uint32_t processorTriggers;
+} hostAdc_t;
+
+typedef struct hostTimer_t {
+    uint32_t config;
+    uint32_t load;
+    uint32_t value;
+    bool trigger;
+    bool enabled;
+} hostTimer_t;
+
+typedef struct hostDmaControl_t {
+    uint32_t control;
+    uint32_t mode;
+    uint32_t* dst;
+    uint32_t size;
+    uint32_t count;         // Items written into dst
+} hostDmaControl_t;
+
+typedef struct hostDmaChannel_t {
+    hostDmaControl_t pri;
+    hostDmaControl_t alt;
+    bool useAlt;            // Alternate structure is the active one
+    bool enabled;
+    uint32_t attrDisabled;
+    uint32_t adcBase;       // ADC whose sequence 3 requests this channel
+} hostDmaChannel_t;
+
+typedef struct hostQei_t {
+    uint32_t config;
+    uint32_t maxPosition;
+    uint32_t velDiv;
+    uint32_t velPeriod;
+    uint32_t position;
+    uint32_t velocity;      // Edges in the last velocity period
+    int32_t direction;
+    uint32_t intStatus;
+    bool enabled;
+    bool velEnabled;
+} hostQei_t;
+
+typedef struct hostGpio_t {
+    uint32_t base;
+    uint8_t pins;           // Pin levels read by GPIOPinRead
+    uint8_t inputs;
+    uint8_t qei;
+    uint8_t intEnabled;
+    uint32_t intType;
+} hostGpio_t;
+
+typedef struct hostPwmGen_t {
+    uint32_t base;
+    uint32_t gen;
+    uint32_t config;
+    uint32_t period;
+    uint32_t trigger;
+    bool enabled;
+} hostPwmGen_t;
+
+extern hostAdc_t hostAdc[2];
+extern hostTimer_t hostTimer[2];
+extern hostDmaChannel_t hostDma[HOST_DMA_CHANNELS];
+extern void* hostDmaControlBase;
+extern hostQei_t hostQei;
+extern hostGpio_t hostGpio[6];
+extern hostPwmGen_t hostPwmGen;
+extern uint32_t hostPwmClock;
+extern hostHandler_t hostIntHandler[HOST_NUM_INTS];
+extern bool hostIntEnabled[HOST_NUM_INTS];
+extern bool hostIntPending[HOST_NUM_INTS];  // Raised while disabled, taken on IntEnable
+extern uint8_t hostIntPriority[HOST_NUM_INTS];
+extern uint32_t hostPinConfig[8];
+extern uint32_t hostPinConfigs;
+/*--------------------------------------------------------------*/
+
+/* Host control ------------------------------------------------*/
+// Word at a register address
+volatile uint32_t* hostRegister(uint32_t address);
+// Back to power on: all registers and peripherals cleared
+void hostReset(void);
+// One sequence 3 conversion on an ADC. The result goes to the FIFO and
+// the sequence interrupt, or to the uDMA channel reading the sequence.
+void hostAdcConvert(uint32_t base, uint32_t value);
+// One comparator sequence conversion. Comparators whose band the value
+// is in raise their interrupt once, as the HONCE modes do.
+void hostAdcCompare(uint32_t base, uint32_t seq, uint32_t value);
+// Quadrature edges seen by the QEI (signed by direction)
+void hostQeiMove(int32_t edges);
+/*--------------------------------------------------------------*/
+
+/* Driverlib ---------------------------------------------------*/
+// sysctl
+void SysCtlPeripheralEnable(uint32_t periph);
+bool SysCtlPeripheralReady(uint32_t periph);
+uint32_t SysCtlClockGet(void);
+void SysCtlPWMClockSet(uint32_t config);
+
+// interrupt
+void IntRegister(uint32_t interrupt, hostHandler_t handler);
+void IntEnable(uint32_t interrupt);
+void IntDisable(uint32_t interrupt);
+void IntPrioritySet(uint32_t interrupt, uint8_t priority);
+
+// gpio
+void GPIOPinTypeGPIOInput(uint32_t base, uint8_t pins);
+void GPIOPinTypeQEI(uint32_t base, uint8_t pins);
+void GPIOPinConfigure(uint32_t config);
+int32_t GPIOPinRead(uint32_t base, uint8_t pins);
+void GPIOIntTypeSet(uint32_t base, uint8_t pins, uint32_t type);
+void GPIOIntEnable(uint32_t base, uint32_t pins);
+void GPIOIntClear(uint32_t base, uint32_t pins);
+
+// adc
+void ADCHardwareOversampleConfigure(uint32_t base, uint32_t factor);
+void ADCSequenceConfigure(uint32_t base, uint32_t seq, uint32_t trigger, uint32_t priority);
+void ADCSequenceStepConfigure(uint32_t base, uint32_t seq, uint32_t step, uint32_t config);
+void ADCSequenceEnable(uint32_t base, uint32_t seq);
+void ADCSequenceDMAEnable(uint32_t base, uint32_t seq);
+int32_t ADCSequenceDataGet(uint32_t base, uint32_t seq, uint32_t* buffer);
+void ADCProcessorTrigger(uint32_t base, uint32_t seq);
+void ADCIntRegister(uint32_t base, uint32_t seq, hostHandler_t handler);
+void ADCIntEnable(uint32_t base, uint32_t seq);
+void ADCIntClear(uint32_t base, uint32_t seq);
+void ADCIntClearEx(uint32_t base, uint32_t flags);
+void ADCComparatorConfigure(uint32_t base, uint32_t comp, uint32_t config);
+void ADCComparatorRegionSet(uint32_t base, uint32_t comp, uint32_t low, uint32_t high);
+void ADCComparatorReset(uint32_t base, uint32_t comp, bool trigger, bool interrupt);
+void ADCComparatorIntEnable(uint32_t base, uint32_t seq);
+uint32_t ADCComparatorIntStatus(uint32_t base);
+void ADCComparatorIntClear(uint32_t base, uint32_t status);
+
+// timer
+void TimerConfigure(uint32_t base, uint32_t config);
+void TimerLoadSet(uint32_t base, uint32_t timer, uint32_t value);
+uint32_t TimerLoadGet(uint32_t base, uint32_t timer);
+uint32_t TimerValueGet(uint32_t base, uint32_t timer);
+void TimerControlTrigger(uint32_t base, uint32_t timer, bool enable);
+void TimerEnable(uint32_t base, uint32_t timer);
+
+// udma
+void uDMAEnable(void);
+void uDMAControlBaseSet(void* base);
+void uDMAChannelAssign(uint32_t mapping);
+void uDMAChannelAttributeDisable(uint32_t channel, uint32_t attr);
+void uDMAChannelControlSet(uint32_t channel, uint32_t control);
+void uDMAChannelTransferSet(uint32_t channel, uint32_t mode, void* src, void* dst, uint32_t size);
+uint32_t uDMAChannelModeGet(uint32_t channel);
+void uDMAChannelEnable(uint32_t channel);
+
+// qei
+void QEIConfigure(uint32_t base, uint32_t config, uint32_t maxPosition);
+void QEIVelocityConfigure(uint32_t base, uint32_t divider, uint32_t period);
+void QEIPositionSet(uint32_t base, uint32_t position);
+uint32_t QEIPositionGet(uint32_t base);
+uint32_t QEIVelocityGet(uint32_t base);
+int32_t QEIDirectionGet(uint32_t base);
+void QEIVelocityEnable(uint32_t base);
+void QEIEnable(uint32_t base);
+uint32_t QEIIntStatus(uint32_t base, bool masked);
+void QEIIntClear(uint32_t base, uint32_t flags);
+
+// pwm
+void PWMGenConfigure(uint32_t base, uint32_t gen, uint32_t config);
+void PWMGenPeriodSet(uint32_t base, uint32_t gen, uint32_t period);
+void PWMGenIntTrigEnable(uint32_t base, uint32_t gen, uint32_t flags);
+void PWMGenEnable(uint32_t base, uint32_t gen);
+
+// ustdlib
+int usprintf(char* buffer, const char* format, ...);
+/*--------------------------------------------------------------*/
+
+#endif /* HOST_TIVA_H_ */
@@ -0,0 +1,2 @@
+// Host build: see tiva.h
+#include "tiva.h"
@@ -0,0 +1,66 @@
+/*---------------------------------------------------------------
+               ________________
+                 _____|___
+                / |__|    \-----__|__
+                \_________/------ |
+                ____|___|____
+
+-----------------------------------------------------------------
+ ENCE 464 Group 13
+ plant.h
+
+ A simple model of the rig for the closed loop PID tests. Each
+ rotor axis is a mass driven by duty above its hover duty, with
+ drag and end stops. Include after pid.h.
+----------------------------------------------------------------*/
+#ifndef TEST_PLANT_H_
+#define TEST_PLANT_H_
+
+/* Includes ----------------------------------------------------*/
+#include <math.h>
+/*--------------------------------------------------------------*/
+
+/* Plant -------------------------------------------------------*/
+// One rotor axis. Altitude in percent, yaw in degrees.
+typedef struct testPlant_t {
+    double position;
+    double rate;            // Per second
+    double gain;            // Acceleration per duty
+    double damping;         // Drag per unit of rate
+    double hover;           // Duty that holds the axis still
+    double min;             // End stops, the same for no stops
+    double max;
+} testPlant_t;
+
+static const testPlant_t testMainPlant = {0, 0, 100, 12, 35, 0, 100};
+static const testPlant_t testTailPlant = {0, 0, 200, 16, 30, 0, 0};
+
+// Runs the plant for the given time (ms), a millisecond at a time
+static inline void testPlantStep(testPlant_t* p, double duty, uint32_t ms) {
+    uint32_t t;
+    for (t = 0; t < ms; t++) {
+        p->rate += (p->gain * (duty - p->hover) - p->damping * p->rate) / 1000;
+        p->position += p->rate / 1000;
+        if (p->min < p->max && p->position <= p->min) {
+            p->position = p->min;
+            p->rate = (p->rate < 0) ? 0 : p->rate;
+        } else if (p->min < p->max && p->position >= p->max) {
+            p->position = p->max;
+            p->rate = (p->rate > 0) ? 0 : p->rate;
+        }
+    }
+}
+
+// The position as a binary angle
+static inline yawBam_t testPlantAngle(const testPlant_t* p) {
+    return (yawBam_t) (uint32_t) (int64_t) llround(p->position * 4294967296.0 / 360.0);
+}
+
+// The measurements the estimators would give
+static inline void testPlantMeasure(const testPlant_t* p, pidHandle_t* h) {
+    h->current = h->config->isAngle ? testPlantAngle(p) : (int32_t) lround(p->position);
+    h->rate = (int32_t) lround(p->rate * (1 << PID_DIFF_FRAC_BITS));
+}
+/*--------------------------------------------------------------*/
+
+#endif /* TEST_PLANT_H_ */
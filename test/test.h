@@ -0,0 +1,75 @@
+/*---------------------------------------------------------------
+               ________________
+                 _____|___
+                / |__|    \-----__|__
+                \_________/------ |
+                ____|___|____
+
+-----------------------------------------------------------------
+ ENCE 464 Group 13
+ test.h
+
+ Checks for the host tests. Each test_*.c is one program: it
+ runs its TEST_RUN cases and returns non-zero if a check failed.
+----------------------------------------------------------------*/
+#ifndef TEST_H_
+#define TEST_H_
+
+/* Includes ----------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include "tiva.h"
+#include "rtos.h"
+#include "stubs.h"
+/*--------------------------------------------------------------*/
+
+/* Checks ------------------------------------------------------*/
+static int testChecks;
+static int testFailures;
+
+#define CHECK(cond) do { \
+    testChecks++; \
+    if (!(cond)) { \
+        printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+        testFailures++; \
+    } \
+} while (0)
+
+#define CHECK_EQ(a, b) do { \
+    long long testA = (long long) (a), testB = (long long) (b); \
+    testChecks++; \
+    if (testA != testB) { \
+        printf("%s:%d: %s == %s failed: %lld != %lld\n", \
+               __FILE__, __LINE__, #a, #b, testA, testB); \
+        testFailures++; \
+    } \
+} while (0)
+
+#define CHECK_NEAR(a, b, tol) do { \
+    double testA = (double) (a), testB = (double) (b); \
+    testChecks++; \
+    if (testA - testB > (tol) || testB - testA > (tol)) { \
+        printf("%s:%d: %s ~ %s failed: %g != %g (+-%g)\n", \
+               __FILE__, __LINE__, #a, #b, testA, testB, (double) (tol)); \
+        testFailures++; \
+    } \
+} while (0)
+/*--------------------------------------------------------------*/
+
+/* Running -----------------------------------------------------*/
+// Runs a case from fresh registers, queues and tick count
+#define TEST_RUN(test) do { \
+    hostReset(); \
+    hostRtosReset(); \
+    hostStubsReset(); \
+    test(); \
+} while (0)
+
+// Prints the totals and gives main's return value
+static int testReport(const char* name) {
+    printf("%s: %d checks, %d failed\n", name, testChecks, testFailures);
+    return testFailures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+/*--------------------------------------------------------------*/
+
+#endif /* TEST_H_ */
@@ -0,0 +1,51 @@
+/*---------------------------------------------------------------
+               ________________
+                 _____|___
+                / |__|    \-----__|__
+                \_________/------ |
+                ____|___|____
+
+-----------------------------------------------------------------
+ ENCE 464 Group 13
+ test_adc.c
+
+ Altitude ADC set up: timer triggered sequence 3 with hardware
+ oversampling
+----------------------------------------------------------------*/
+
+/* Includes ----------------------------------------------------*/
+#include "test.h"
+#include "main.h"
+#include "altitude.h"
+/*--------------------------------------------------------------*/
+
+/* Tests -------------------------------------------------------*/
+// Timer0A counts one sample period and starts each conversion
+static void testAdcTimerTrigger(void) {
+    altitudeInitADC();
+
+    CHECK_EQ(hostTimer[0].config, TIMER_CFG_PERIODIC);
+    CHECK_EQ(hostTimer[0].load, HOST_CLOCK_HZ / ALT_ADC_SAMPLE_RATE_HZ - 1);
+    CHECK(hostTimer[0].trigger);
+    CHECK(hostTimer[0].enabled);
+
+    CHECK_EQ(hostAdc[0].seq[ALTITUDE_ADC_SEQ_NUM].trigger, ALTITUDE_TIMER_TRIGGER);
+    CHECK(hostAdc[0].seq[ALTITUDE_ADC_SEQ_NUM].enabled);
+    CHECK_EQ(hostAdc[0].processorTriggers, 0);
+}
+
+// Each sample is the hardware average of ALT_ADC_HW_OVERSAMPLE conversions
+static void testAdcOversample(void) {
+    altitudeInitADC();
+
+    CHECK_EQ(hostAdc[0].oversample, ALT_ADC_HW_OVERSAMPLE);
+    CHECK_EQ(hostAdc[0].seq[ALTITUDE_ADC_SEQ_NUM].steps[ALTITUDE_ADC_STEP],
+             ALTITUDE_ADC_CHANNEL | ADC_CTL_IE | ADC_CTL_END);
+}
+/*--------------------------------------------------------------*/
+
+int main(void) {
+    TEST_RUN(testAdcTimerTrigger);
+    TEST_RUN(testAdcOversample);
+    return testReport("adc");
+}
@@ -0,0 +1,150 @@
+/*---------------------------------------------------------------
+               ________________
+                 _____|___
+                / |__|    \-----__|__
+                \_________/------ |
+                ____|___|____
+
+-----------------------------------------------------------------
+ ENCE 464 Group 13
+ test_cascade.c
+
+ Cascaded position and rate loops (PID_CASCADE)
+----------------------------------------------------------------*/
+
+/* Includes ----------------------------------------------------*/
+#include "test.h"
+#include "FreeRTOS.h"
+#include "queue.h"
+#include "../pid.h"
+// Build the cascade, the loop period follows from the divider
+#undef PID_CASCADE
+#define PID_CASCADE 1
+#undef PID_CASCADE_DIVIDER
+#define PID_CASCADE_DIVIDER (PID_TASK_DELAY / PID_RATE_DELAY)
+#include "../pid.c"
+#include "plant.h"
+/*--------------------------------------------------------------*/
+
+/* Helpers -----------------------------------------------------*/
+static testPlant_t testMain;
+static testPlant_t testTail;
+static uint32_t testPeriod;
+static uint32_t testStepPeriod;     // Period the second targets are sent
+static uint32_t testPeriods;
+static controlTargetMessage_t testTargets[2];
+static pwmUpdateMessage_t testPwm;
+static testPlant_t testBeforeStep[2];
+
+// Each task period: applies the duties sent, runs the rig for the
+// period and sends what the sensors would see
+static void testCascadeHook(TickType_t now) {
+    (void) now;
+    while (xQueueReceive(xPWMQueue, &testPwm, 0) == pdPASS) {
+        hostMainDuty = testPwm.main;
+    }
+    testPlantStep(&testMain, testPwm.main, PID_LOOP_DELAY);
+    testPlantStep(&testTail, testPwm.tail, PID_LOOP_DELAY);
+    altitudeMessage_t altitude = {(int32_t) lround(testMain.position),
+                                  (int32_t) lround(testMain.rate * (1 << ALT_FRAC_BITS))};
+    yawMessage_t yaw = {testPlantAngle(&testTail),
+                        (int32_t) lround(testTail.rate * (1 << PID_DIFF_FRAC_BITS))};
+    xQueueOverwrite(xMeasuredAltitudeQueue, &altitude);
+    xQueueSend(xMeasuredYawQueue, &yaw, 0);
+
+    if (testPeriod == 0 || testPeriod == testStepPeriod) {
+        xQueueSend(xControlTargetQueue, &testTargets[testPeriod != 0], 0);
+    }
+    if (testPeriod == testStepPeriod) {
+        testBeforeStep[0] = testMain;
+        testBeforeStep[1] = testTail;
+    }
+    if (testPeriod++ == testPeriods) {
+        hostTaskExit();
+    }
+}
+
+// Flies pidTask from the ground to the first targets, then after
+// stepAt (ms) to the second, for the given time (ms) in all
+static void testCascadeFly(controlTargetMessage_t first, controlTargetMessage_t second,
+                           uint32_t stepAt, uint32_t ms) {
+    testMain = testMainPlant;
+    testTail = testTailPlant;
+    testPwm = (pwmUpdateMessage_t) {0, 0};
+    testTargets[0] = first;
+    testTargets[1] = second;
+    testPeriod = 0;
+    testStepPeriod = stepAt / PID_LOOP_DELAY;
+    testPeriods = ms / PID_LOOP_DELAY;
+    hostDelayHook = testCascadeHook;
+    hostTaskRun(pidTask, NULL);
+}
+/*--------------------------------------------------------------*/
+
+/* Tests -------------------------------------------------------*/
+// Every loop's gains pack into the kernel without wrapping, the
+// outer gains over 1000 included
+static void testCascadeGains(void) {
+    uint32_t axis;
+    for (axis = 0; axis < PID_NUM_AXES; axis++) {
+        const pidConfig_t* config = &pidConfigs[axis];
+        pidHandle_t h;
+        pidInit(&h, config);
+        int32_t kp = pidGainQ(config->kp * 1000, PID_GAIN_BITS - config->errorBits);
+        CHECK(kp > 0 && kp < 32768);
+        CHECK_EQ((int16_t) h.gainsPI, kp);
+        CHECK(h.kiPeriod >= 0);
+        CHECK(((int16_t) (h.gainsPI >> 16) > 0) == (config->ki > 0));
+    }
+    CHECK(MAIN_OUTER_GAIN > 1000);
+    CHECK(TAIL_OUTER_GAIN > 1000);
+}
+
+// The inner gains split the position gains at the outer gain, the
+// integral rounded rather than truncated
+static void testCascadeSplit(void) {
+    double mainKi = MAIN_INT_GAIN * 1000.0 / PID_TASK_DELAY;
+    double tailKi = TAIL_INT_GAIN * 1000.0 / PID_TASK_DELAY;
+    CHECK_NEAR(MAIN_RATE_INT_GAIN * (MAIN_OUTER_GAIN / 1000.0), mainKi, MAIN_OUTER_GAIN / 2000.0);
+    CHECK_NEAR(TAIL_RATE_INT_GAIN * (TAIL_OUTER_GAIN / 1000.0), tailKi, TAIL_OUTER_GAIN / 2000.0);
+    CHECK_NEAR(MAIN_RATE_PROP_GAIN * (MAIN_OUTER_GAIN / 1000.0), MAIN_PROP_GAIN, MAIN_OUTER_GAIN / 1000.0);
+}
+
+// The outer loop's rate target keeps the fraction of the error and
+// is held to the rate limits
+static void testCascadeRateTarget(void) {
+    pidHandle_t altitude;
+    pidHandle_t altitudeRate;
+    pidInit(&altitude, &pidConfigs[PID_MAIN]);
+    pidInit(&altitudeRate, &pidConfigs[PID_MAIN_RATE]);
+
+    altitude.weightedError = (10 << PID_DIFF_FRAC_BITS) + 128;
+    CHECK_EQ(pidRateTarget(&altitude), (int32_t) (10.5 * 256 * MAIN_OUTER_GAIN / 1000));
+    altitude.weightedError = -(100 << PID_DIFF_FRAC_BITS);
+    CHECK_EQ(pidRateTarget(&altitude), -(MAIN_RATE_MAX << PID_DIFF_FRAC_BITS));
+
+    // Half a percent per second still reaches the inner P term
+    altitudeRate.target = 128;
+    altitudeRate.current = 0;
+    pidCalcErrors(&altitudeRate);
+    CHECK_EQ(altitudeRate.propError, 128 >> (PID_DIFF_FRAC_BITS - PID_RATE_ERROR_BITS));
+}
+
+// pidTask flies the cascade to altitude and yaw steps
+static void testCascadeStep(void) {
+    testCascadeFly((controlTargetMessage_t) {0, 30}, (controlTargetMessage_t) {45, 60},
+                   30000, 50000);
+    CHECK_NEAR(testBeforeStep[0].position, 30, 1.5);
+    CHECK_NEAR(testBeforeStep[1].position, 0, 1.5);
+    CHECK_NEAR(testMain.position, 60, 1.5);
+    CHECK_NEAR(testTail.position, 45, 1.5);
+}
+/*--------------------------------------------------------------*/
+
+int main(void) {
+    TEST_RUN(testCascadeGains);
+    TEST_RUN(testCascadeSplit);
+    TEST_RUN(testCascadeRateTarget);
+    TEST_RUN(testCascadeStep);
+    return testReport("cascade");
+}
@@ -0,0 +1,106 @@
+/*---------------------------------------------------------------
+               ________________
+                 _____|___
+                / |__|    \-----__|__
+                \_________/------ |
+                ____|___|____
+
+-----------------------------------------------------------------
+ ENCE 464 Group 13
+ test_circBuf.c
+
+ Circular buffer running sum and mean against a full recount
+----------------------------------------------------------------*/
+
+/* Includes ----------------------------------------------------*/
+#include "test.h"
+#include "circBufT.h"
+/*--------------------------------------------------------------*/
+
+/* Helpers -----------------------------------------------------*/
+#define TEST_BUF_MAX    64
+
+static uint32_t testRandom = 12345;
+
+// Repeatable ADC like values, 0 to 4095
+static uint32_t testNextRandom(void) {
+    testRandom = testRandom * 1103515245 + 12345;
+    return (testRandom >> 16) & 0xfff;
+}
+
+// Sum of every entry, the slow way
+static uint32_t testRecount(const circBuf_t* buffer) {
+    uint32_t sum = 0;
+    uint32_t i;
+    for (i = 0; i < buffer->size; i++) {
+        sum += buffer->data[i];
+    }
+    return sum;
+}
+/*--------------------------------------------------------------*/
+
+/* Tests -------------------------------------------------------*/
+// Entries come back in the order written, wrapping at the end
+static void testCircBufOrder(void) {
+    uint32_t data[5];
+    circBuf_t buffer;
+    uint32_t i;
+    initCircBuf(&buffer, data, 5);
+
+    for (i = 0; i < 7; i++) {
+        writeCircBuf(&buffer, i + 1);
+    }
+    // The first two were overwritten by 6 and 7
+    CHECK_EQ(readCircBuf(&buffer), 6);
+    CHECK_EQ(readCircBuf(&buffer), 7);
+    CHECK_EQ(readCircBuf(&buffer), 3);
+    CHECK_EQ(readCircBuf(&buffer), 4);
+    CHECK_EQ(readCircBuf(&buffer), 5);
+    CHECK_EQ(readCircBuf(&buffer), 6);
+}
+
+// The running sum always matches a recount and the mean rounds it
+static void testCircBufRunningSum(void) {
+    static const uint32_t sizes[] = {1, 7, 16, TEST_BUF_MAX};
+    uint32_t data[TEST_BUF_MAX];
+    uint32_t s, i;
+
+    for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        circBuf_t buffer;
+        initCircBuf(&buffer, data, sizes[s]);
+        CHECK_EQ(buffer.sum, 0);
+        CHECK_EQ(meanCircBuf(&buffer), 0);
+
+        for (i = 0; i < 1000; i++) {
+            writeCircBuf(&buffer, testNextRandom());
+            if (buffer.sum != testRecount(&buffer)) {
+                break;
+            }
+        }
+        CHECK_EQ(i, 1000);
+        CHECK_EQ(buffer.sum, testRecount(&buffer));
+        CHECK_EQ(meanCircBuf(&buffer), (testRecount(&buffer) + sizes[s] / 2) / sizes[s]);
+    }
+}
+
+// Two's complement entries keep a sum that is right read as signed
+static void testCircBufSignedSum(void) {
+    uint32_t data[8];
+    circBuf_t buffer;
+    uint32_t i;
+    initCircBuf(&buffer, data, 8);
+
+    for (i = 0; i < 20; i++) {
+        writeCircBuf(&buffer, (uint32_t) -(int32_t) (100 + i));
+    }
+    // The last eight were -112 to -119
+    CHECK_EQ((int32_t) buffer.sum, -(112 + 119) * 4);
+}
+/*--------------------------------------------------------------*/
+
+int main(void) {
+    TEST_RUN(testCircBufOrder);
+    TEST_RUN(testCircBufRunningSum);
+    TEST_RUN(testCircBufSignedSum);
+    return testReport("circBuf");
+}
@@ -0,0 +1,158 @@
+/*---------------------------------------------------------------
+               ________________
+                 _____|___
+                / |__|    \-----__|__
+                \_________/------ |
+                ____|___|____
+
+-----------------------------------------------------------------
+ ENCE 464 Group 13
+ test_dma.c
+
+ Altitude uDMA ping-pong blocks, overruns and their report
+----------------------------------------------------------------*/
+
+/* Includes ----------------------------------------------------*/
+#include <string.h>
+#include "test.h"
+#include "../altitude.c"
+/*--------------------------------------------------------------*/
+
+/* Helpers -----------------------------------------------------*/
+static uint32_t testNextSample;
+
+// Back to no blocks taken and no overruns
+static void testDmaInit(void) {
+    uint32_t i;
+    for (i = 0; i < ALT_ADC_COUNT; i++) {
+        altCapture[i].busy[0] = false;
+        altCapture[i].busy[1] = false;
+        altCapture[i].sequence = 0;
+    }
+    altADCOverruns = 0;
+    altCurrentBlock.length = 0;
+    testNextSample = 1000;
+    altitudeInitADC();
+}
+
+// One block's worth of conversions, each a new value
+static void testDmaFill(void) {
+    uint32_t i;
+    for (i = 0; i < ALT_ADC_BLOCK_LENGTH; i++) {
+        hostAdcConvert(ALTITUDE_ADC_BASE, testNextSample++);
+    }
+}
+
+// Times text appears in the UART log
+static uint32_t testUartCount(const char* text) {
+    uint32_t count = 0;
+    const char* at = hostUartLog;
+    while ((at = strstr(at, text)) != NULL) {
+        count++;
+        at += strlen(text);
+    }
+    return count;
+}
+/*--------------------------------------------------------------*/
+
+/* Tests -------------------------------------------------------*/
+// Blocks alternate between the two buffers and keep their samples
+static void testDmaPingPong(void) {
+    altitudeADCBlock_t block;
+    uint32_t i;
+    testDmaInit();
+
+    testDmaFill();
+    CHECK_EQ(uxQueueMessagesWaiting(xAltitudeADCQueue), 1);
+    CHECK(xQueueReceive(xAltitudeADCQueue, &block, 0) == pdPASS);
+    CHECK_EQ(block.index, 0);
+    CHECK_EQ(block.sequence, 0);
+    CHECK_EQ(block.length, ALT_ADC_BLOCK_LENGTH);
+    for (i = 0; i < ALT_ADC_BLOCK_LENGTH; i++) {
+        CHECK_EQ(block.samples[i], 1000 + i);
+    }
+    altitudeReleaseBlock(&block);
+
+    testDmaFill();
+    CHECK(xQueueReceive(xAltitudeADCQueue, &block, 0) == pdPASS);
+    CHECK_EQ(block.index, 1);
+    CHECK_EQ(block.sequence, 1);
+    CHECK_EQ(block.samples[0], 1000 + ALT_ADC_BLOCK_LENGTH);
+    altitudeReleaseBlock(&block);
+
+    // The first buffer was re-armed when it completed
+    testDmaFill();
+    CHECK(xQueueReceive(xAltitudeADCQueue, &block, 0) == pdPASS);
+    CHECK_EQ(block.index, 0);
+    CHECK_EQ(block.samples[0], 1000 + 2 * ALT_ADC_BLOCK_LENGTH);
+    altitudeReleaseBlock(&block);
+    CHECK_EQ(altitudeGetOverruns(), 0);
+}
+
+// The uDMA writing into a block the task still holds is an overrun
+static void testDmaOverrunHeld(void) {
+    altitudeADCBlock_t block;
+    testDmaInit();
+
+    testDmaFill();
+    CHECK(xQueueReceive(xAltitudeADCQueue, &block, 0) == pdPASS);
+    testDmaFill();
+    CHECK_EQ(altitudeGetOverruns(), 1);
+
+    altitudeReleaseBlock(&block);
+    CHECK(xQueueReceive(xAltitudeADCQueue, &block, 0) == pdPASS);
+    altitudeReleaseBlock(&block);
+    testDmaFill();
+    CHECK_EQ(altitudeGetOverruns(), 1);
+}
+
+// A block that does not fit in the queue is dropped and counted
+static void testDmaOverrunQueueFull(void) {
+    testDmaInit();
+
+    testDmaFill();
+    testDmaFill();
+    CHECK_EQ(uxQueueMessagesWaiting(xAltitudeADCQueue), 2);
+    testDmaFill();
+    CHECK_EQ(uxQueueMessagesWaiting(xAltitudeADCQueue), 2);
+    CHECK(altitudeGetOverruns() > 0);
+}
+
+// Converts at the sample rate and loses a block every tick after 0.2s
+static void testDmaReportHook(TickType_t now) {
+    if (now % ALT_ADC_SAMPLE_DELAY == 0) {
+        hostAdcConvert(ALTITUDE_ADC_BASE, 2000);
+    }
+    if (now > 200) {
+        altADCOverruns++;
+    }
+    if (now >= 3500) {
+        hostTaskExit();
+    }
+}
+
+// Constant overruns are reported at most once per report period, and
+// the task keeps overwriting the altitude mailbox with nobody reading
+static void testDmaOverrunReport(void) {
+    altitudeMessage_t measured;
+    testDmaInit();
+
+    hostDelayHook = testDmaReportHook;
+    hostTaskRun(altitudeAvgTask, NULL);
+
+    uint32_t reports = testUartCount("altOverrun");
+    CHECK(reports >= 3);
+    CHECK(reports <= 3300 / ALT_OVERRUN_REPORT_MS + 1);
+    CHECK_EQ(uxQueueMessagesWaiting(xMeasuredAltitudeQueue), 1);
+    CHECK(xQueueReceive(xMeasuredAltitudeQueue, &measured, 0) == pdPASS);
+    CHECK_EQ(measured.altitude, 0);
+}
+/*--------------------------------------------------------------*/
+
+int main(void) {
+    TEST_RUN(testDmaPingPong);
+    TEST_RUN(testDmaOverrunHeld);
+    TEST_RUN(testDmaOverrunQueueFull);
+    TEST_RUN(testDmaOverrunReport);
+    return testReport("dma");
+}
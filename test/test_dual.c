@@ -0,0 +1,157 @@
+/*---------------------------------------------------------------
+               ________________
+                 _____|___
+                / |__|    \-----__|__
+                \_________/------ |
+                ____|___|____
+
+-----------------------------------------------------------------
+ ENCE 464 Group 13
+ test_dual.c
+
+ Interleaved altitude sampling on both ADCs (ALT_ADC_DUAL)
+----------------------------------------------------------------*/
+
+/* Includes ----------------------------------------------------*/
+#include "test.h"
+#include "FreeRTOS.h"
+#include "queue.h"
+#include "../altitude.h"
+// Sample on ADC1 as well, ALT_ADC_COUNT follows
+#undef ALT_ADC_DUAL
+#define ALT_ADC_DUAL 1
+#include "../altitude.c"
+/*--------------------------------------------------------------*/
+
+/* Helpers -----------------------------------------------------*/
+static uint32_t testNextSample;
+
+// Back to no blocks taken, pending or lost. The stub queue is sized
+// for one ADC, so it is made again for two.
+static void testDualInit(void) {
+    uint32_t i;
+    for (i = 0; i < ALT_ADC_COUNT; i++) {
+        altCapture[i].busy[0] = false;
+        altCapture[i].busy[1] = false;
+        altCapture[i].sequence = 0;
+        altPendingBlock[i].length = 0;
+    }
+    altADCOverruns = 0;
+    altUnpaired = 0;
+    testNextSample = 1000;
+    vQueueDelete(xAltitudeADCQueue);
+    xAltitudeADCQueue = xQueueCreate(2 * ALT_ADC_COUNT, sizeof(altitudeADCBlock_t));
+    altitudeInitADC();
+}
+
+// One block period on both ADCs. ADC1 converts half a period after
+// ADC0, so a ramp in time gives ADC0 the even values and ADC1 the odd.
+static void testDualFill(bool adc0, bool adc1) {
+    uint32_t i;
+    for (i = 0; i < ALT_ADC_BLOCK_LENGTH; i++) {
+        if (adc0) {
+            hostAdcConvert(ALTITUDE_ADC_BASE, testNextSample);
+        }
+        if (adc1) {
+            hostAdcConvert(ALTITUDE_ADC1_BASE, testNextSample + 1);
+        }
+        testNextSample += 2;
+    }
+}
+
+// The merged samples are the ramp from first, one per half period
+static void testDualCheckRamp(const uint32_t* samples, uint32_t count, uint32_t first) {
+    uint32_t i;
+    CHECK_EQ(count, ALT_ADC_COUNT * ALT_ADC_BLOCK_LENGTH);
+    for (i = 0; i < count; i++) {
+        CHECK_EQ(samples[i], first + i);
+    }
+}
+/*--------------------------------------------------------------*/
+
+/* Tests -------------------------------------------------------*/
+// ADC1 converts through its own uDMA channel on the PWM trigger, one
+// trigger per sample period
+static void testDualSetup(void) {
+    testDualInit();
+    CHECK(hostAdc[1].seq[ALTITUDE_ADC_SEQ_NUM].enabled);
+    CHECK(hostAdc[1].seq[ALTITUDE_ADC_SEQ_NUM].dmaEnabled);
+    CHECK_EQ(hostAdc[1].seq[ALTITUDE_ADC_SEQ_NUM].trigger, ALTITUDE_ADC1_TRIGGER);
+    CHECK_EQ(hostDma[ALTITUDE_DMA1_CHANNEL].adcBase, ALTITUDE_ADC1_BASE);
+    CHECK_EQ(hostPwmGen.period, SysCtlClockGet() / PWM_CLOCK_DIVISOR / ALT_ADC_SAMPLE_RATE_HZ);
+    CHECK_EQ(hostPwmGen.trigger, PWM_TR_CNT_ZERO);
+    CHECK(hostPwmGen.enabled);
+    CHECK(hostTimer[0].enabled);
+}
+
+// Blocks from the same period are interleaved in time order and both
+// go back to the uDMA
+static void testDualInterleave(void) {
+    const uint32_t* samples;
+    uint32_t count;
+    uint32_t block;
+    testDualInit();
+
+    for (block = 0; block < 4; block++) {
+        uint32_t first = testNextSample;
+        testDualFill(true, true);
+        count = altitudeWaitSamples(&samples, 0);
+        testDualCheckRamp(samples, count, first);
+        CHECK(!altCapture[0].busy[block % 2]);
+        CHECK(!altCapture[1].busy[block % 2]);
+    }
+    CHECK_EQ(altitudeWaitSamples(&samples, 0), 0);
+    CHECK_EQ(altitudeGetOverruns(), 0);
+}
+
+// A block whose partner was lost is dropped and counted, and the next
+// pair still merges. The dropped block was held while the uDMA filled
+// the other buffer, which also counts as an overrun.
+static void testDualUnpaired(void) {
+    const uint32_t* samples;
+    uint32_t first;
+    testDualInit();
+
+    // ADC0's block for this period never arrives
+    testDualFill(false, true);
+    altCapture[0].sequence++;
+    CHECK_EQ(altitudeWaitSamples(&samples, 0), 0);
+    CHECK_EQ(altitudeGetOverruns(), 0);
+
+    first = testNextSample;
+    testDualFill(true, true);
+    testDualCheckRamp(samples, altitudeWaitSamples(&samples, 0), first);
+    CHECK_EQ(altUnpaired, 1);
+    CHECK_EQ(altitudeGetOverruns(), 2);
+    CHECK(!altCapture[1].busy[0]);
+    CHECK(!altCapture[1].busy[1]);
+}
+
+// A newer block from the same ADC replaces an unpaired one
+static void testDualReplaced(void) {
+    const uint32_t* samples;
+    uint32_t first;
+    testDualInit();
+
+    // ADC1's block for this period never arrives
+    testDualFill(true, false);
+    altCapture[1].sequence++;
+    CHECK_EQ(altitudeWaitSamples(&samples, 0), 0);
+
+    first = testNextSample;
+    testDualFill(true, true);
+    testDualCheckRamp(samples, altitudeWaitSamples(&samples, 0), first);
+    CHECK_EQ(altUnpaired, 1);
+    CHECK_EQ(altitudeGetOverruns(), 2);
+    CHECK(!altCapture[0].busy[0]);
+    CHECK(!altCapture[0].busy[1]);
+}
+/*--------------------------------------------------------------*/
+
+int main(void) {
+    TEST_RUN(testDualSetup);
+    TEST_RUN(testDualInterleave);
+    TEST_RUN(testDualUnpaired);
+    TEST_RUN(testDualReplaced);
+    return testReport("dual");
+}
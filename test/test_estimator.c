@@ -0,0 +1,134 @@
+/*---------------------------------------------------------------
+               ________________
+                 _____|___
+                / |__|    \-----__|__
+                \_________/------ |
+                ____|___|____
+
+-----------------------------------------------------------------
+ ENCE 464 Group 13
+ test_estimator.c
+
+ Alpha-beta altitude estimator against a float reference
+----------------------------------------------------------------*/
+
+/* Includes ----------------------------------------------------*/
+#include "test.h"
+#include "../altitude.c"
+/*--------------------------------------------------------------*/
+
+/* Helpers -----------------------------------------------------*/
+#define TEST_ONE    (1 << ESTIMATOR_FRAC_BITS)
+
+// The same filter in double precision
+typedef struct testReference_t {
+    double position;
+    double velocity;
+} testReference_t;
+
+static void testReferenceUpdate(testReference_t* r, double measurement) {
+    const double alpha = ALT_EST_ALPHA / 32768.0;
+    const double beta = ALT_EST_BETA / 32768.0;
+    double predicted = r->position + r->velocity;
+    double residual = measurement - predicted;
+    r->position = predicted + alpha * residual;
+    r->velocity += beta * residual;
+}
+/*--------------------------------------------------------------*/
+
+/* Tests -------------------------------------------------------*/
+// A step settles on the new value with no velocity left
+static void testEstimatorStep(void) {
+    estimatorHandle_t h;
+    testReference_t r = {0, 0};
+    uint32_t i;
+    estimatorInit(&h, ALT_EST_ALPHA, ALT_EST_BETA, 0);
+
+    for (i = 0; i < 500; i++) {
+        estimatorUpdate(&h, 50 * TEST_ONE);
+        testReferenceUpdate(&r, 50);
+        CHECK_NEAR(h.position / (double) TEST_ONE, r.position, 0.01);
+    }
+    CHECK_NEAR(h.position / (double) TEST_ONE, 50, 0.01);
+    CHECK_NEAR(h.velocity / (double) TEST_ONE, 0, 0.001);
+}
+
+// A ramp, climbing or descending through zero, is tracked with no
+// lag once settled and its slope comes out as the velocity
+static void testEstimatorRamp(void) {
+    static const double slopes[] = {0.05, -0.05};
+    uint32_t s, i;
+
+    for (s = 0; s < 2; s++) {
+        estimatorHandle_t h;
+        testReference_t r = {0, 0};
+        double start = (slopes[s] > 0) ? -10 : 10;
+        estimatorInit(&h, ALT_EST_ALPHA, ALT_EST_BETA, (int32_t) (start * TEST_ONE));
+        r.position = start;
+
+        for (i = 0; i < 400; i++) {
+            double measurement = start + slopes[s] * i;
+            estimatorUpdate(&h, (int32_t) (measurement * TEST_ONE));
+            testReferenceUpdate(&r, measurement);
+        }
+        CHECK_NEAR(h.position / (double) TEST_ONE, r.position, 0.01);
+        CHECK_NEAR(h.position / (double) TEST_ONE, start + slopes[s] * 399, 0.01);
+        CHECK_NEAR(h.velocity / (double) TEST_ONE, slopes[s], 0.001);
+    }
+}
+
+// Noise on a constant is smoothed, not passed straight through
+static void testEstimatorNoise(void) {
+    estimatorHandle_t h;
+    uint32_t i;
+    int32_t worst = 0;
+    estimatorInit(&h, ALT_EST_ALPHA, ALT_EST_BETA, 20 * TEST_ONE);
+
+    for (i = 0; i < 1000; i++) {
+        int32_t noise = (i & 1) ? TEST_ONE : -TEST_ONE;
+        estimatorUpdate(&h, 20 * TEST_ONE + noise);
+        if (i > 100) {
+            int32_t error = h.position - 20 * TEST_ONE;
+            error = (error < 0) ? -error : error;
+            worst = (error > worst) ? error : worst;
+        }
+    }
+    CHECK(worst < TEST_ONE / 5);
+}
+
+// Ground for the calibration, then a climb at 20% per second
+#define TEST_GROUND_ADC     2500
+#define TEST_CLIMB_START    200
+#define TEST_CLIMB_END      2200
+static void testEstimatorClimbHook(TickType_t now) {
+    if (now % ALT_ADC_SAMPLE_DELAY == 0) {
+        int32_t climb = (now > TEST_CLIMB_START) ? now - TEST_CLIMB_START : 0;
+        int32_t drop = climb * 20 * ALT_ADC_SWING / 100 / 1000;
+        hostAdcConvert(ALTITUDE_ADC_BASE, TEST_GROUND_ADC - drop);
+    }
+    if (now >= TEST_CLIMB_END) {
+        hostTaskExit();
+    }
+}
+
+// altitudeAvgTask publishes the estimated climb rate with the altitude
+static void testEstimatorPublished(void) {
+    altitudeMessage_t measured;
+    altitudeInitADC();
+
+    hostDelayHook = testEstimatorClimbHook;
+    hostTaskRun(altitudeAvgTask, NULL);
+
+    CHECK(xQueueReceive(xMeasuredAltitudeQueue, &measured, 0) == pdPASS);
+    CHECK_NEAR(measured.velocity / (double) (1 << ALT_FRAC_BITS), 20, 1);
+    CHECK_NEAR(measured.altitude, 20 * (TEST_CLIMB_END - TEST_CLIMB_START) / 1000, 2);
+}
+/*--------------------------------------------------------------*/
+
+int main(void) {
+    TEST_RUN(testEstimatorStep);
+    TEST_RUN(testEstimatorRamp);
+    TEST_RUN(testEstimatorNoise);
+    TEST_RUN(testEstimatorPublished);
+    return testReport("estimator");
+}
@@ -0,0 +1,88 @@
+/*---------------------------------------------------------------
+               ________________
+                 _____|___
+                / |__|    \-----__|__
+                \_________/------ |
+                ____|___|____
+
+-----------------------------------------------------------------
+ ENCE 464 Group 13
+ test_estimatorFloat.c
+
+ Single precision alpha-beta update (ESTIMATOR_USE_FLOAT)
+----------------------------------------------------------------*/
+
+/* Includes ----------------------------------------------------*/
+#include "test.h"
+// Keep the state in floats behind the fixed point interface
+#define ESTIMATOR_USE_FLOAT 1
+#include "../estimator.c"
+#include "../altitude.h"
+/*--------------------------------------------------------------*/
+
+/* Helpers -----------------------------------------------------*/
+#define TEST_ONE    (1 << ESTIMATOR_FRAC_BITS)
+
+// The same filter in double precision
+typedef struct testReference_t {
+    double position;
+    double velocity;
+} testReference_t;
+
+static void testReferenceUpdate(testReference_t* r, double measurement) {
+    const double alpha = ALT_EST_ALPHA / 32768.0;
+    const double beta = ALT_EST_BETA / 32768.0;
+    double predicted = r->position + r->velocity;
+    double residual = measurement - predicted;
+    r->position = predicted + alpha * residual;
+    r->velocity += beta * residual;
+}
+/*--------------------------------------------------------------*/
+
+/* Tests -------------------------------------------------------*/
+// A step to the top of the range follows the double filter and
+// settles with no velocity left
+static void testEstimatorFloatStep(void) {
+    estimatorHandle_t h;
+    testReference_t r = {0, 0};
+    uint32_t i;
+    estimatorInit(&h, ALT_EST_ALPHA, ALT_EST_BETA, 0);
+
+    for (i = 0; i < 500; i++) {
+        estimatorUpdate(&h, ALT_PCNT_LIMIT * TEST_ONE);
+        testReferenceUpdate(&r, ALT_PCNT_LIMIT);
+        CHECK_NEAR(h.position / (double) TEST_ONE, r.position, 0.01);
+    }
+    CHECK_NEAR(h.position / (double) TEST_ONE, ALT_PCNT_LIMIT, 0.01);
+    CHECK_NEAR(h.velocity / (double) TEST_ONE, 0, 0.001);
+}
+
+// A ramp either way through zero is tracked and its slope comes out
+// as the velocity
+static void testEstimatorFloatRamp(void) {
+    static const double slopes[] = {0.05, -0.05};
+    uint32_t s, i;
+
+    for (s = 0; s < 2; s++) {
+        estimatorHandle_t h;
+        testReference_t r = {0, 0};
+        double start = (slopes[s] > 0) ? -10 : 10;
+        estimatorInit(&h, ALT_EST_ALPHA, ALT_EST_BETA, (int32_t) (start * TEST_ONE));
+        r.position = start;
+
+        for (i = 0; i < 400; i++) {
+            double measurement = start + slopes[s] * i;
+            estimatorUpdate(&h, (int32_t) (measurement * TEST_ONE));
+            testReferenceUpdate(&r, measurement);
+        }
+        CHECK_NEAR(h.position / (double) TEST_ONE, r.position, 0.01);
+        CHECK_NEAR(h.velocity / (double) TEST_ONE, slopes[s], 0.001);
+    }
+}
+/*--------------------------------------------------------------*/
+
+int main(void) {
+    TEST_RUN(testEstimatorFloatStep);
+    TEST_RUN(testEstimatorFloatRamp);
+    return testReport("estimatorFloat");
+}
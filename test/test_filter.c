@@ -0,0 +1,223 @@
+/*---------------------------------------------------------------
+               ________________
+                 _____|___
+                / |__|    \-----__|__
+                \_________/------ |
+                ____|___|____
+
+-----------------------------------------------------------------
+ ENCE 464 Group 13
+ test_filter.c
+
+ Filter chain stages against float references
+----------------------------------------------------------------*/
+
+/* Includes ----------------------------------------------------*/
+#include <math.h>
+#include "test.h"
+#include "main.h"
+#include "filter.h"
+/*--------------------------------------------------------------*/
+
+/* Helpers -----------------------------------------------------*/
+static uint32_t testRandom = 2024;
+
+// Repeatable values from -2048 to 2047
+static int32_t testNextRandom(void) {
+    testRandom = testRandom * 1103515245 + 12345;
+    return (int32_t) ((testRandom >> 16) & 0xfff) - 2048;
+}
+
+// Rounds half away from zero
+static int32_t testRound(double x) {
+    return (int32_t) ((x < 0) ? x - 0.5 : x + 0.5);
+}
+/*--------------------------------------------------------------*/
+
+/* Tests -------------------------------------------------------*/
+// The boxcar mean is right for negative samples and rounds half
+// away from zero either side
+static void testFilterBoxcarSigned(void) {
+    static const filterConfig_t config[] = {{FILTER_BOXCAR, 4}};
+    filterChain_t chain;
+    int32_t history[4] = {0};
+    uint32_t i;
+    CHECK(filterInit(&chain, config, 1));
+
+    filterProcess(&chain, -1);
+    filterProcess(&chain, -2);
+    filterProcess(&chain, -2);
+    filterProcess(&chain, -2);
+    CHECK_EQ(chain.output, -2);         // -1.75
+    filterProcess(&chain, -3);
+    filterProcess(&chain, -3);
+    CHECK_EQ(chain.output, -3);         // -2.5
+    filterProcess(&chain, 3);
+    filterProcess(&chain, 3);
+    filterProcess(&chain, 2);
+    filterProcess(&chain, 2);
+    CHECK_EQ(chain.output, 3);          // 2.5
+
+    filterReset(&chain, 0);
+    for (i = 0; i < 500; i++) {
+        history[i % 4] = testNextRandom();
+        filterProcess(&chain, history[i % 4]);
+        double mean = (history[0] + history[1] + history[2] + history[3]) / 4.0;
+        if (chain.output != testRound(mean)) {
+            break;
+        }
+    }
+    CHECK_EQ(i, 500);
+}
+
+// Reset fills every stage with the value, negative included
+static void testFilterReset(void) {
+    static const filterConfig_t config[] = {
+            {FILTER_MEDIAN, 5}, {FILTER_BOXCAR, 8}, {FILTER_EMA, 3}};
+    filterChain_t chain;
+    CHECK(filterInit(&chain, config, 3));
+
+    filterReset(&chain, -1500);
+    CHECK_EQ(chain.output, -1500);
+    CHECK(filterProcess(&chain, -1500));
+    CHECK_EQ(chain.output, -1500);
+    filterReset(&chain, 2000);
+    CHECK(filterProcess(&chain, 2000));
+    CHECK_EQ(chain.output, 2000);
+}
+
+// The EMA follows y += (x - y) / 2^k and settles on a constant
+static void testFilterEma(void) {
+    static const filterConfig_t config[] = {{FILTER_EMA, 2}};
+    filterChain_t chain;
+    double y = 0;
+    uint32_t i;
+    CHECK(filterInit(&chain, config, 1));
+
+    for (i = 0; i < 40; i++) {
+        filterProcess(&chain, 1000);
+        y += (1000 - y) / 4;
+        CHECK_NEAR(chain.output, y, 1);
+    }
+    CHECK_EQ(chain.output, 1000);
+}
+
+// A median throws out a single spike
+static void testFilterMedian(void) {
+    static const filterConfig_t config[] = {{FILTER_MEDIAN, 3}};
+    filterChain_t chain;
+    CHECK(filterInit(&chain, config, 1));
+    filterReset(&chain, 100);
+
+    filterProcess(&chain, 4000);
+    CHECK_EQ(chain.output, 100);
+    filterProcess(&chain, 101);
+    CHECK_EQ(chain.output, 101);
+}
+
+// A decimator passes on the mean of each param samples
+static void testFilterDecimate(void) {
+    static const filterConfig_t config[] = {{FILTER_DECIMATE, 4}};
+    filterChain_t chain;
+    CHECK(filterInit(&chain, config, 1));
+
+    CHECK(!filterProcess(&chain, 10));
+    CHECK(!filterProcess(&chain, 20));
+    CHECK(!filterProcess(&chain, 30));
+    CHECK(filterProcess(&chain, 40));
+    CHECK_EQ(chain.output, 25);
+    CHECK(!filterProcess(&chain, -40));
+}
+
+// The notch leaves DC alone and takes out its centre frequency
+static void testFilterNotch(void) {
+    static const filterConfig_t config[] = {{FILTER_NOTCH, 15565}};    // r = 0.95
+    const uint32_t rate = 500;
+    const uint32_t freq = 50;
+    filterChain_t chain;
+    double peak = 0;
+    uint32_t i;
+    CHECK(filterInit(&chain, config, 1));
+    filterReset(&chain, 2000);
+
+    // Bypassed until a centre is set
+    CHECK(filterProcess(&chain, 2100));
+    CHECK_EQ(chain.output, 2100);
+
+    filterSetNotch(&chain, freq << FILTER_FREQ_BITS, rate);
+    filterReset(&chain, 2000);
+    for (i = 0; i < 50; i++) {
+        filterProcess(&chain, 2000);
+    }
+    CHECK_NEAR(chain.output, 2000, 2);
+
+    for (i = 0; i < 2 * rate; i++) {
+        filterProcess(&chain, 2000 + testRound(200 * sin(2 * M_PI * freq * i / rate)));
+        if (i >= rate) {
+            double error = fabs(chain.output - 2000.0);
+            peak = (error > peak) ? error : peak;
+        }
+    }
+    CHECK(peak < 20);       // Over 20 dB down
+
+    filterSetNotch(&chain, 0, rate);
+    CHECK(chain.stages[0].bypass);
+}
+
+// After a step the notch settles on the new level at every centre
+// it tracks, not somewhere in a rounding dead band around it
+static void testFilterNotchSettles(void) {
+    static const filterConfig_t config[] = {{FILTER_NOTCH, 15565}};
+    const uint32_t rate = 500;
+    filterChain_t chain;
+    uint32_t freq;
+    CHECK(filterInit(&chain, config, 1));
+    for (freq = 5; freq <= 60; freq += 5) {
+        int32_t low = INT32_MAX, high = INT32_MIN;
+        uint32_t i;
+        filterSetNotch(&chain, freq << FILTER_FREQ_BITS, rate);
+        filterReset(&chain, 0);
+        for (i = 0; i < 4 * rate; i++) {
+            filterProcess(&chain, 2100);
+            if (i >= 3 * rate) {
+                low = (chain.output < low) ? chain.output : low;
+                high = (chain.output > high) ? chain.output : high;
+            }
+        }
+        CHECK(low >= 2099);
+        CHECK(high <= 2101);
+    }
+}
+
+// Tables that do not fit are refused
+static void testFilterInitLimits(void) {
+    static const filterConfig_t tooMany[FILTER_MAX_STAGES + 1] = {
+            {FILTER_EMA, 1}, {FILTER_EMA, 1}, {FILTER_EMA, 1}, {FILTER_EMA, 1}, {FILTER_EMA, 1}};
+    static const filterConfig_t tooLong[] = {
+            {FILTER_BOXCAR, FILTER_POOL_LENGTH}, {FILTER_MEDIAN, 3}};
+    static const filterConfig_t wideMedian[] = {{FILTER_MEDIAN, FILTER_MEDIAN_MAX + 2}};
+    static const filterConfig_t noDecimate[] = {{FILTER_DECIMATE, 0}};
+    static const filterConfig_t widest[] = {
+            {FILTER_NOTCH, 15565}, {FILTER_MEDIAN, FILTER_MEDIAN_MAX}, {FILTER_BOXCAR, FILTER_BOXCAR_MAX}};
+    filterChain_t chain;
+
+    CHECK(!filterInit(&chain, tooMany, FILTER_MAX_STAGES + 1));
+    CHECK(!filterInit(&chain, tooLong, 2));
+    CHECK(!filterInit(&chain, wideMedian, 1));
+    CHECK(!filterInit(&chain, noDecimate, 1));
+    CHECK(filterInit(&chain, tooMany, FILTER_MAX_STAGES));
+    CHECK(filterInit(&chain, widest, 3));
+}
+/*--------------------------------------------------------------*/
+
+int main(void) {
+    TEST_RUN(testFilterBoxcarSigned);
+    TEST_RUN(testFilterReset);
+    TEST_RUN(testFilterEma);
+    TEST_RUN(testFilterMedian);
+    TEST_RUN(testFilterDecimate);
+    TEST_RUN(testFilterNotch);
+    TEST_RUN(testFilterNotchSettles);
+    TEST_RUN(testFilterInitLimits);
+    return testReport("filter");
+}
@@ -0,0 +1,135 @@
+/*---------------------------------------------------------------
+               ________________
+                 _____|___
+                / |__|    \-----__|__
+                \_________/------ |
+                ____|___|____
+
+-----------------------------------------------------------------
+ ENCE 464 Group 13
+ test_limits.c
+
+ Altitude limit comparators: the duty cap, its interrupt clears
+ and lifting the cap while a new crossing comes in
+----------------------------------------------------------------*/
+
+/* Includes ----------------------------------------------------*/
+#include <string.h>
+#include "test.h"
+#include "../altitude.c"
+/*--------------------------------------------------------------*/
+
+/* Helpers -----------------------------------------------------*/
+#define TEST_GROUND_ADC     2500
+#define TEST_CEILING_ADC    (TEST_GROUND_ADC - ALT_CMP_CEILING_PCNT * ALT_ADC_SWING / 100)
+#define TEST_FLOOR_ADC      (TEST_GROUND_ADC - ALT_CMP_FLOOR_PCNT * ALT_ADC_SWING / 100)
+
+static bool testRaced;
+
+// Limits armed for TEST_GROUND_ADC with no events yet
+static void testLimitsInit(void) {
+    memset((void*) &altLimitStats, 0, sizeof(altLimitStats));
+    testRaced = false;
+    altitudeInitADC();
+    altitudeInitLimits(TEST_GROUND_ADC);
+}
+/*--------------------------------------------------------------*/
+
+/* Tests -------------------------------------------------------*/
+// Both comparators are set from the ground value on the sample timer
+static void testLimitsConfig(void) {
+    testLimitsInit();
+
+    CHECK_EQ(hostAdc[0].seq[ALTITUDE_CMP_SEQ_NUM].trigger, ALTITUDE_TIMER_TRIGGER);
+    CHECK_EQ(hostAdc[0].cmpConfig[ALTITUDE_CMP_CEILING], ADC_COMP_INT_LOW_HONCE);
+    CHECK_EQ(hostAdc[0].cmpLow[ALTITUDE_CMP_CEILING], TEST_CEILING_ADC);
+    CHECK_EQ(hostAdc[0].cmpConfig[ALTITUDE_CMP_FLOOR], ADC_COMP_INT_HIGH_HONCE);
+    CHECK_EQ(hostAdc[0].cmpHigh[ALTITUDE_CMP_FLOOR], TEST_FLOOR_ADC);
+    CHECK(hostIntEnabled[ALTITUDE_CMP_INT_GROUP]);
+    CHECK_EQ(hostIntPriority[ALTITUDE_CMP_INT_GROUP], 0);
+    CHECK_EQ(hostAdc[0].cmpStatus, 0);
+}
+
+// A ceiling crossing caps the main duty once, clears both the
+// comparator and the sequence level flag, and times the cap
+static void testLimitsCeiling(void) {
+    testLimitsInit();
+    hostTimer[0].value = hostTimer[0].load - 1234;
+
+    hostAdcCompare(ALTITUDE_ADC_BASE, ALTITUDE_CMP_SEQ_NUM, TEST_CEILING_ADC - 1);
+    CHECK_EQ(hostMainLimit, ALT_CMP_CEILING_DUTY);
+    CHECK(altitudeGetLimitStats()->capped);
+    CHECK_EQ(altitudeGetLimitStats()->ceilingEvents, 1);
+    CHECK_EQ(altitudeGetLimitStats()->lastLatency, 1234);
+    CHECK_EQ(hostAdc[0].cmpStatus, 0);
+    CHECK_EQ(hostAdc[0].intStatusEx & ALTITUDE_CMP_INT_FLAG, 0);
+
+    // Staying above the ceiling is not a new event, leaving and
+    // crossing again is
+    hostAdcCompare(ALTITUDE_ADC_BASE, ALTITUDE_CMP_SEQ_NUM, TEST_CEILING_ADC - 5);
+    CHECK_EQ(altitudeGetLimitStats()->ceilingEvents, 1);
+    hostAdcCompare(ALTITUDE_ADC_BASE, ALTITUDE_CMP_SEQ_NUM, TEST_CEILING_ADC + 5);
+    hostAdcCompare(ALTITUDE_ADC_BASE, ALTITUDE_CMP_SEQ_NUM, TEST_CEILING_ADC - 5);
+    CHECK_EQ(altitudeGetLimitStats()->ceilingEvents, 2);
+    CHECK_EQ(altitudeGetLimitStats()->floorEvents, 0);
+}
+
+// Dropping to the floor is counted and does not cap
+static void testLimitsFloor(void) {
+    testLimitsInit();
+
+    hostAdcCompare(ALTITUDE_ADC_BASE, ALTITUDE_CMP_SEQ_NUM, TEST_FLOOR_ADC + 10);
+    CHECK_EQ(altitudeGetLimitStats()->floorEvents, 1);
+    CHECK_EQ(altitudeGetLimitStats()->ceilingEvents, 0);
+    CHECK(!altitudeGetLimitStats()->capped);
+    CHECK_EQ(hostMainLimit, MAIN_MAX_DUTY);
+    CHECK_EQ(hostAdc[0].intStatusEx & ALTITUDE_CMP_INT_FLAG, 0);
+}
+
+// A new crossing while the task lifts the cap
+static void testLimitsRaceHook(uint32_t maxDuty) {
+    if (maxDuty == MAIN_MAX_DUTY && !testRaced) {
+        testRaced = true;
+        hostAdcCompare(ALTITUDE_ADC_BASE, ALTITUDE_CMP_SEQ_NUM, TEST_GROUND_ADC);
+        hostAdcCompare(ALTITUDE_ADC_BASE, ALTITUDE_CMP_SEQ_NUM, TEST_CEILING_ADC - 1);
+    }
+}
+
+// Ground samples, one ceiling crossing at 0.2s, stop after the race
+static void testLimitsRaceDelay(TickType_t now) {
+    if (now % ALT_ADC_SAMPLE_DELAY == 0) {
+        hostAdcConvert(ALTITUDE_ADC_BASE, TEST_GROUND_ADC);
+    }
+    if (now == 200) {
+        hostAdcCompare(ALTITUDE_ADC_BASE, ALTITUDE_CMP_SEQ_NUM, TEST_CEILING_ADC - 1);
+    }
+    if (testRaced || now > 1000) {
+        hostTaskExit();
+    }
+}
+
+// altitudeAvgTask lifts the cap back under the release height. A
+// crossing part way through is held off until the cap is down, so
+// it is never lost under a lifted limit.
+static void testLimitsRelease(void) {
+    testLimitsInit();
+    hostPwmLimitHook = testLimitsRaceHook;
+    hostDelayHook = testLimitsRaceDelay;
+    hostTaskRun(altitudeAvgTask, NULL);
+
+    CHECK(testRaced);
+    CHECK_EQ(altitudeGetLimitStats()->ceilingEvents, 2);
+    CHECK(altitudeGetLimitStats()->capped);
+    CHECK_EQ(hostMainLimit, ALT_CMP_CEILING_DUTY);
+    CHECK(hostIntEnabled[ALTITUDE_CMP_INT_GROUP]);
+    CHECK(hostUartSent("altCeiling 2"));
+}
+/*--------------------------------------------------------------*/
+
+int main(void) {
+    TEST_RUN(testLimitsConfig);
+    TEST_RUN(testLimitsCeiling);
+    TEST_RUN(testLimitsFloor);
+    TEST_RUN(testLimitsRelease);
+    return testReport("limits");
+}
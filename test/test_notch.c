@@ -0,0 +1,134 @@
+/*---------------------------------------------------------------
+               ________________
+                 _____|___
+                / |__|    \-----__|__
+                \_________/------ |
+                ____|___|____
+
+-----------------------------------------------------------------
+ ENCE 464 Group 13
+ test_notch.c
+
+ Rotor vibration notch following the main duty in altitudeAvgTask
+----------------------------------------------------------------*/
+
+/* Includes ----------------------------------------------------*/
+#include <math.h>
+#include "test.h"
+#include "../altitude.c"
+/*--------------------------------------------------------------*/
+
+/* Helpers -----------------------------------------------------*/
+#define TEST_ADC_AT_0       2500    // Ground reading
+#define TEST_GROUND_MS      500     // Rig on the ground for calibration
+#define TEST_VIBRATION      40      // ADC counts, 5% of the swing
+#define TEST_PHASE_MS       3000    // Each duty is held this long
+#define TEST_WINDOW_MS      1000    // and recorded over the end of it
+
+static uint32_t testDuty[2];            // Commanded duty before and after the change
+static double testVibrationFreq[2];     // Vibration (Hz) before and after the change
+static TickType_t testChangeAt;
+static TickType_t testEndAt;
+static int32_t testLow[2];              // Altitude range in each settled window
+static int32_t testHigh[2];
+static int32_t testRipple[2];           // Largest speed in each settled window
+
+// Converts the rig at 50% with the rotor shaking it, and records the
+// altitude the task sends once settled on each side of the change
+static void testNotchHook(TickType_t now) {
+    altitudeMessage_t measured;
+    uint32_t phase = (now >= testChangeAt);
+    hostMainDuty = testDuty[phase];
+
+    if (now % ALT_ADC_SAMPLE_DELAY == 0) {
+        double adc = TEST_ADC_AT_0;
+        if (now >= TEST_GROUND_MS) {
+            adc -= ALT_ADC_SWING / 2 + TEST_VIBRATION * sin(2 * M_PI * testVibrationFreq[phase] * now / 1000);
+        }
+        hostAdcConvert(ALTITUDE_ADC_BASE, (uint32_t) lround(adc));
+    }
+
+    TickType_t phaseEnd = phase ? testEndAt : testChangeAt;
+    if (now + TEST_WINDOW_MS >= phaseEnd && xQueueReceive(xMeasuredAltitudeQueue, &measured, 0) == pdPASS) {
+        testLow[phase] = (measured.altitude < testLow[phase]) ? measured.altitude : testLow[phase];
+        testHigh[phase] = (measured.altitude > testHigh[phase]) ? measured.altitude : testHigh[phase];
+        int32_t speed = abs(measured.velocity);
+        testRipple[phase] = (speed > testRipple[phase]) ? speed : testRipple[phase];
+    }
+    if (now >= testEndAt) {
+        hostTaskExit();
+    }
+}
+
+// Runs altitudeAvgTask from power on, changing the duty and vibration
+// part way
+static void testNotchRun(uint32_t duty0, double freq0, uint32_t duty1, double freq1) {
+    uint32_t i;
+    hostReset();
+    hostRtosReset();
+    hostStubsReset();
+    for (i = 0; i < 2; i++) {
+        testLow[i] = INT32_MAX;
+        testHigh[i] = INT32_MIN;
+        testRipple[i] = 0;
+    }
+    testDuty[0] = duty0;
+    testDuty[1] = duty1;
+    testVibrationFreq[0] = freq0;
+    testVibrationFreq[1] = freq1;
+    testChangeAt = TEST_GROUND_MS + TEST_PHASE_MS;
+    testEndAt = testChangeAt + TEST_PHASE_MS;
+    for (i = 0; i < ALT_ADC_COUNT; i++) {
+        altCapture[i].busy[0] = false;
+        altCapture[i].busy[1] = false;
+    }
+    altCurrentBlock.length = 0;
+    altitudeInitADC();
+    hostDelayHook = testNotchHook;
+    hostTaskRun(altitudeAvgTask, NULL);
+}
+
+// Rotor frequency (Hz) the table gives for a duty
+static double testRotorFreq(uint32_t duty) {
+    return (double) altitudeRotorFreq(duty) / (1 << FILTER_FREQ_BITS);
+}
+/*--------------------------------------------------------------*/
+
+/* Tests -------------------------------------------------------*/
+// The table is interpolated between its 10% steps, off at low duty
+static void testNotchRotorFreq(void) {
+    uint32_t duty;
+    for (duty = 0; duty <= 100; duty += 10) {
+        CHECK_EQ(altitudeRotorFreq(duty), altRotorFreqTable[duty / 10]);
+    }
+    CHECK_EQ(altitudeRotorFreq(5), 0);
+    CHECK_EQ(altitudeRotorFreq(25), (altRotorFreqTable[2] + altRotorFreqTable[3]) / 2);
+    CHECK_EQ(altitudeRotorFreq(MAIN_MAX_DUTY + 10), altRotorFreqTable[10]);
+    for (duty = 20; duty < 100; duty++) {
+        CHECK(altitudeRotorFreq(duty + 1) >= altitudeRotorFreq(duty));
+    }
+}
+
+// Vibration at the rotor frequency is taken out at both duties once
+// the notch has followed the change. With the notch bypassed, as it
+// is below 10% duty, the same vibration gets through.
+static void testNotchTracks(void) {
+    int32_t tracked[2];
+    testNotchRun(40, testRotorFreq(40), 80, testRotorFreq(80));
+    CHECK(testLow[0] >= 49 && testHigh[0] <= 51 && testLow[0] <= testHigh[0]);
+    CHECK(testLow[1] >= 49 && testHigh[1] <= 51 && testLow[1] <= testHigh[1]);
+    CHECK_EQ(altitudeGetOverruns(), 0);
+    tracked[0] = testRipple[0];
+    tracked[1] = testRipple[1];
+
+    testNotchRun(5, testRotorFreq(40), 5, testRotorFreq(80));
+    CHECK(tracked[0] < testRipple[0] / 3);
+    CHECK(tracked[1] < testRipple[1] / 3);
+}
+/*--------------------------------------------------------------*/
+
+int main(void) {
+    TEST_RUN(testNotchRotorFreq);
+    TEST_RUN(testNotchTracks);
+    return testReport("notch");
+}
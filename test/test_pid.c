@@ -0,0 +1,743 @@
+/*---------------------------------------------------------------
+               ________________
+                 _____|___
+                / |__|    \-----__|__
+                \_________/------ |
+                ____|___|____
+
+-----------------------------------------------------------------
+ ENCE 464 Group 13
+ test_pid.c
+
+ Fixed point PID kernel against the reference calculation, and the
+ controllers flown in closed loop against a simple rig model
+----------------------------------------------------------------*/
+
+/* Includes ----------------------------------------------------*/
+#include <math.h>
+#include <string.h>
+#include "test.h"
+#include "../pid.c"
+#include "plant.h"
+/*--------------------------------------------------------------*/
+
+/* Helpers -----------------------------------------------------*/
+static uint32_t testRandom = 464;
+
+// Repeatable values from lo to hi
+static int32_t testNextRandom(int32_t lo, int32_t hi) {
+    testRandom = testRandom * 1103515245 + 12345;
+    return lo + (int32_t) ((testRandom >> 8) % (uint32_t) (hi - lo + 1));
+}
+
+// Unrounded duty of the configured controller, before the limits
+static double testExactDuty(const pidHandle_t* h) {
+    const pidConfig_t* config = h->config;
+    return h->kp / 1000.0 * h->propError / (1 << config->errorBits)
+         + h->kiPeriod / 1000000.0 * h->integralError / (1 << config->errorBits)
+         + h->kd / 1000.0 * h->diffError / (1 << PID_DIFF_FRAC_BITS)
+         + config->offset + h->feedforward;
+}
+
+// Random errors within the reach of each axis, short of the limits
+static void testRandomErrors(pidHandle_t* h) {
+    do {
+        h->propError = testNextRandom(-40, 40);
+        h->integralError = testNextRandom(-h->integralMax, h->integralMax);
+        h->diffError = testNextRandom(-20 * 256, 20 * 256);
+    } while (testExactDuty(h) < h->config->minDuty + 1 || testExactDuty(h) > h->config->maxDuty - 1);
+}
+
+// Lowest and highest positions seen in a flight
+typedef struct testExtremes_t {
+    double mainMin;
+    double mainMax;
+    double tailMin;
+    double tailMax;
+} testExtremes_t;
+
+// Flies both axes for the given time (ms) as pidTask does, keeping
+// the extremes on the way if seen is given
+static void testPidFly(pidHandle_t* mainAxis, pidHandle_t* tailAxis,
+                       testPlant_t* mainPlant, testPlant_t* tailPlant,
+                       uint32_t ms, testExtremes_t* seen) {
+    uint32_t t;
+    if (seen != NULL) {
+        *seen = (testExtremes_t) {mainPlant->position, mainPlant->position,
+                                  tailPlant->position, tailPlant->position};
+    }
+    for (t = 0; t < ms; t += PID_TASK_DELAY) {
+        int16_t mainDuty;
+        int16_t tailDuty;
+        testPlantMeasure(mainPlant, mainAxis);
+        testPlantMeasure(tailPlant, tailAxis);
+        pidCalcErrors(mainAxis);
+        pidCalcErrors(tailAxis);
+        pidSchedule(mainAxis, mainAxis->current);
+        pidSchedule(tailAxis, mainAxis->current);
+        pidCalcDutyCycles(mainAxis, tailAxis, &mainDuty, &tailDuty);
+        testPlantStep(mainPlant, mainDuty, PID_TASK_DELAY);
+        testPlantStep(tailPlant, tailDuty, PID_TASK_DELAY);
+        if (seen != NULL) {
+            seen->mainMin = fmin(seen->mainMin, mainPlant->position);
+            seen->mainMax = fmax(seen->mainMax, mainPlant->position);
+            seen->tailMin = fmin(seen->tailMin, tailPlant->position);
+            seen->tailMax = fmax(seen->tailMax, tailPlant->position);
+        }
+    }
+}
+
+// pidTask flown against the plants. The rotors' torque turns the
+// body, so the tail sees testCoupling of the main duty.
+static testPlant_t testTaskMain;
+static testPlant_t testTaskTail;
+static double testCoupling;
+static uint32_t testPeriod;
+static uint32_t testPeriods;
+static void (*testScript)(uint32_t period);
+static controlTargetMessage_t testTarget;
+static double testYawWorst;         // Largest yaw error after the script starts recording
+static bool testRecording;
+static pwmUpdateMessage_t testPwm;
+
+// Sends new targets, altitude in percent and yaw in degrees
+static void testSetTarget(int32_t altitude, int32_t yaw) {
+    testTarget = (controlTargetMessage_t) {yaw, altitude};
+    xQueueSend(xControlTargetQueue, &testTarget, 0);
+}
+
+// Each task period: applies the duties sent, runs the rig for the
+// period and sends what the sensors would see
+static void testTaskHook(TickType_t now) {
+    (void) now;
+    while (xQueueReceive(xPWMQueue, &testPwm, 0) == pdPASS) {
+        hostMainDuty = testPwm.main;
+    }
+    testPlantStep(&testTaskMain, testPwm.main, PID_TASK_DELAY);
+    testPlantStep(&testTaskTail, testPwm.tail - testCoupling * testPwm.main, PID_TASK_DELAY);
+
+    altitudeMessage_t altitude = {(int32_t) lround(testTaskMain.position),
+                                  (int32_t) lround(testTaskMain.rate * (1 << ALT_FRAC_BITS))};
+    yawMessage_t yaw = {testPlantAngle(&testTaskTail),
+                        (int32_t) lround(testTaskTail.rate * (1 << PID_DIFF_FRAC_BITS))};
+    xQueueOverwrite(xMeasuredAltitudeQueue, &altitude);
+    xQueueSend(xMeasuredYawQueue, &yaw, 0);
+    if (testRecording) {
+        testYawWorst = fmax(testYawWorst, fabs(testTaskTail.position - testTarget.yaw));
+    }
+
+    if (testPeriod == testPeriods) {
+        hostTaskExit();
+    }
+    if (testScript != NULL) {
+        testScript(testPeriod);
+    }
+    testPeriod++;
+}
+
+// Runs pidTask for the given time (ms) from a landed rig, calling the
+// script once a period
+static void testPidTaskRun(uint32_t ms, void (*script)(uint32_t period)) {
+    testTaskMain = testMainPlant;
+    testTaskTail = testTailPlant;
+    testTaskTail.hover = TAIL_DUTY_OFFSET;
+    testPwm = (pwmUpdateMessage_t) {0, 0};
+    testPeriod = 0;
+    testPeriods = ms / PID_TASK_DELAY;
+    testScript = script;
+    testYawWorst = 0;
+    testRecording = false;
+    hostDelayHook = testTaskHook;
+    hostTaskRun(pidTask, NULL);
+}
+/*--------------------------------------------------------------*/
+
+/* Tests -------------------------------------------------------*/
+// The portable DSP operations give the instructions' results
+static void testPidDspOps(void) {
+    uint32_t x = PID_PACK(-3, 7);
+    uint32_t y = PID_PACK(1000, -2000);
+    CHECK_EQ(PID_SMLAD(x, y, 5), 5 - 3000 - 14000);
+    CHECK_EQ(PID_SMLABB(x, y, 5), 5 - 3000);
+    CHECK_EQ(PID_SSAT16(40000), INT16_MAX);
+    CHECK_EQ(PID_SSAT16(-40000), INT16_MIN);
+    CHECK_EQ(PID_SSAT16(-1234), -1234);
+    CHECK_EQ(PID_QADD(INT32_MAX - 1, 5), INT32_MAX);
+    CHECK_EQ(PID_QADD(INT32_MIN + 1, -5), INT32_MIN);
+    CHECK_EQ(PID_QADD(-7, 5), -2);
+}
+
+// Over random errors the kernel is within a duty of the exact
+// controller and within the PID_KERNEL_CHECK tolerance of the
+// reference, which truncates P+I and D apart
+static void testPidKernelEquivalence(void) {
+    pidHandle_t mainAxis;
+    pidHandle_t tailAxis;
+    int32_t worstExact = 0;
+    int32_t worstReference = 0;
+    uint32_t i;
+    pidInit(&mainAxis, &pidConfigs[PID_MAIN]);
+    pidInit(&tailAxis, &pidConfigs[PID_TAIL]);
+
+    for (i = 0; i < 5000; i++) {
+        int16_t mainDuty;
+        int16_t tailDuty;
+        testRandomErrors(&mainAxis);
+        testRandomErrors(&tailAxis);
+        // Within the limits the kernel leaves the integrals be
+        int32_t mainIntegral = mainAxis.integralError;
+        int32_t tailIntegral = tailAxis.integralError;
+        int16_t referenceMain = pidCalcDutyCycle(&mainAxis);
+        // The tail reference takes the feedforward the kernel will use
+        int16_t referenceTail;
+        pidCalcDutyCycles(&mainAxis, &tailAxis, &mainDuty, &tailDuty);
+        referenceTail = pidCalcDutyCycle(&tailAxis);
+        CHECK_EQ(mainAxis.integralError, mainIntegral);
+        CHECK_EQ(tailAxis.integralError, tailIntegral);
+
+        int32_t exactMain = abs(mainDuty - (int32_t) lround(testExactDuty(&mainAxis)));
+        int32_t exactTail = abs(tailDuty - (int32_t) lround(testExactDuty(&tailAxis)));
+        if (exactMain > worstExact) {worstExact = exactMain;}
+        if (exactTail > worstExact) {worstExact = exactTail;}
+        if (abs(mainDuty - referenceMain) > worstReference) {worstReference = abs(mainDuty - referenceMain);}
+        if (abs(tailDuty - referenceTail) > worstReference) {worstReference = abs(tailDuty - referenceTail);}
+    }
+    CHECK(worstExact <= 1);
+    CHECK(worstReference <= 2);
+}
+
+// Over the limits the kernel clamps like the reference and winds the
+// integral back by windupGain of the excess
+static void testPidKernelLimits(void) {
+    pidHandle_t mainAxis;
+    pidHandle_t tailAxis;
+    int16_t mainDuty;
+    int16_t tailDuty;
+    pidInit(&mainAxis, &pidConfigs[PID_MAIN]);
+    pidInit(&tailAxis, &pidConfigs[PID_TAIL]);
+
+    mainAxis.propError = 100;
+    mainAxis.integralError = 0;
+    mainAxis.diffError = -1500 * 256;
+    tailAxis.propError = -100;
+    tailAxis.integralError = 0;
+    double overMain = testExactDuty(&mainAxis) - MAIN_MAX_DUTY;
+    double overTail = TAIL_MIN_DUTY - testExactDuty(&tailAxis);
+    CHECK(overMain > 0);
+    CHECK(overTail > 0);
+    CHECK_EQ(pidCalcDutyCycle(&mainAxis), MAIN_MAX_DUTY);
+    CHECK_EQ(pidCalcDutyCycle(&tailAxis), TAIL_MIN_DUTY);
+
+    pidCalcDutyCycles(&mainAxis, &tailAxis, &mainDuty, &tailDuty);
+    CHECK_EQ(mainDuty, MAIN_MAX_DUTY);
+    CHECK_EQ(tailDuty, TAIL_MIN_DUTY);
+    CHECK_EQ(mainAxis.duty, MAIN_MAX_DUTY);
+    // The integral's share of the output falls by windupGain of the excess
+    double windMain = mainAxis.integralError * mainAxis.kiPeriod / 1000000.0;
+    double windTail = tailAxis.integralError * tailAxis.kiPeriod / 1000000.0;
+    CHECK_NEAR(windMain, -overMain * MAIN_WINDUP_GAIN / 1000.0, 0.05);
+    CHECK_NEAR(windTail, overTail * TAIL_WINDUP_GAIN / 1000.0, 0.05);
+}
+
+// A step in altitude and in yaw from hover settles with the
+// overshoot the tuning gives, the main from the ground first
+static void testPidStepResponse(void) {
+    pidHandle_t mainAxis;
+    pidHandle_t tailAxis;
+    testPlant_t mainPlant = testMainPlant;
+    testPlant_t tailPlant = testTailPlant;
+    testExtremes_t seen;
+    pidInit(&mainAxis, &pidConfigs[PID_MAIN]);
+    pidInit(&tailAxis, &pidConfigs[PID_TAIL]);
+
+    mainAxis.target = 30;
+    testPidFly(&mainAxis, &tailAxis, &mainPlant, &tailPlant, 30000, &seen);
+    CHECK_NEAR(mainPlant.position, 30, 1.5);
+    CHECK_NEAR(tailPlant.position, 0, 1.5);
+
+    mainAxis.target = 60;
+    tailAxis.target = yawDegToBam(45);
+    testPidFly(&mainAxis, &tailAxis, &mainPlant, &tailPlant, 20000, &seen);
+    CHECK_NEAR(mainPlant.position, 60, 1.5);
+    CHECK_NEAR(tailPlant.position, 45, 1.5);
+    CHECK(seen.mainMax < 60 + 30 * 0.3);
+    CHECK(seen.tailMax < 45 + 45 * 0.3);
+    CHECK(seen.mainMin > 30 - 1.5);
+    CHECK(seen.tailMin > -1.5);
+}
+
+// Held up with the output at its lower limit, back-calculation keeps
+// the integral from winding down, so once let go the output comes off
+// the limit sooner than with no anti-windup
+static void testPidAntiWindup(void) {
+    pidConfig_t noWindup = pidConfigs[PID_MAIN];
+    uint32_t recovery[2];
+    int32_t integrals[2];
+    uint32_t run;
+    noWindup.windupGain = 0;
+
+    for (run = 0; run < 2; run++) {
+        pidHandle_t mainAxis;
+        pidHandle_t tailAxis;
+        testPlant_t mainPlant = testMainPlant;
+        testPlant_t tailPlant = testTailPlant;
+        pidInit(&mainAxis, (run == 0) ? &pidConfigs[PID_MAIN] : &noWindup);
+        pidInit(&tailAxis, &pidConfigs[PID_TAIL]);
+        mainAxis.target = 80;
+        testPidFly(&mainAxis, &tailAxis, &mainPlant, &tailPlant, 30000, NULL);
+        // Held where it is, the rotor has no effect
+        mainPlant.gain = 0;
+        mainPlant.rate = 0;
+        mainAxis.target = 50;
+        testPidFly(&mainAxis, &tailAxis, &mainPlant, &tailPlant, 20000, NULL);
+        CHECK_EQ(mainAxis.duty, MAIN_MIN_DUTY);
+        CHECK(abs(mainAxis.integralError) <= mainAxis.integralMax);
+        integrals[run] = mainAxis.integralError;
+        // Let go, periods until the output leaves the limit
+        mainPlant.gain = testMainPlant.gain;
+        recovery[run] = 0;
+        while (mainAxis.duty == MAIN_MIN_DUTY && recovery[run] < 1000) {
+            testPidFly(&mainAxis, &tailAxis, &mainPlant, &tailPlant, PID_TASK_DELAY, NULL);
+            recovery[run]++;
+        }
+        testPidFly(&mainAxis, &tailAxis, &mainPlant, &tailPlant, 30000, NULL);
+        CHECK_NEAR(mainPlant.position, 50, 1.5);
+    }
+    CHECK(integrals[0] > integrals[1]);
+    CHECK(recovery[0] <= 5);
+    CHECK(recovery[0] * 2 < recovery[1]);
+}
+
+// The derivative is on the measurement, so a target step moves the
+// output by the P and I terms only
+static void testPidNoDerivativeKick(void) {
+    pidHandle_t mainAxis;
+    pidHandle_t tailAxis;
+    testPlant_t mainPlant = testMainPlant;
+    testPlant_t tailPlant = testTailPlant;
+    int16_t mainDuty;
+    int16_t tailDuty;
+    pidInit(&mainAxis, &pidConfigs[PID_MAIN]);
+    pidInit(&tailAxis, &pidConfigs[PID_TAIL]);
+    mainAxis.target = 30;
+    testPidFly(&mainAxis, &tailAxis, &mainPlant, &tailPlant, 30000, NULL);
+
+    // Hold the rig still and step the yaw target
+    mainPlant.rate = 0;
+    tailPlant.rate = 0;
+    testPlantMeasure(&mainPlant, &mainAxis);
+    testPlantMeasure(&tailPlant, &tailAxis);
+    pidCalcErrors(&mainAxis);
+    pidCalcErrors(&tailAxis);
+    pidCalcDutyCycles(&mainAxis, &tailAxis, &mainDuty, &tailDuty);
+    int32_t diffBefore = tailAxis.diffError;
+    double before = testExactDuty(&tailAxis);
+
+    tailAxis.target = yawDegToBam(30);
+    pidCalcErrors(&mainAxis);
+    pidCalcErrors(&tailAxis);
+    CHECK_EQ(tailAxis.diffError, diffBefore);
+    double step = TAIL_PROP_GAIN * 30 / 1000.0 + tailAxis.kiPeriod * 30 / 1000000.0;
+    CHECK_NEAR(testExactDuty(&tailAxis) - before, step, 0.2);
+}
+
+// Setpoint weighting gives P its share of a target step, and each
+// axis keeps to its own output limits
+static void testPidWeightAndLimits(void) {
+    pidConfig_t weighted = pidConfigs[PID_MAIN];
+    pidHandle_t mainAxis;
+    pidHandle_t tailAxis;
+    int16_t mainDuty;
+    int16_t tailDuty;
+    weighted.setpointWeight = 500;
+    pidInit(&mainAxis, &weighted);
+    pidInit(&tailAxis, &pidConfigs[PID_TAIL]);
+
+    mainAxis.current = 30;
+    mainAxis.prevCurrent = 30;
+    mainAxis.target = 30;
+    pidCalcErrors(&mainAxis);
+    int32_t propBefore = mainAxis.propError;
+    mainAxis.target = 50;
+    pidCalcErrors(&mainAxis);
+    CHECK_EQ(mainAxis.propError - propBefore, 10);
+    CHECK_EQ(mainAxis.error, 20 << PID_DIFF_FRAC_BITS);
+
+    tailAxis.target = yawDegToBam(170);
+    pidCalcErrors(&tailAxis);
+    tailAxis.integralError = tailAxis.integralMax;
+    pidCalcDutyCycles(&mainAxis, &tailAxis, &mainDuty, &tailDuty);
+    CHECK_EQ(tailDuty, TAIL_MAX_DUTY);
+    CHECK(TAIL_MAX_DUTY < MAIN_MAX_DUTY);
+}
+
+// Main gains rising over the span, to see the schedule move
+static const pidGains_t testSchedule[PID_SCHEDULE_POINTS] = {
+    {100, 4, -20}, {150, 5, -40}, {200, 6, -60}, {250, 7, -80}, {300, 8, -100}};
+
+// The gains follow the schedule, interpolated between breakpoints and
+// held at the ends, unless they were set at runtime
+static void testPidScheduleGains(void) {
+    pidConfig_t scheduled = pidConfigs[PID_MAIN];
+    pidHandle_t h;
+    scheduled.schedule = testSchedule;
+    pidInit(&h, &scheduled);
+
+    pidSchedule(&h, 0);
+    CHECK_EQ(h.kp, 100);
+    CHECK_EQ(h.ki, 4);
+    CHECK_EQ(h.kd, -20);
+    pidSchedule(&h, PID_SCHEDULE_STEP + PID_SCHEDULE_STEP * 2 / 5);
+    CHECK_EQ(h.kp, 170);
+    CHECK_EQ(h.kd, -48);
+    pidSchedule(&h, PID_SCHEDULE_SPAN);
+    CHECK_EQ(h.kp, 300);
+    CHECK_EQ(h.ki, 8);
+    CHECK_EQ(h.kd, -100);
+    pidSchedule(&h, PID_SCHEDULE_SPAN + 50);
+    CHECK_EQ(h.kp, 300);
+    pidSchedule(&h, -10);
+    CHECK_EQ(h.kp, 100);
+    CHECK_EQ(h.kiPeriod, 4 * 1000);
+
+    h.fixedGains = true;
+    pidSchedule(&h, PID_SCHEDULE_SPAN);
+    CHECK_EQ(h.kp, 100);
+}
+
+// Moving along the schedule, and any other transfer, leaves the
+// output where it was
+static void testPidScheduleBumpless(void) {
+    pidConfig_t scheduled = pidConfigs[PID_MAIN];
+    pidHandle_t h;
+    int32_t index;
+    double worst = 0;
+    scheduled.schedule = testSchedule;
+    pidInit(&h, &scheduled);
+    pidSchedule(&h, 0);
+
+    h.propError = 12;
+    h.integralError = 1500;
+    h.diffError = -3 * 256;
+    double start = testExactDuty(&h);
+    for (index = 0; index <= PID_SCHEDULE_SPAN; index++) {
+        double before = testExactDuty(&h);
+        pidSchedule(&h, index);
+        worst = fmax(worst, fabs(testExactDuty(&h) - before));
+    }
+    CHECK_EQ(h.kp, 300);
+    CHECK(worst < 0.02);
+    CHECK_NEAR(testExactDuty(&h), start, 0.1);
+
+    // Down again with the derivative the other way
+    h.propError = -7;
+    h.diffError = 5 * 256;
+    start = testExactDuty(&h);
+    int16_t before = pidCalcDutyCycle(&h);
+    pidTransfer(&h, 120, 3, -10);
+    CHECK_NEAR(testExactDuty(&h), start, 0.02);
+    CHECK(abs(pidCalcDutyCycle(&h) - before) <= 1);
+}
+
+// Takes off to 30%, then steps between 20% and 70% from 30 s,
+// recording the yaw error through the steps
+static void testFeedforwardScript(uint32_t period) {
+    const uint32_t perSecond = 1000 / PID_TASK_DELAY;
+    if (period == 0) {
+        testSetTarget(30, 0);
+    } else if (period == 30 * perSecond) {
+        testRecording = true;
+        testSetTarget(70, 0);
+    } else if (period == 40 * perSecond) {
+        testSetTarget(20, 0);
+    } else if (period == 50 * perSecond) {
+        testSetTarget(70, 0);
+    }
+}
+
+// With the gain matched to the rig the feedforward takes most of the
+// yaw excursion out of altitude steps
+static void testPidFeedforward(void) {
+    double worst[2];
+    uint32_t run;
+    testCoupling = 0.3;
+    for (run = 0; run < 2; run++) {
+        pidTorqueQ = (run == 0) ? 0 : (int32_t) lround(testCoupling * (1 << PID_GAIN_BITS));
+        testPidTaskRun(60000, testFeedforwardScript);
+        CHECK_NEAR(testTaskMain.position, 70, 1.5);
+        CHECK_NEAR(testTaskTail.position, 0, 1.5);
+        worst[run] = testYawWorst;
+    }
+    CHECK(worst[1] * 3 < worst[0]);
+    pidTorqueQ = 0;
+}
+
+static bool testCancel;
+
+// Hovers at three altitudes while calibrating, then stops or cancels
+static void testCalibrateScript(uint32_t period) {
+    const uint32_t perSecond = 1000 / PID_TASK_DELAY;
+    if (period == 0) {
+        testSetTarget(30, 0);
+    } else if (period == 20 * perSecond) {
+        pidTorqueCalibrate(true);
+    } else if (period == 30 * perSecond) {
+        testSetTarget(60, 0);
+    } else if (period == 45 * perSecond) {
+        testSetTarget(45, 0);
+    } else if (period == 60 * perSecond) {
+        testRecording = true;
+        hostUartClear();
+        if (testCancel) {
+            pidTorqueCalibrateCancel();
+        } else {
+            pidTorqueCalibrate(false);
+        }
+    }
+}
+
+// Calibration learns the rig's coupling and takes it up without a
+// yaw kick, and a cancelled calibration keeps the gain there was
+static void testPidCalibrate(void) {
+    testCoupling = 0.3;
+    pidTorqueQ = 0;
+    testCancel = false;
+    testPidTaskRun(70000, testCalibrateScript);
+    CHECK(hostUartSent("pidFF cal "));
+    CHECK_NEAR(pidGetTorqueGain(), 300, 15);
+    // The tail takes the new gain without a kick
+    CHECK(testYawWorst < 2);
+
+    int32_t gain = pidGetTorqueGain();
+    testCoupling = 0.1;
+    testCancel = true;
+    testPidTaskRun(62000, testCalibrateScript);
+    CHECK(hostUartSent("pidFF cal cancelled"));
+    CHECK_EQ(pidGetTorqueGain(), gain);
+    pidTorqueQ = 0;
+    pidTorqueRequest = PID_CAL_STOP;
+}
+
+// The relay switches with hysteresis and times whole oscillations
+// once the first PID_AT_SKIP_CYCLES have settled
+static void testPidRelayStep(void) {
+    pidHandle_t h;
+    pidRelay_t relay;
+    uint32_t t;
+    pidInit(&h, &pidConfigs[PID_MAIN]);
+    h.integralError = 1234;
+    pidRelayStart(&relay, &h, 40, 8, 1);
+    CHECK_EQ(relay.savedIntegral, 1234);
+
+    CHECK_EQ(pidRelayStep(&relay, 0), 48);
+    CHECK_EQ(pidRelayStep(&relay, -200), 48);
+    CHECK_EQ(pidRelayStep(&relay, -300), 32);
+    CHECK_EQ(pidRelayStep(&relay, 200), 32);
+    CHECK_EQ(pidRelayStep(&relay, 300), 48);
+
+    // A steady oscillation of 20 periods and 3% either side
+    pidRelayStart(&relay, &h, 40, 8, 1);
+    for (t = 0; t < 20 * (PID_AT_SKIP_CYCLES + PID_AT_CYCLES + 2); t++) {
+        pidRelayStep(&relay, (int32_t) lround(768 * sin(2 * M_PI * t / 20)));
+    }
+    CHECK_EQ(relay.cycles, PID_AT_SKIP_CYCLES + PID_AT_CYCLES);
+    CHECK_EQ(relay.periodSum, 20 * PID_AT_CYCLES);
+    CHECK_NEAR(relay.amplitudeSum / (double) PID_AT_CYCLES, 768, 8);
+}
+
+// Gains from a known relay record by the tuning rule, kd with the
+// sign of the hand tuned gains, reported over UART
+static void testPidRelayTune(void) {
+    const int32_t* rule = pidTuneRules[PID_AUTOTUNE_RULE];
+    pidRelay_t relay = {0};
+    pidGains_t gains;
+    relay.amplitude = 2;
+    relay.amplitudeSum = PID_AT_CYCLES * (16 << PID_DIFF_FRAC_BITS);
+    relay.periodSum = PID_AT_CYCLES * 25;
+    CHECK(pidRelayTune(&relay, "main", &gains));
+
+    double ku = 4 * 2 * 1000 / (M_PI * 16);
+    double tu = 25 * PID_LOOP_DELAY;
+    double kp = rule[0] / 1000.0 * ku;
+    CHECK_NEAR(gains.kp, kp, 2);
+    CHECK_NEAR(gains.ki, kp * PID_TASK_DELAY / (rule[1] / 1000.0 * tu), 2);
+    CHECK_NEAR(gains.kd, -kp * (rule[2] / 1000.0 * tu) / PID_TASK_DELAY, 2);
+    CHECK(gains.kd < 0);
+    CHECK(hostUartSent("pidAT main Ku 159 Tu 1000ms"));
+    CHECK(hostUartSent("pidAT main kp "));
+
+    // Held inside what the kernel takes
+    relay.amplitude = 50;
+    relay.amplitudeSum = PID_AT_CYCLES * 64;
+    CHECK(pidRelayTune(&relay, "tail", &gains));
+    CHECK_EQ(gains.kp, 999);
+    CHECK_EQ(gains.kd, -999);
+
+    // Nothing to go on
+    relay.amplitudeSum = 0;
+    CHECK(!pidRelayTune(&relay, "tail", &gains));
+    relay.amplitudeSum = 64;
+    relay.periodSum = 0;
+    CHECK(!pidRelayTune(&relay, "tail", &gains));
+}
+
+// The relay holds the main output, and the tail feedforward is worked
+// out from the duty held rather than the kernel's
+static void testPidHoldFeedforward(void) {
+    pidHandle_t mainAxis;
+    pidHandle_t tailAxis;
+    int16_t mainDuty;
+    int16_t tailDuty;
+    pidInit(&mainAxis, &pidConfigs[PID_MAIN]);
+    pidInit(&tailAxis, &pidConfigs[PID_TAIL]);
+    pidTorqueQ = 1 << (PID_GAIN_BITS - 1);
+    mainAxis.hold = true;
+    mainAxis.holdDuty = 60;
+    pidCalcDutyCycles(&mainAxis, &tailAxis, &mainDuty, &tailDuty);
+    CHECK_EQ(mainDuty, 60);
+    CHECK_EQ(tailAxis.feedforward, 30);
+    CHECK_EQ(tailDuty, TAIL_DUTY_OFFSET + 30);
+    pidTorqueQ = 0;
+}
+
+static enum pidTuneStates testTuneStates[3];
+
+// Hovers at 50%, then runs the autotune to the end and back to idle
+static void testAutotuneScript(uint32_t period) {
+    const uint32_t perSecond = 1000 / PID_TASK_DELAY;
+    if (period == 0) {
+        testSetTarget(50, 0);
+    } else if (period == 20 * perSecond) {
+        hostUartClear();
+        pidAutotune(true);
+        testTuneStates[0] = pidGetAutotuneState();
+    } else if (period > 20 * perSecond && testTuneStates[1] == PID_AT_IDLE &&
+               pidGetAutotuneState() != PID_AT_RUNNING) {
+        testTuneStates[1] = pidGetAutotuneState();
+        pidAutotune(false);
+        testPeriods = period + 10 * perSecond;
+    }
+}
+
+// Runs the relay on each axis in turn against the rig and reports the
+// gains, then flies on where it was
+static void testPidAutotune(void) {
+    uint32_t axis;
+    testCoupling = 0;
+    testTuneStates[1] = PID_AT_IDLE;
+    testPidTaskRun(120000, testAutotuneScript);
+    CHECK_EQ(testTuneStates[0], PID_AT_RUNNING);
+    CHECK_EQ(testTuneStates[1], PID_AT_DONE);
+    CHECK(!hostUartSent("pidAT abort"));
+    for (axis = 0; axis < 2; axis++) {
+        const char* line = strstr(hostUartLog, (axis == 0) ? "pidAT main kp" : "pidAT tail kp");
+        int kp = 0;
+        int ki = 0;
+        int kd = 0;
+        CHECK(line != NULL && sscanf(line + 11, "kp %d ki %d kd %d", &kp, &ki, &kd) == 3);
+        CHECK(kp > 0 && kp <= 999);
+        CHECK(ki > 0 && ki < kp);
+        CHECK(kd < 0 && kd >= -999);
+    }
+    CHECK_NEAR(testTaskMain.position, 50, 1.5);
+    CHECK_NEAR(testTaskTail.position, 0, 2);
+}
+
+// Hovers at 50%, starts the autotune and drops the request part way
+static void testAbortScript(uint32_t period) {
+    const uint32_t perSecond = 1000 / PID_TASK_DELAY;
+    if (period == 0) {
+        testSetTarget(50, 0);
+    } else if (period == 20 * perSecond) {
+        hostUartClear();
+        pidAutotune(true);
+    } else if (period == 22 * perSecond) {
+        pidAutotune(false);
+    } else if (period == 23 * perSecond) {
+        testTuneStates[0] = pidGetAutotuneState();
+        // A new request is running at once, not the last run's result
+        pidAutotune(true);
+        testTuneStates[1] = pidGetAutotuneState();
+        pidAutotune(false);
+    }
+}
+
+// A dropped request aborts the relay and the loop flies on from the
+// integral it had
+static void testPidAutotuneAbort(void) {
+    testCoupling = 0;
+    testPidTaskRun(40000, testAbortScript);
+    CHECK_EQ(testTuneStates[0], PID_AT_ABORTED);
+    CHECK_EQ(testTuneStates[1], PID_AT_RUNNING);
+    CHECK(hostUartSent("pidAT abort"));
+    CHECK_NEAR(testTaskMain.position, 50, 1.5);
+}
+
+// Cycles after its tick edge each period wakes, the first apart. The
+// cycle counter starts near the top so it wraps during the run.
+#define TEST_CYCLES_PER_TICK    (configCPU_CLOCK_HZ / configTICK_RATE_HZ)
+static uint32_t testFirstWake;
+static uint32_t testWake;
+static void testJitterScript(uint32_t period) {
+    uint32_t wake = (period == 0) ? testFirstWake : testWake;
+    HWREG(CORE_ST_RELOAD) = TEST_CYCLES_PER_TICK - 1;
+    HWREG(CORE_ST_CURRENT) = TEST_CYCLES_PER_TICK - 1 - wake;
+    HWREG(CORE_DWT_CYCCNT) = 0xfff00000 + xTaskGetTickCount() * TEST_CYCLES_PER_TICK + wake;
+}
+
+// Release jitter is timed from each period's tick edge, so steady
+// wake-ups report steady jitter and a late first one does not turn
+// the earlier wake-ups after it negative
+static void testPidJitter(void) {
+    testFirstWake = 40;
+    testWake = 40;
+    memset(&pidTiming, 0, sizeof(pidTiming));
+    testPidTaskRun(2000, testJitterScript);
+    CHECK(pidTiming.cycles > 0);
+    CHECK_EQ(pidTiming.jitterMin, 40);
+    CHECK_EQ(pidTiming.jitterMax, 40);
+    CHECK_EQ(pidTiming.jitterSum, 40ULL * pidTiming.cycles);
+    CHECK_EQ(pidTiming.misses, 0);
+    CHECK(hostUartSent("pidT 0/0/0 0us 0miss"));
+
+    testFirstWake = 5000;
+    memset(&pidTiming, 0, sizeof(pidTiming));
+    hostUartClear();
+    testPidTaskRun(2000, testJitterScript);
+    CHECK_EQ(pidTiming.jitterMin, 40);
+    CHECK_EQ(pidTiming.jitterMax, 5000);
+    CHECK_EQ(pidTiming.misses, 0);
+    CHECK(hostUartSent("/62 62us 0miss"));
+}
+
+// Every report carries the encoder integrity counters with the loop
+// telemetry, not only when a fault trips
+static void testPidTelemetry(void) {
+    testPidTaskRun(PID_REPORT_DIVIDER * PID_LOOP_DELAY * 3, NULL);
+    CHECK(hostUartSent("Alt: "));
+    CHECK(hostUartSent("pidT "));
+    CHECK(hostUartSent("yawInt 0 ill 0 rep 0 max 0 flt\r\n"));
+}
+/*--------------------------------------------------------------*/
+
+int main(void) {
+    TEST_RUN(testPidDspOps);
+    TEST_RUN(testPidKernelEquivalence);
+    TEST_RUN(testPidKernelLimits);
+    TEST_RUN(testPidStepResponse);
+    TEST_RUN(testPidAntiWindup);
+    TEST_RUN(testPidNoDerivativeKick);
+    TEST_RUN(testPidWeightAndLimits);
+    TEST_RUN(testPidScheduleGains);
+    TEST_RUN(testPidScheduleBumpless);
+    TEST_RUN(testPidFeedforward);
+    TEST_RUN(testPidCalibrate);
+    TEST_RUN(testPidRelayStep);
+    TEST_RUN(testPidRelayTune);
+    TEST_RUN(testPidHoldFeedforward);
+    TEST_RUN(testPidAutotune);
+    TEST_RUN(testPidAutotuneAbort);
+    TEST_RUN(testPidJitter);
+    TEST_RUN(testPidTelemetry);
+    return testReport("pid");
+}
@@ -0,0 +1,176 @@
+/*---------------------------------------------------------------
+               ________________
+                 _____|___
+                / |__|    \-----__|__
+                \_________/------ |
+                ____|___|____
+
+-----------------------------------------------------------------
+ ENCE 464 Group 13
+ test_pidFloat.c
+
+ Single precision PID kernel (PID_USE_FLOAT)
+----------------------------------------------------------------*/
+
+/* Includes ----------------------------------------------------*/
+#include <math.h>
+#include "test.h"
+// Build the float kernel in place of the fixed point one
+#define PID_USE_FLOAT 1
+#include "../pid.c"
+#include "plant.h"
+/*--------------------------------------------------------------*/
+
+/* Helpers -----------------------------------------------------*/
+static uint32_t testRandom = 2020;
+
+// Repeatable values from lo to hi
+static int32_t testNextRandom(int32_t lo, int32_t hi) {
+    testRandom = testRandom * 1103515245 + 12345;
+    return lo + (int32_t) ((testRandom >> 8) % (uint32_t) (hi - lo + 1));
+}
+
+// Unrounded duty of the configured controller, P on the weighted
+// error with its fraction
+static double testExactDuty(const pidHandle_t* h) {
+    const pidConfig_t* config = h->config;
+    return h->kp / 1000.0 * h->weightedError / (1 << PID_DIFF_FRAC_BITS)
+         + h->kiPeriod / 1000000.0 * h->integralError / (1 << config->errorBits)
+         + h->kd / 1000.0 * h->diffError / (1 << PID_DIFF_FRAC_BITS)
+         + config->offset + h->feedforward;
+}
+
+// Sets the weighted error, and the propError pidCalcErrors rounds from it
+static void testSetError(pidHandle_t* h, int32_t weightedError) {
+    const int32_t shift = PID_DIFF_FRAC_BITS - h->config->errorBits;
+    h->weightedError = weightedError;
+    h->propError = (weightedError + (1 << (shift - 1))) >> shift;
+}
+
+// Random errors within the reach of each axis, short of the limits
+static void testRandomErrors(pidHandle_t* h) {
+    do {
+        testSetError(h, testNextRandom(-40 * 256, 40 * 256));
+        h->integralError = testNextRandom(-h->integralMax, h->integralMax);
+        h->diffError = testNextRandom(-20 * 256, 20 * 256);
+    } while (testExactDuty(h) < h->config->minDuty + 1 || testExactDuty(h) > h->config->maxDuty - 1);
+}
+/*--------------------------------------------------------------*/
+
+/* Tests -------------------------------------------------------*/
+// Over random errors the float kernel rounds the exact controller,
+// and leaves the integrals be within the limits
+static void testPidFloatExact(void) {
+    pidHandle_t mainAxis;
+    pidHandle_t tailAxis;
+    int32_t worst = 0;
+    uint32_t i;
+    pidInit(&mainAxis, &pidConfigs[PID_MAIN]);
+    pidInit(&tailAxis, &pidConfigs[PID_TAIL]);
+
+    for (i = 0; i < 5000; i++) {
+        int16_t mainDuty;
+        int16_t tailDuty;
+        testRandomErrors(&mainAxis);
+        testRandomErrors(&tailAxis);
+        int32_t mainIntegral = mainAxis.integralError;
+        int32_t tailIntegral = tailAxis.integralError;
+        pidCalcDutyCycles(&mainAxis, &tailAxis, &mainDuty, &tailDuty);
+        CHECK_EQ(mainAxis.integralError, mainIntegral);
+        CHECK_EQ(tailAxis.integralError, tailIntegral);
+
+        int32_t exactMain = abs(mainDuty - (int32_t) lround(testExactDuty(&mainAxis)));
+        int32_t exactTail = abs(tailDuty - (int32_t) lround(testExactDuty(&tailAxis)));
+        if (exactMain > worst) {worst = exactMain;}
+        if (exactTail > worst) {worst = exactTail;}
+    }
+    CHECK(worst <= 1);
+}
+
+// P follows the fraction of the error, not the rounded propError
+static void testPidFloatFraction(void) {
+    pidHandle_t tailAxis;
+    int32_t lastDuty = INT32_MIN;
+    int32_t steps = 0;
+    int32_t error;
+    pidInit(&tailAxis, &pidConfigs[PID_TAIL]);
+    tailAxis.integralError = 0;
+    tailAxis.diffError = 0;
+
+    // One unit of propError, swept an LSB of the weighted error at a time
+    for (error = 0; error < (1 << PID_DIFF_FRAC_BITS); error++) {
+        testSetError(&tailAxis, 10 * (1 << PID_DIFF_FRAC_BITS) + error);
+        int32_t duty = pidKernelAxis(&tailAxis);
+        CHECK_NEAR(duty, testExactDuty(&tailAxis), 0.5 + 1e-3);
+        if (lastDuty != INT32_MIN && duty != lastDuty) {
+            steps++;
+        }
+        lastDuty = duty;
+    }
+    CHECK(steps >= (int32_t) (TAIL_PROP_GAIN / 1000) - 1);
+}
+
+// Over the limits the float kernel clamps and winds the integral back
+// by windupGain of the excess, as the fixed one does
+static void testPidFloatLimits(void) {
+    pidHandle_t mainAxis;
+    pidHandle_t tailAxis;
+    int16_t mainDuty;
+    int16_t tailDuty;
+    pidInit(&mainAxis, &pidConfigs[PID_MAIN]);
+    pidInit(&tailAxis, &pidConfigs[PID_TAIL]);
+
+    testSetError(&mainAxis, 100 * 256);
+    mainAxis.integralError = 0;
+    mainAxis.diffError = -1500 * 256;
+    testSetError(&tailAxis, -100 * 256);
+    tailAxis.integralError = 0;
+    double overMain = testExactDuty(&mainAxis) - MAIN_MAX_DUTY;
+    double overTail = TAIL_MIN_DUTY - testExactDuty(&tailAxis);
+    CHECK(overMain > 0);
+    CHECK(overTail > 0);
+
+    pidCalcDutyCycles(&mainAxis, &tailAxis, &mainDuty, &tailDuty);
+    CHECK_EQ(mainDuty, MAIN_MAX_DUTY);
+    CHECK_EQ(tailDuty, TAIL_MIN_DUTY);
+    double windMain = mainAxis.integralError * mainAxis.kiPeriod / 1000000.0;
+    double windTail = tailAxis.integralError * tailAxis.kiPeriod / 1000000.0;
+    CHECK_NEAR(windMain, -overMain * MAIN_WINDUP_GAIN / 1000.0, 0.05);
+    CHECK_NEAR(windTail, overTail * TAIL_WINDUP_GAIN / 1000.0, 0.05);
+}
+
+// The float build flies the same steps as the fixed one
+static void testPidFloatStep(void) {
+    pidHandle_t mainAxis;
+    pidHandle_t tailAxis;
+    testPlant_t mainPlant = testMainPlant;
+    testPlant_t tailPlant = testTailPlant;
+    uint32_t t;
+    pidInit(&mainAxis, &pidConfigs[PID_MAIN]);
+    pidInit(&tailAxis, &pidConfigs[PID_TAIL]);
+
+    mainAxis.target = 60;
+    tailAxis.target = yawDegToBam(45);
+    for (t = 0; t < 40000; t += PID_TASK_DELAY) {
+        int16_t mainDuty;
+        int16_t tailDuty;
+        testPlantMeasure(&mainPlant, &mainAxis);
+        testPlantMeasure(&tailPlant, &tailAxis);
+        pidCalcErrors(&mainAxis);
+        pidCalcErrors(&tailAxis);
+        pidCalcDutyCycles(&mainAxis, &tailAxis, &mainDuty, &tailDuty);
+        testPlantStep(&mainPlant, mainDuty, PID_TASK_DELAY);
+        testPlantStep(&tailPlant, tailDuty, PID_TASK_DELAY);
+    }
+    CHECK_NEAR(mainPlant.position, 60, 1.5);
+    CHECK_NEAR(tailPlant.position, 45, 1.5);
+}
+/*--------------------------------------------------------------*/
+
+int main(void) {
+    TEST_RUN(testPidFloatExact);
+    TEST_RUN(testPidFloatFraction);
+    TEST_RUN(testPidFloatLimits);
+    TEST_RUN(testPidFloatStep);
+    return testReport("pidFloat");
+}
@@ -0,0 +1,127 @@
+/*---------------------------------------------------------------
+               ________________
+                 _____|___
+                / |__|    \-----__|__
+                \_________/------ |
+                ____|___|____
+
+-----------------------------------------------------------------
+ ENCE 464 Group 13
+ test_qei.c
+
+ Yaw decoding in the QEI peripheral (YAW_USE_QEI): pins, set up,
+ and the angle and rate the yaw task sends
+----------------------------------------------------------------*/
+
+/* Includes ----------------------------------------------------*/
+#include "test.h"
+#include "FreeRTOS.h"
+#include "queue.h"
+#include "semphr.h"
+#include "../yaw.h"
+#undef YAW_USE_QEI
+#define YAW_USE_QEI 1
+#include "../yaw.c"
+/*--------------------------------------------------------------*/
+
+/* Helpers -----------------------------------------------------*/
+#define TEST_GPIO_C     2
+#define TEST_GPIO_D     3
+
+static int32_t testEdgesPerPeriod;
+static uint32_t testPeriodsLeft;
+static yawMessage_t testLatest;
+
+// Turns the encoder each yaw period and keeps the latest message.
+// Stops one period after the last move, once it has been sent.
+static void testQeiHook(TickType_t now) {
+    yawMessage_t measured;
+    (void) now;
+    while (xQueueReceive(xMeasuredYawQueue, &measured, 0) == pdPASS) {
+        testLatest = measured;
+    }
+    if (testPeriodsLeft == 0) {
+        hostTaskExit();
+    }
+    hostQeiMove(testEdgesPerPeriod);
+    testPeriodsLeft--;
+}
+
+// Decoder set up with the reference not yet seen
+static void testQeiInit(void) {
+    yawRefFound = false;
+    yawInit();
+}
+
+// Runs the yaw task from the reference for a number of periods
+static void testQeiRun(int32_t edgesPerPeriod, uint32_t periods) {
+    testEdgesPerPeriod = edgesPerPeriod;
+    testPeriodsLeft = periods;
+    hostDelayHook = testQeiHook;
+    hostTaskRun(yawCalculateTask, NULL);
+}
+/*--------------------------------------------------------------*/
+
+/* Tests -------------------------------------------------------*/
+// The encoder is on PD6/PD7 with PD7 unlocked, clear of the main
+// rotor PWM on PC5, and the QEI counts every edge of both channels
+static void testQeiConfig(void) {
+    testQeiInit();
+
+    CHECK_EQ(hostGpio[TEST_GPIO_D].qei, GPIO_PIN_6 | GPIO_PIN_7);
+    CHECK_EQ(hostGpio[TEST_GPIO_C].qei, 0);
+    CHECK(*hostRegister(GPIO_PORTD_BASE + GPIO_O_CR) & GPIO_PIN_7);
+    CHECK_EQ(*hostRegister(GPIO_PORTD_BASE + GPIO_O_LOCK), 0);
+    CHECK_EQ(hostPinConfigs, 2);
+    CHECK_EQ(hostPinConfig[0], GPIO_PD6_PHA0);
+    CHECK_EQ(hostPinConfig[1], GPIO_PD7_PHB0);
+
+    CHECK_EQ(hostQei.config, QEI_CONFIG_CAPTURE_A_B | QEI_CONFIG_NO_RESET
+             | QEI_CONFIG_QUADRATURE | QEI_CONFIG_SWAP);
+    CHECK_EQ(hostQei.maxPosition, 0xffffffff);
+    CHECK_EQ(hostQei.velPeriod, HOST_CLOCK_HZ / YAW_QEI_VEL_RATE_HZ);
+    CHECK_EQ(hostQei.position, 0);
+    CHECK(hostQei.enabled);
+    CHECK(hostQei.velEnabled);
+}
+
+// The position is taken from the reference, and the angle and
+// rate follow the counter either way round through zero
+static void testQeiAngle(void) {
+    // 4 edges per 10ms is 400 edges/s
+    const double rate = 400.0 * 360 / YAW_COUNTS_PER_REV;
+    testQeiInit();
+    hostQeiMove(-20);
+    yawRefIntHandler();
+
+    // A quarter turn forward
+    testQeiRun(4, YAW_COUNTS_PER_REV / 4 / 4);
+    CHECK_EQ(yawBamToDeg(testLatest.angle), 90);
+    CHECK_NEAR(testLatest.rate / 256.0, rate, 0.5);
+
+    // Back through the reference to a quarter turn the other way
+    testQeiRun(-4, YAW_COUNTS_PER_REV / 2 / 4);
+    CHECK_EQ(yawBamToDeg(testLatest.angle), -90);
+    CHECK_NEAR(testLatest.rate / 256.0, -rate, 0.5);
+}
+
+// A QEI phase error counts as an illegal transition and is cleared
+static void testQeiPhaseError(void) {
+    uint32_t illegal;
+    testQeiInit();
+    yawRefIntHandler();
+    illegal = yawGetIntegrity()->illegal;
+
+    hostQei.intStatus = QEI_INTERROR;
+    testQeiRun(0, 2);
+    CHECK_EQ(yawGetIntegrity()->illegal, illegal + 1);
+    CHECK_EQ(hostQei.intStatus, 0);
+}
+/*--------------------------------------------------------------*/
+
+int main(void) {
+    TEST_RUN(testQeiConfig);
+    TEST_RUN(testQeiAngle);
+    TEST_RUN(testQeiPhaseError);
+    return testReport("qei");
+}
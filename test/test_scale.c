@@ -0,0 +1,82 @@
+/*---------------------------------------------------------------
+               ________________
+                 _____|___
+                / |__|    \-----__|__
+                \_________/------ |
+                ____|___|____
+
+-----------------------------------------------------------------
+ ENCE 464 Group 13
+ test_scale.c
+
+ ADC to altitude mapping against the old per-sample division
+----------------------------------------------------------------*/
+
+/* Includes ----------------------------------------------------*/
+#include "test.h"
+#include "../altitude.c"
+/*--------------------------------------------------------------*/
+
+/* Helpers -----------------------------------------------------*/
+#define TEST_ADC_AT_0   2500    // A typical ground reading
+
+// The mapping this replaced: whole percent from a division per sample
+static int32_t testOldScale(int32_t adc) {
+    return 100 * (TEST_ADC_AT_0 - adc) / ALT_ADC_SWING;
+}
+
+// Percent (Q8) without any rounding
+static double testExactScale(int32_t adc) {
+    return 100.0 * (TEST_ADC_AT_0 - adc) * (1 << ALT_FRAC_BITS) / ALT_ADC_SWING;
+}
+/*--------------------------------------------------------------*/
+
+/* Tests -------------------------------------------------------*/
+// Every reading from ground to full height is within an LSB of the
+// exact value and gives the old whole percent when truncated
+static void testScaleLinear(void) {
+    int32_t adc;
+    altitudeInitScale(TEST_ADC_AT_0);
+    for (adc = TEST_ADC_AT_0; adc >= TEST_ADC_AT_0 - ALT_ADC_SWING; adc--) {
+        int32_t altitude = altitudeScale(adc);
+        CHECK_NEAR(altitude, testExactScale(adc), 1);
+        CHECK_EQ(altitude >> ALT_FRAC_BITS, testOldScale(adc));
+    }
+    CHECK_EQ(altitudeScale(TEST_ADC_AT_0 - ALT_ADC_SWING), 100 << ALT_FRAC_BITS);
+}
+
+// One ADC count is a fraction of a percent, not lost to truncation
+static void testScaleResolution(void) {
+    altitudeInitScale(TEST_ADC_AT_0);
+    CHECK(altitudeScale(TEST_ADC_AT_0 - 1) > 0);
+    CHECK_NEAR(altitudeScale(TEST_ADC_AT_0 - 1), testExactScale(TEST_ADC_AT_0 - 1), 1);
+    CHECK(altitudeScale(TEST_ADC_AT_0 - 5) > altitudeScale(TEST_ADC_AT_0 - 4));
+    CHECK_EQ(testOldScale(TEST_ADC_AT_0 - 5), testOldScale(TEST_ADC_AT_0 - 4));
+}
+
+// Below ground reads 0, above the limit reads the limit
+static void testScaleClamps(void) {
+    altitudeInitScale(TEST_ADC_AT_0);
+    CHECK_EQ(altitudeScale(TEST_ADC_AT_0), 0);
+    CHECK_EQ(altitudeScale(TEST_ADC_AT_0 + 1), 0);
+    CHECK_EQ(altitudeScale(4095), 0);
+    CHECK_EQ(altitudeScale(TEST_ADC_AT_0 - ALT_PCNT_LIMIT * ALT_ADC_SWING / 100),
+             ALT_PCNT_LIMIT << ALT_FRAC_BITS);
+    CHECK_EQ(altitudeScale(0), ALT_PCNT_LIMIT << ALT_FRAC_BITS);
+}
+
+// A new ground calibration moves the whole mapping
+static void testScaleRecalibrate(void) {
+    altitudeInitScale(TEST_ADC_AT_0 + 100);
+    CHECK_EQ(altitudeScale(TEST_ADC_AT_0 + 100), 0);
+    CHECK_NEAR(altitudeScale(TEST_ADC_AT_0), 100.0 * 100 * (1 << ALT_FRAC_BITS) / ALT_ADC_SWING, 1);
+}
+/*--------------------------------------------------------------*/
+
+int main(void) {
+    TEST_RUN(testScaleLinear);
+    TEST_RUN(testScaleResolution);
+    TEST_RUN(testScaleClamps);
+    TEST_RUN(testScaleRecalibrate);
+    return testReport("scale");
+}
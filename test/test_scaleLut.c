@@ -0,0 +1,61 @@
+/*---------------------------------------------------------------
+               ________________
+                 _____|___
+                / |__|    \-----__|__
+                \_________/------ |
+                ____|___|____
+
+-----------------------------------------------------------------
+ ENCE 464 Group 13
+ test_scaleLut.c
+
+ ADC to altitude mapping through the table (ALT_SCALE_USE_LUT)
+----------------------------------------------------------------*/
+
+/* Includes ----------------------------------------------------*/
+#include "test.h"
+#include "FreeRTOS.h"
+#include "queue.h"
+#include "../altitude.h"
+// Map through altScaleTable, the default table is the linear mapping
+#undef ALT_SCALE_USE_LUT
+#define ALT_SCALE_USE_LUT 1
+#include "../altitude.c"
+/*--------------------------------------------------------------*/
+
+/* Helpers -----------------------------------------------------*/
+#define TEST_ADC_AT_0   2500    // A typical ground reading
+
+// Percent (Q8) without any rounding
+static double testExactScale(int32_t adc) {
+    return 100.0 * (TEST_ADC_AT_0 - adc) * (1 << ALT_FRAC_BITS) / ALT_ADC_SWING;
+}
+/*--------------------------------------------------------------*/
+
+/* Tests -------------------------------------------------------*/
+// The default table interpolates to the linear mapping, to an LSB
+static void testScaleLutLinear(void) {
+    int32_t adc;
+    altitudeInitScale(TEST_ADC_AT_0);
+    for (adc = TEST_ADC_AT_0; adc >= TEST_ADC_AT_0 - ALT_ADC_SWING; adc--) {
+        CHECK_NEAR(altitudeScale(adc), testExactScale(adc), 1);
+    }
+}
+
+// Below ground reads 0, past the end of the table reads the limit
+static void testScaleLutClamps(void) {
+    altitudeInitScale(TEST_ADC_AT_0);
+    CHECK_EQ(altitudeScale(TEST_ADC_AT_0 + 1), 0);
+    CHECK_EQ(altitudeScale(TEST_ADC_AT_0 - ((ALT_LUT_LENGTH - 1) << ALT_LUT_STEP_BITS)),
+             ALT_PCNT_LIMIT << ALT_FRAC_BITS);
+    CHECK_EQ(altitudeScale(0), ALT_PCNT_LIMIT << ALT_FRAC_BITS);
+    CHECK(altitudeScale(TEST_ADC_AT_0 - ((ALT_LUT_LENGTH - 1) << ALT_LUT_STEP_BITS) + 1)
+          <= ALT_PCNT_LIMIT << ALT_FRAC_BITS);
+}
+/*--------------------------------------------------------------*/
+
+int main(void) {
+    TEST_RUN(testScaleLutLinear);
+    TEST_RUN(testScaleLutClamps);
+    return testReport("scaleLut");
+}
@@ -0,0 +1,312 @@
+/*---------------------------------------------------------------
+               ________________
+                 _____|___
+                / |__|    \-----__|__
+                \_________/------ |
+                ____|___|____
+
+-----------------------------------------------------------------
+ ENCE 464 Group 13
+ test_yaw.c
+
+ Yaw angles, rate estimate and encoder decoding (GPIO decoder)
+----------------------------------------------------------------*/
+
+/* Includes ----------------------------------------------------*/
+#include <string.h>
+#include "test.h"
+#include "FreeRTOS.h"
+#include "queue.h"
+#include "semphr.h"
+#include "../yaw.h"
+// Land on faults so the fault event can be checked
+#undef YAW_FAULT_POLICY
+#define YAW_FAULT_POLICY YAW_FAULT_LAND
+#include "../yaw.c"
+#include "userInput.h"
+/*--------------------------------------------------------------*/
+
+/* Helpers -----------------------------------------------------*/
+#define TEST_CYCLES_PER_MS  (HOST_CLOCK_HZ / 1000)
+
+// deg/s for a steady edge period (cycles)
+static double testYawRate(double edgePeriod) {
+    return HOST_CLOCK_HZ / edgePeriod * 360.0 / YAW_COUNTS_PER_REV;
+}
+
+// Feeds the estimator a steady turn, one update per yaw task period,
+// and returns the rate (deg/s) after the given time. Edges are
+// edgePeriod cycles apart, each moving the count by step, and the
+// free running timer starts at start.
+static double testYawRateTrace(uint32_t edgePeriod, int32_t step, uint32_t start,
+                               uint32_t updates, uint32_t stopAfter) {
+    yawRateHandle_t h = {0, start, start, 0};
+    uint32_t u;
+    for (u = 1; u <= updates; u++) {
+        uint32_t elapsed = u * YAW_TASK_RATE * TEST_CYCLES_PER_MS;
+        uint32_t moving = (u <= stopAfter) ? elapsed : stopAfter * YAW_TASK_RATE * TEST_CYCLES_PER_MS;
+        uint32_t edges = moving / edgePeriod;
+        yawRateUpdate(&h, (int32_t) edges * step, start + edges * edgePeriod, start + elapsed);
+    }
+    return h.rate / 256.0;
+}
+
+// Quadrature state (lookup table order) as the A and B pin levels
+static const uint8_t testYawPinStates[4] = {
+        0, YAW_QUAD_PIN_B, YAW_QUAD_PIN_A | YAW_QUAD_PIN_B, YAW_QUAD_PIN_A};
+#define TEST_GPIO_B     1
+
+static uint32_t testYawState;
+static uint32_t testLostEvery;
+static uint32_t testPeriodsLeft;
+
+// Sets the encoder pins and takes the edge interrupt
+static void testYawEdge(uint32_t state) {
+    testYawState = state & 3;
+    hostGpio[TEST_GPIO_B].pins = testYawPinStates[testYawState];
+    yawIntHandler();
+}
+
+// Decoder from state 0 with a clean count, the reference not yet seen
+static void testYawInit(void) {
+    memset((void*) &yawIntegrity, 0, sizeof(yawIntegrity));
+    yawCount = 0;
+    yawRefFound = false;
+    testYawState = 0;
+    hostGpio[TEST_GPIO_B].pins = 0;
+    yawInit();
+}
+
+// Turns an edge each yaw period, skipping a state every lostEvery
+// periods as a lost edge does. Stops after the given periods.
+static void testYawFaultHook(TickType_t now) {
+    if (testPeriodsLeft == 0) {
+        hostTaskExit();
+    }
+    testPeriodsLeft--;
+    if ((now / YAW_TASK_RATE) % testLostEvery == 0) {
+        testYawEdge(testYawState + 2);
+    } else {
+        testYawEdge(testYawState + 1);
+    }
+}
+
+// Runs the yaw task from the reference
+static void testYawRun(uint32_t lostEvery, uint32_t periods) {
+    yawRefIntHandler();
+    testLostEvery = lostEvery;
+    testPeriodsLeft = periods;
+    hostDelayHook = testYawFaultHook;
+    hostTaskRun(yawCalculateTask, NULL);
+}
+/*--------------------------------------------------------------*/
+
+/* Tests -------------------------------------------------------*/
+// Counts map onto the binary angle and wrap at a turn
+static void testYawCountToBam(void) {
+    CHECK_EQ(yawCountToBam(0), 0);
+    CHECK_EQ(yawBamToDeg(yawCountToBam(YAW_COUNTS_PER_REV / 4)), 90);
+    CHECK_EQ(yawBamToDeg(yawCountToBam(-YAW_COUNTS_PER_REV / 4)), -90);
+    CHECK_EQ(yawBamToDeg(yawCountToBam(YAW_COUNTS_PER_REV)), 0);
+    CHECK_EQ(yawBamToDeg(yawCountToBam(5 * YAW_COUNTS_PER_REV / 4)), 90);
+    CHECK_EQ(yawBamToDeg(yawCountToBam(-7 * YAW_COUNTS_PER_REV / 4)), 90);
+    CHECK_EQ(abs(yawBamToDeg(yawCountToBam(YAW_COUNTS_PER_REV / 2))), 180);
+
+    // Many turns lose less than a count
+    int32_t turns = 1000;
+    yawBam_t angle = yawCountToBam(turns * YAW_COUNTS_PER_REV + 1);
+    CHECK_NEAR(yawBamToDegQ8(angle) / 256.0, 360.0 / YAW_COUNTS_PER_REV, 360.0 / YAW_COUNTS_PER_REV / 2);
+}
+
+// Degrees go to a binary angle and back unchanged
+static void testYawDegRoundTrip(void) {
+    int32_t degrees;
+    CHECK_EQ(yawDegToBam(90), 1 << 30);
+    CHECK_EQ(yawDegToBam(-90), -(1 << 30));
+    CHECK_EQ(yawDegToBam(270), yawDegToBam(-90));
+    for (degrees = -179; degrees < 180; degrees++) {
+        if (yawBamToDeg(yawDegToBam(degrees)) != degrees) {
+            break;
+        }
+    }
+    CHECK_EQ(degrees, 180);
+}
+
+// The Q8 conversion keeps a single count
+static void testYawBamToDegQ8(void) {
+    CHECK_EQ(yawBamToDegQ8(yawDegToBam(90)), 90 << 8);
+    CHECK_EQ(yawBamToDegQ8(yawDegToBam(-45)), -45 * 256);
+    CHECK_NEAR(yawBamToDegQ8(yawCountToBam(1)), 360.0 * 256 / YAW_COUNTS_PER_REV, 1);
+    CHECK_NEAR(yawBamToDegQ8(yawCountToBam(-1)), -360.0 * 256 / YAW_COUNTS_PER_REV, 1);
+}
+
+// The difference of two binary angles is the short way round
+static void testYawBamDifference(void) {
+    yawBam_t a = yawDegToBam(170);
+    yawBam_t b = yawDegToBam(-170);
+    CHECK_EQ(yawBamToDeg((yawBam_t) ((uint32_t) b - (uint32_t) a)), 20);
+    CHECK_EQ(yawBamToDeg((yawBam_t) ((uint32_t) a - (uint32_t) b)), -20);
+}
+
+// Under a count per period the edge timing gives the rate, where a
+// count per period would read 0 or 80 deg/s
+static void testYawRateSlow(void) {
+    const uint32_t period = 30 * TEST_CYCLES_PER_MS;
+    CHECK_NEAR(testYawRateTrace(period, 1, 0, 100, 100), testYawRate(period), 0.1);
+    CHECK_NEAR(testYawRateTrace(period, -1, 0, 100, 100), -testYawRate(period), 0.1);
+}
+
+// At speed the count over the period gives the rate
+static void testYawRateFast(void) {
+    const uint32_t period = TEST_CYCLES_PER_MS / 2;
+    CHECK_NEAR(testYawRateTrace(period, 1, 0, 100, 100), testYawRate(period), 1);
+    CHECK_NEAR(testYawRateTrace(period, -1, 0, 100, 100), -testYawRate(period), 1);
+}
+
+// The free running timer wrapping part way through changes nothing
+static void testYawRateTimerWrap(void) {
+    const uint32_t period = 30 * TEST_CYCLES_PER_MS;
+    const uint32_t start = 0xffffffff - 20 * YAW_TASK_RATE * TEST_CYCLES_PER_MS;
+    CHECK_NEAR(testYawRateTrace(period, 1, start, 100, 100), testYawRate(period), 0.1);
+    CHECK_NEAR(testYawRateTrace(TEST_CYCLES_PER_MS / 2, -1, start, 100, 100),
+               -testYawRate(TEST_CYCLES_PER_MS / 2), 1);
+}
+
+// Once the edges stop the rate falls away and reads zero after the timeout
+static void testYawRateStop(void) {
+    const uint32_t period = 30 * TEST_CYCLES_PER_MS;
+    const uint32_t timeout = YAW_RATE_TIMEOUT_MS / YAW_TASK_RATE;
+    double settled = testYawRateTrace(period, 1, 0, 100, 100);
+    double falling = testYawRateTrace(period, 1, 0, 100 + timeout / 2, 100);
+    CHECK(falling < settled / 2);
+    CHECK(falling > 0);
+    CHECK_EQ(testYawRateTrace(period, 1, 0, 100 + timeout + 3, 100), 0);
+    CHECK_EQ(testYawRateTrace(period, -1, 0, 100 + timeout + 3, 100), 0);
+}
+
+// A standstill longer than the timer wrap, then an edge landing just
+// after the old one modulo the wrap, gives a small rate, not a spike
+static void testYawRateStandstill(void) {
+    const uint64_t update = YAW_TASK_RATE * TEST_CYCLES_PER_MS;
+    const uint64_t period = 30 * TEST_CYCLES_PER_MS;
+    yawRateHandle_t h = {0, 0, 0, 0};
+    uint64_t now = 0;
+    uint64_t edge = 0;
+    int32_t count = 0;
+
+    // Turning, then stopped until a wrap and a ms after the last edge
+    while (now < 100 * update) {
+        now += update;
+        while (edge + period <= now) {
+            edge += period;
+            count++;
+        }
+        yawRateUpdate(&h, count, (uint32_t) edge, (uint32_t) now);
+    }
+    CHECK(h.rate > 0);
+    const uint64_t restart = edge + (1ULL << 32) + TEST_CYCLES_PER_MS;
+    while (now + update < restart) {
+        now += update;
+        yawRateUpdate(&h, count, (uint32_t) edge, (uint32_t) now);
+    }
+    CHECK_EQ(h.rate, 0);
+
+    now += update;
+    yawRateUpdate(&h, count + 1, (uint32_t) restart, (uint32_t) now);
+    CHECK(h.rate > 0);
+    CHECK(h.rate / 256.0 <= testYawRate(configCPU_CLOCK_HZ / 1000 * YAW_RATE_TIMEOUT_MS));
+}
+
+// Each legal edge moves the count one way or the other. A repeated
+// state or a skipped one is counted and leaves the count alone.
+static void testYawDecode(void) {
+    uint32_t i;
+    testYawInit();
+
+    for (i = 1; i <= 8; i++) {
+        testYawEdge(i);
+    }
+    CHECK_EQ(yawGetCount(), 8);
+    for (i = 0; i < 3; i++) {
+        testYawEdge(testYawState - 1);
+    }
+    CHECK_EQ(yawGetCount(), 5);
+
+    testYawEdge(testYawState);
+    CHECK_EQ(yawGetIntegrity()->repeats, 1);
+    testYawEdge(testYawState + 2);
+    CHECK_EQ(yawGetIntegrity()->illegal, 1);
+    CHECK_EQ(yawGetCount(), 5);
+}
+
+// Every legal transition, 3<->0 included, counts one edge its own way,
+// so a quadrature cycle is 4 counts and a turn YAW_COUNTS_PER_REV
+static void testYawTable(void) {
+    uint32_t state;
+    for (state = 0; state < 4; state++) {
+        CHECK_EQ(lookup[state][(state + 1) & 3], 1);
+        CHECK_EQ(lookup[state][(state + 3) & 3], -1);
+        CHECK_EQ(lookup[state][(state + 2) & 3], 0);
+        CHECK_EQ(lookup[state][state], 0);
+    }
+
+    uint32_t i;
+    testYawInit();
+    for (i = 1; i <= YAW_COUNTS_PER_REV; i++) {
+        testYawEdge(i);
+    }
+    CHECK_EQ(yawGetCount(), YAW_COUNTS_PER_REV);
+    CHECK_EQ(yawBamToDeg(yawCountToBam(yawGetCount())), 0);
+    for (i = 0; i < YAW_COUNTS_PER_REV / 4; i++) {
+        testYawEdge(testYawState - 1);
+    }
+    CHECK_EQ(yawBamToDeg(yawCountToBam(yawGetCount())), -90);
+    CHECK_EQ(yawGetIntegrity()->illegal, 0);
+    CHECK_NEAR(4.0 * YAW_SCALE_NUM / YAW_SCALE_DEN, 4 * 360.0 / YAW_COUNTS_PER_REV, 1e-9);
+}
+
+// A few lost edges a window are only counted
+static void testYawFaultBelow(void) {
+    userInputEventMessage_t event;
+    testYawInit();
+
+    // Four lost edges a window
+    testYawRun(YAW_FAULT_WINDOW_MS / YAW_TASK_RATE / 4, 2 * YAW_FAULT_WINDOW_MS / YAW_TASK_RATE + 5);
+    CHECK(yawGetIntegrity()->illegal >= 8);
+    CHECK_EQ(yawGetIntegrity()->faults, 0);
+    CHECK(!hostUartSent("yawFault"));
+    CHECK(xQueueReceive(xUserInputEventQueue, &event, 0) != pdPASS);
+}
+
+// More than YAW_FAULT_THRESHOLD lost edges in a window is a fault,
+// reported and sent to the control tasks as a landing event
+static void testYawFaultLand(void) {
+    userInputEventMessage_t event;
+    testYawInit();
+
+    testYawRun(1, YAW_FAULT_WINDOW_MS / YAW_TASK_RATE + 5);
+    CHECK_EQ(yawGetIntegrity()->faults, 1);
+    CHECK(yawGetIntegrity()->windowMax > YAW_FAULT_THRESHOLD);
+    CHECK(hostUartSent("yawFault"));
+    CHECK(xQueueReceive(xUserInputEventQueue, &event, 0) == pdPASS);
+    CHECK_EQ(event.name, FAULT);
+    CHECK_EQ(event.action, SWITCHED_OFF);
+}
+/*--------------------------------------------------------------*/
+
+int main(void) {
+    TEST_RUN(testYawCountToBam);
+    TEST_RUN(testYawDegRoundTrip);
+    TEST_RUN(testYawBamToDegQ8);
+    TEST_RUN(testYawBamDifference);
+    TEST_RUN(testYawRateSlow);
+    TEST_RUN(testYawRateFast);
+    TEST_RUN(testYawRateTimerWrap);
+    TEST_RUN(testYawRateStop);
+    TEST_RUN(testYawRateStandstill);
+    TEST_RUN(testYawDecode);
+    TEST_RUN(testYawTable);
+    TEST_RUN(testYawFaultBelow);
+    TEST_RUN(testYawFaultLand);
+    return testReport("yaw");
+}
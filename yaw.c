@@ -20,47 +20,207 @@
 #include "yaw.h"
 #include "pwm.h"
 #include "uart.h"
+#include "userInput.h"
 /*--------------------------------------------------------------*/
 
 /* Globals -----------------------------------------------------*/
 const int32_t lookup[4][4]= {     // Lookup table for change in
-        { 0,  1, -1,  1},         // yaw direction based on the
-        {-1,  0,  1, -1},         // previous and current encoder
-        { 1, -1,  0,  1},         // states.
-        {-1,  1, -1,  0}};
+        { 0,  1,  0, -1},         // yaw direction based on the
+        {-1,  0,  1,  0},         // previous and current encoder
+        { 0, -1,  0,  1},         // states. Illegal transitions
+        { 1,  0, -1,  0}};        // (both pins changed) give 0.
+
+// Encoder error counters. The transition counts are only written by
+// the decoder (yawIntHandler, or the yaw task with YAW_USE_QEI), the
+// window fields only by the yaw task.
+static volatile yawIntegrity_t yawIntegrity;
+
+// Latest yaw rate (deg/s, Q8)
+static volatile int32_t yawRate = 0;
+
+// Count and direction at the last reference crossing, written only by
+// yawRefIntHandler
+static volatile int32_t yawIndexCount = 0;
+static volatile int32_t yawIndexDir = 0;
+static volatile uint32_t yawIndexSeq = 0;
+static volatile bool yawRefFound = false;
+
+// Index correction, used only by the yaw task. The sensor triggers at a
+// different count in each direction, so the offset for the direction
+// not seen at start up is learnt from its first crossing.
+static int32_t yawRefDir;
+static int32_t yawReverseOffset;
+static bool yawReverseKnown = false;
+static yawIndexStats_t yawIndexStats;
+
+#if !YAW_USE_QEI
+// Decoder state and yaw count, written only by yawIntHandler. A 32 bit
+// aligned read is a single load so readers need no lock.
+static encoderHandle_t yawEncoder;
+static volatile int32_t yawCount = 0;
+static volatile int32_t yawDirection = 0;   // Sign of the last counted edge
+static volatile uint32_t yawEdgeTime = 0;   // Timer value at the last counted edge
+static volatile uint32_t yawEdgeSeq = 0;    // Bumped by every counted edge
+static volatile yawIsrStats_t yawIsrStats;
+#endif
 /*--------------------------------------------------------------*/
 
 /* Function definitions ----------------------------------------*/
 
-//Task: Recieves yaw quadrature state from the yaw ISR queue and increments/decrements
-//the task's yaw position count depending on the yaw direction. Calculates the
-//angle from the yaw position an sends it to the measured angle queue.
+//Wraps a count difference to the nearest half turn either way
+static int32_t yawWrapCounts(int32_t counts) {
+    counts %= YAW_COUNTS_PER_REV;
+    if (counts > YAW_COUNTS_PER_REV / 2) {
+        counts -= YAW_COUNTS_PER_REV;
+    } else if (counts <= -YAW_COUNTS_PER_REV / 2) {
+        counts += YAW_COUNTS_PER_REV;
+    }
+    return counts;
+}
+
+//Checks a reference crossing against the origin. A crossing should
+//be a whole number of turns from it, anything else is counts gained
+//or lost since, so the origin is moved to take them out.
+static void yawIndexCorrect(int32_t* origin, int32_t indexCount, int32_t indexDir) {
+    int32_t error = yawWrapCounts(indexCount - *origin);
+    if (indexDir != yawRefDir) {
+        if (!yawReverseKnown) {
+            yawReverseOffset = error;
+            yawReverseKnown = true;
+            return;
+        }
+        error = yawWrapCounts(error - yawReverseOffset);
+    }
+    yawIndexStats.crossings++;
+
+    char str[30];
+    if (abs(error) > YAW_INDEX_MAX_ERROR) {
+        yawIndexStats.rejected++;
+        usprintf(str, "yawIdxReject %d\r\n", error);
+        uartSend(str);
+        return;
+    }
+    yawIndexStats.lastError = error;
+    if (abs(error) > abs(yawIndexStats.maxError)) {
+        yawIndexStats.maxError = error;
+    }
+    if (abs(error) > YAW_INDEX_DEADBAND) {
+        *origin += error;
+        yawIndexStats.corrections++;
+        usprintf(str, "yawIdx %d\r\n", error);
+        uartSend(str);
+    }
+}
+
+//Task: Reads the yaw count, calculates the angle from it and sends it
+//to the measured angle queue.
 void yawCalculateTask(void *pvParameters) {
-    encoderHandle_t yawState = {0}; // Encoder state variable
     int32_t yawPosition = 0;        // Total quadrature positions traveled
-    int32_t yawAngle = 0;           // Current angle
+    yawBam_t yawAngle = 0;          // Current angle
+    int32_t yawOrigin;              // Count at the reference point
+    uint32_t indexSeq;
+#if !YAW_USE_QEI
+    yawRateHandle_t yawRateEstimate;
+#endif
+#if !YAW_USE_QEI && YAW_ISR_PROFILE
+    uint32_t reportedCycles = 0;
+#endif
+    uint32_t windowStart = xTaskGetTickCount();
+    uint32_t windowIllegal = 0;
+    TickType_t lastWake;
 
     // Wait for ISR to give semaphore
-    xSemaphoreTake(ctrlYawRefSmph, (TickType_t) 0xffff);
-    xQueueReset(xYawEncoderQueue);
+    xSemaphoreTake(ctrlYawRefSmph, portMAX_DELAY);
+    // The decoder owns the count, so remember where the reference was
+    indexSeq = yawIndexSeq;
+    yawOrigin = yawIndexCount;
+    yawRefDir = yawIndexDir;
+#if !YAW_USE_QEI
+    yawRateEstimate.prevCount = yawGetEdge(&yawRateEstimate.prevEdgeTime);
+    yawRateEstimate.prevTime = TimerValueGet(YAW_TIMER_BASE, YAW_TIMER);
+    yawRateEstimate.rate = 0;
+#endif
     xQueueReset(xMeasuredAltitudeQueue);
     xQueueReset(xMeasuredYawQueue);
     xSemaphoreGive(ctrlYawRefSmph);
 
+    lastWake = xTaskGetTickCount();
     while (1) {
-        while(uxQueueMessagesWaiting(xYawEncoderQueue) > 0) {
-            if(xQueueReceive(xYawEncoderQueue, (void *) &yawState, (TickType_t) 10) != pdPASS) {
-                uartSend("yawIntRXfail\r\n");
+        // Correct the origin when the reference has been passed again
+        if (yawIndexSeq != indexSeq) {
+            int32_t indexCount, indexDir;
+            do {
+                indexSeq = yawIndexSeq;
+                indexCount = yawIndexCount;
+                indexDir = yawIndexDir;
+            } while (indexSeq != yawIndexSeq);
+            yawIndexCorrect(&yawOrigin, indexCount, indexDir);
+        }
+
+#if YAW_USE_QEI
+        // The counter wraps at 2^32, read it as a signed count
+        yawPosition = yawGetCount() - yawOrigin;
+        yawAngle = yawCountToBam(yawPosition);
+
+        // Edges in the last capture period, signed by direction
+        int32_t counts = QEIVelocityGet(YAW_QEI_BASE) * YAW_QEI_VEL_RATE_HZ;
+        counts *= QEIDirectionGet(YAW_QEI_BASE);
+        yawRate = (int32_t) ((int64_t) counts * (YAW_SCALE_NUM << 8) / YAW_SCALE_DEN);
+#else
+        uint32_t edgeTime;
+        int32_t count = yawGetEdge(&edgeTime);
+        yawPosition = count - yawOrigin;
+        yawAngle = yawCountToBam(yawPosition);
+        yawRate = yawRateUpdate(&yawRateEstimate, count, edgeTime,
+                                TimerValueGet(YAW_TIMER_BASE, YAW_TIMER));
+#endif
+#if !YAW_USE_QEI && YAW_ISR_PROFILE
+        // Report the worst handler time and the edge rate it can keep up with
+        if (yawIsrStats.maxCycles != reportedCycles) {
+            char str[40];
+            reportedCycles = yawIsrStats.maxCycles;
+            usprintf(str, "yawIsr %dcyc %d edges/s\r\n", reportedCycles,
+                     configCPU_CLOCK_HZ / (reportedCycles + YAW_ISR_ENTRY_CYCLES));
+            uartSend(str);
+        }
+#endif
+#if YAW_USE_QEI
+        // The QEI flags a phase error when both channels change at once
+        if (QEIIntStatus(YAW_QEI_BASE, false) & QEI_INTERROR) {
+            QEIIntClear(YAW_QEI_BASE, QEI_INTERROR);
+            yawIntegrity.illegal++;
+        }
+#endif
+        // Check the encoder error rate once per window
+        if (xTaskGetTickCount() - windowStart >= YAW_FAULT_WINDOW_MS / portTICK_RATE_MS) {
+            uint32_t illegal = yawIntegrity.illegal;
+            uint32_t errors = illegal - windowIllegal;
+            windowIllegal = illegal;
+            windowStart = xTaskGetTickCount();
+            if (errors > yawIntegrity.windowMax) {
+                yawIntegrity.windowMax = errors;
+            }
+            if (errors > YAW_FAULT_THRESHOLD) {
+                char str[40];
+                yawIntegrity.faults++;
+                usprintf(str, "yawFault %d ill %d rep\r\n", illegal, yawIntegrity.repeats);
+                uartSend(str);
+                if (YAW_FAULT_POLICY == YAW_FAULT_LAND) {
+                    // Every flying state lands on a fault event
+                    userInputEventMessage_t land;
+                    land.name = FAULT;
+                    land.action = SWITCHED_OFF;
+                    xQueueSend(xUserInputEventQueue, (void *) &land, (TickType_t) 0);
+                }
             }
-            // Calculate the new position and angle
-            yawPosition += yawChange(&yawState);
-            yawAngle = yawCalcDeg(yawPosition);
         }
 
-        // Send the yaw position to the PID controller task
-        xQueueSend(xMeasuredYawQueue, (void *) &yawAngle, (TickType_t) 10);
+        // Send the yaw angle and rate to the PID controller task
+        yawMessage_t measured = {yawAngle, yawRate};
+        xQueueSend(xMeasuredYawQueue, (void *) &measured, (TickType_t) 10);
 
-        vTaskDelay(YAW_TASK_RATE / portTICK_RATE_MS);
+        // Fixed rate, not counting the time taken by this cycle
+        vTaskDelayUntil(&lastWake, YAW_TASK_RATE / portTICK_RATE_MS);
     }
 }
 
@@ -86,61 +246,225 @@ int8_t yawChange(encoderHandle_t* h) {
 }
 
 
-//Returns the current angle of the helicopter depending on
-//the given encodeer counts
-int32_t yawCalcDeg (int32_t yawPostion) {
-    // Calculates current yaw position in degrees (-179 -> 180)
-    // from total yaw quadrature encodes traveled
-    int32_t yawAngle;
-    yawAngle = (yawPostion * YAW_SCALE_NUM / YAW_SCALE_DEN) % 360;
+//Returns the binary angle of the given encoder count. The
+//multiply wraps at one turn by itself.
+yawBam_t yawCountToBam (int32_t yawPosition) {
+    return (yawBam_t) ((uint32_t) yawPosition * YAW_BAM_PER_COUNT);
+}
+
+//Converts a binary angle to whole degrees, rounded (-180 -> 180)
+int32_t yawBamToDeg (yawBam_t angle) {
+    return (int32_t) (((int64_t) angle * 360 + (1LL << 31)) >> 32);
+}
+
+//Converts a binary angle to degrees (Q8)
+int32_t yawBamToDegQ8 (yawBam_t angle) {
+    return (int32_t) (((int64_t) angle * 360) >> 24);
+}
+
+//Converts degrees to a binary angle
+yawBam_t yawDegToBam (int32_t degrees) {
+    return (yawBam_t) (uint32_t) ((int64_t) degrees * (1LL << 32) / 360);
+}
+
+//Returns the latest yaw rate (deg/s, Q8)
+int32_t yawGetRate (void) {
+    return yawRate;
+}
+
+//Returns a snapshot of the decoded yaw count
+int32_t yawGetCount (void) {
+#if YAW_USE_QEI
+    return (int32_t) QEIPositionGet(YAW_QEI_BASE);
+#else
+    return yawCount;
+#endif
+}
+
+//Returns a snapshot of the decoded yaw count and the timer value
+//at its last edge, read again if an edge lands part way through
+int32_t yawGetEdge (uint32_t* edgeTime) {
+#if YAW_USE_QEI
+    *edgeTime = 0;
+    return yawGetCount();
+#else
+    uint32_t seq;
+    int32_t count;
+    do {
+        seq = yawEdgeSeq;
+        count = yawCount;
+        *edgeTime = yawEdgeTime;
+    } while (seq != yawEdgeSeq);
+    return count;
+#endif
+}
+
+//Updates the rate estimate. At low speed the rate comes from the time
+//between the last edges of consecutive updates, which resolves much
+//less than a count per period. At high speed the count over the update
+//period is used, which is not affected by edge timing jitter.
+int32_t yawRateUpdate (yawRateHandle_t* h, int32_t count, uint32_t edgeTime, uint32_t now) {
+    int32_t counts = count - h->prevCount;
 
-    if (abs(yawAngle) > 180) {
-        if (yawAngle > 0) {yawAngle = yawAngle - 360;}
-        else              {yawAngle = yawAngle + 360;}
+    if (counts == 0) {
+        // No edge yet. The rate can be no more than one count over the
+        // time since the last edge, so let it fall towards zero.
+        const uint32_t timeout = configCPU_CLOCK_HZ / 1000 * YAW_RATE_TIMEOUT_MS;
+        uint32_t since = now - h->prevEdgeTime;
+        if (since >= timeout) {
+            // Stopped. The last edge is kept no older than the timeout, so
+            // the first edge after a standstill longer than the timer wrap
+            // is still timed from well before it.
+            h->rate = 0;
+            h->prevEdgeTime = now - timeout;
+        } else if (since > 0) {
+            int32_t bound = (int32_t) (YAW_RATE_SCALE / since);
+            if (h->rate > bound) {
+                h->rate = bound;
+            } else if (h->rate < -bound) {
+                h->rate = -bound;
+            }
+        }
+        h->prevTime = now;
+        return h->rate;
+    }
+
+    uint32_t elapsed;
+    if (abs(counts) < YAW_RATE_SWITCH_COUNTS) {
+        elapsed = edgeTime - h->prevEdgeTime;
+    } else {
+        elapsed = now - h->prevTime;
+    }
+    if (elapsed > 0) {
+        h->rate = (int32_t) (counts * YAW_RATE_SCALE / elapsed);
     }
-    return yawAngle;
+    h->prevCount = count;
+    h->prevEdgeTime = edgeTime;
+    h->prevTime = now;
+    return h->rate;
+}
+
+//Returns the encoder integrity counters
+const yawIntegrity_t* yawGetIntegrity (void) {
+    return (const yawIntegrity_t*) &yawIntegrity;
+}
+
+//Returns the index pulse correction statistics
+const yawIndexStats_t* yawGetIndexStats (void) {
+    return &yawIndexStats;
+}
+
+//Returns the yawIntHandler timing
+const yawIsrStats_t* yawGetIsrStats (void) {
+#if YAW_USE_QEI
+    return NULL;
+#else
+    return (const yawIsrStats_t*) &yawIsrStats;
+#endif
 }
 
 //Initialises the peripherals required to determine the yaw
 //reference point and the yaw position
 void yawInit (void) {
     // GPIO setup for yaw reference pin
+    SysCtlPeripheralEnable(YAW_REF_PERIPH);
+    GPIOPinTypeGPIOInput(YAW_REF_BASE, YAW_REF_PIN);
+    IntRegister(YAW_REF_INT_GROUP, yawRefIntHandler);
+    GPIOIntTypeSet(YAW_REF_BASE, YAW_REF_PIN, GPIO_RISING_EDGE);
+    GPIOIntEnable(YAW_REF_BASE, YAW_REF_PIN);
+    IntEnable(YAW_REF_INT_GROUP);
+
+#if YAW_USE_QEI
+    // QEI setup for quadrature encoding channels. Counts every edge of
+    // both channels. A and B are swapped so the count runs the same way
+    // as the lookup table decode.
+    SysCtlPeripheralEnable(YAW_QEI_PERIPH);
+    SysCtlPeripheralEnable(YAW_QEI_GPIO_PERIPH);
+    // Unlock PD7 so it can be given to the QEI
+    HWREG(YAW_QEI_GPIO_BASE + GPIO_O_LOCK) = GPIO_LOCK_KEY;
+    HWREG(YAW_QEI_GPIO_BASE + GPIO_O_CR) |= YAW_QEI_PIN_B;
+    HWREG(YAW_QEI_GPIO_BASE + GPIO_O_LOCK) = 0;
+    GPIOPinConfigure(YAW_QEI_PIN_A_CONFIG);
+    GPIOPinConfigure(YAW_QEI_PIN_B_CONFIG);
+    GPIOPinTypeQEI(YAW_QEI_GPIO_BASE, YAW_QEI_PIN_A | YAW_QEI_PIN_B);
+    QEIConfigure(YAW_QEI_BASE, QEI_CONFIG_CAPTURE_A_B | QEI_CONFIG_NO_RESET
+                 | QEI_CONFIG_QUADRATURE | QEI_CONFIG_SWAP, 0xffffffff);
+    QEIVelocityConfigure(YAW_QEI_BASE, QEI_VELDIV_1, SysCtlClockGet() / YAW_QEI_VEL_RATE_HZ);
+    QEIPositionSet(YAW_QEI_BASE, 0);
+    QEIVelocityEnable(YAW_QEI_BASE);
+    QEIEnable(YAW_QEI_BASE);
+#else
     // GPIO setup for quadrature encoding channels
     SysCtlPeripheralEnable(YAW_QUAD_PERIPH);
-    SysCtlPeripheralEnable(YAW_REF_PERIPH);
     GPIOPinTypeGPIOInput(YAW_QUAD_BASE, YAW_QUAD_PIN_A | YAW_QUAD_PIN_B);
-    GPIOPinTypeGPIOInput(YAW_REF_BASE, YAW_REF_PIN);
     IntRegister(YAW_QUAD_INT_GROUP, yawIntHandler);
-    IntRegister(YAW_REF_INT_GROUP, yawRefIntHandler);
+    // Free running timer for the edge timestamps
+    SysCtlPeripheralEnable(YAW_TIMER_PERIPH);
+    TimerConfigure(YAW_TIMER_BASE, TIMER_CFG_PERIODIC_UP);
+    TimerLoadSet(YAW_TIMER_BASE, YAW_TIMER, 0xffffffff);
+    TimerEnable(YAW_TIMER_BASE, YAW_TIMER);
+    // Start the decoder from the current pin state
+    yawEncoder.pins = GPIOPinRead(YAW_QUAD_BASE, YAW_QUAD_PIN_A | YAW_QUAD_PIN_B);
+    yawChange(&yawEncoder);
     GPIOIntTypeSet(YAW_QUAD_BASE, YAW_QUAD_PIN_A | YAW_QUAD_PIN_B, GPIO_BOTH_EDGES);
-    GPIOIntTypeSet(YAW_REF_BASE, YAW_REF_PIN, GPIO_RISING_EDGE);
     GPIOIntEnable(YAW_QUAD_BASE, YAW_QUAD_PIN_A | YAW_QUAD_PIN_B);
-    GPIOIntEnable(YAW_REF_BASE, YAW_REF_PIN);
     IntEnable(YAW_QUAD_INT_GROUP);
-    IntEnable(YAW_REF_INT_GROUP);
+#endif
 }
 
-//Interupt handler for quadrature encoder. Places encoder state
-//on a queue
+#if !YAW_USE_QEI
+//Interupt handler for quadrature encoder. Decodes the new encoder
+//state and updates the yaw count
 void yawIntHandler(void) {
+#if YAW_ISR_PROFILE
+    uint32_t start = HWREG(CORE_DWT_CYCCNT);
+#endif
     // Clear interrupt
     GPIOIntClear(YAW_QUAD_BASE, YAW_QUAD_PIN_A | YAW_QUAD_PIN_B);
 
-    // Get pin states
-    uint8_t a = GPIOPinRead(YAW_QUAD_BASE, YAW_QUAD_PIN_A);
-    uint8_t b = GPIOPinRead(YAW_QUAD_BASE, YAW_QUAD_PIN_B);
-
-    // Package both bits into one uint8_t
-    uint8_t input = a | b;
+    // Both pin states in one read
+    yawEncoder.pins = GPIOPinRead(YAW_QUAD_BASE, YAW_QUAD_PIN_A | YAW_QUAD_PIN_B);
+    int8_t change = yawChange(&yawEncoder);
+    int32_t moved = yawEncoder.prevState ^ yawEncoder.currentState;
+    if (moved == 0) {
+        yawIntegrity.repeats++;
+    } else if (moved == 2) {
+        // States 0-2 and 1-3 differ in both pins
+        yawIntegrity.illegal++;
+    }
+    if (change != 0) {
+        yawCount += change;
+        yawDirection = change;
+        yawEdgeTime = TimerValueGet(YAW_TIMER_BASE, YAW_TIMER);
+        yawEdgeSeq++;
+    }
 
-    // Send position change inputs to the calculate yaw position task
-    xQueueSendFromISR( xYawEncoderQueue, &input, pdFALSE );
+#if YAW_ISR_PROFILE
+    uint32_t cycles = HWREG(CORE_DWT_CYCCNT) - start;
+    yawIsrStats.lastCycles = cycles;
+    if (cycles > yawIsrStats.maxCycles) {
+        yawIsrStats.maxCycles = cycles;
+    }
+    yawIsrStats.edges++;
+#endif
 }
+#endif
 
-//Interupt handler for yaw reference pin. Gives
-//semaphore for unblocking tasks when found.
+//Interupt handler for yaw reference pin. Records the count at
+//every crossing. Gives semaphore for unblocking tasks the first
+//time it is found.
 void yawRefIntHandler(void) {
     GPIOIntClear(YAW_REF_BASE, YAW_REF_PIN);
-    xSemaphoreGiveFromISR(ctrlYawRefSmph, NULL);
+    yawIndexCount = yawGetCount();
+#if YAW_USE_QEI
+    yawIndexDir = QEIDirectionGet(YAW_QEI_BASE);
+#else
+    yawIndexDir = yawDirection;
+#endif
+    yawIndexSeq++;
+    if (!yawRefFound) {
+        yawRefFound = true;
+        xSemaphoreGiveFromISR(ctrlYawRefSmph, NULL);
+    }
 }
 /*--------------------------------------------------------------*/
@@ -11,33 +11,118 @@
 
  Yaw position is encoded with a quadrature encoder.
  The yawIntHandler interrupt is generated when either
- pin of the encoder changes, the internal YawPosition
- variable is then updated accordingly. yawDegrees is
- then calculated by yawCalcDeg in the main loop.
+ pin of the encoder changes, it decodes the new state
+ and updates the yaw count. Only the ISR writes the
+ count, tasks read it whole with yawGetCount. The yaw
+ task turns the count into a binary angle (yawBam_t) where
+ a full turn is 2^32, so wrapping is free integer
+ overflow. Degrees are only used at the UI and telemetry.
+ Every edge is timestamped and the task estimates yaw
+ rate from the time between edges at low speed and the
+ edges per task period at high speed.
+ With YAW_USE_QEI the QEI peripheral counts the edges
+ instead and the task reads its position and velocity.
+ The reference sensor stays armed after start up as an
+ index pulse. Each crossing corrects any counts lost
+ since the last one.
 ----------------------------------------------------------------*/
 #ifndef YAW_H_
 #define YAW_H_
 /* Macro Definitions -------------------------------------------*/
-// Yaw scaling
-#define YAW_SCALE_NUM       1607
-#define YAW_SCALE_DEN       1000
+// Yaw scaling. Every edge of both channels is counted
+#define YAW_COUNTS_PER_REV  448
+#define YAW_SCALE_NUM       360
+#define YAW_SCALE_DEN       YAW_COUNTS_PER_REV
+// Binary angle per encoder count (2^32 per turn)
+#define YAW_BAM_PER_COUNT   ((uint32_t) (((uint64_t) YAW_SCALE_NUM << 32) / (360 * YAW_SCALE_DEN)))
 #define YAW_REF_TASK_RATE   10
 #define YAW_TASK_RATE       10    // (ms) Duration to suspend task
+
+// Yaw rate estimator
+#define YAW_RATE_SWITCH_COUNTS 4  // Edges per task period above which edges are counted
+#define YAW_RATE_TIMEOUT_MS 250   // No edge for this long reads as stopped
+// deg/s (Q8) for one count per timer tick
+#define YAW_RATE_SCALE      (((int64_t) configCPU_CLOCK_HZ * YAW_SCALE_NUM << 8) / YAW_SCALE_DEN)
+
+// Decode the encoder in the QEI peripheral rather than from GPIO
+// edge interrupts. Needs the encoder on the YAW_QEI pins.
+#define YAW_USE_QEI         0
+#define YAW_QEI_VEL_RATE_HZ 100   // QEI velocity capture rate
+
+// Encoder integrity. Illegal transitions (both pins changed, so an
+// edge was lost and the direction is unknown) are counted over each
+// window. More than YAW_FAULT_THRESHOLD in a window applies
+// YAW_FAULT_POLICY.
+#define YAW_FAULT_WINDOW_MS 1000
+#define YAW_FAULT_THRESHOLD 5
+#define YAW_FAULT_POLICY    YAW_FAULT_REPORT
+
+// Index pulse correction. Errors within the deadband are left alone,
+// errors over the limit are taken as a bad pulse and ignored
+#define YAW_INDEX_DEADBAND  1     // counts
+#define YAW_INDEX_MAX_ERROR (YAW_COUNTS_PER_REV / 8)
+
+// Time yawIntHandler with the cycle counter. Off in flight builds, it
+// adds two counter reads and a report to the hottest handler.
+#define YAW_ISR_PROFILE     0
+#define YAW_ISR_ENTRY_CYCLES 24   // Exception entry and exit, not seen by the counter
 /*--------------------------------------------------------------*/
 
 /* Type Definitions --------------------------------------------*/
+enum yawFaultPolicies {
+    YAW_FAULT_REPORT,   // Report over UART only
+    YAW_FAULT_LAND      // Report and ask the controller to land
+};
+
+// Binary angle, 2^32 is one turn. As a signed value it runs
+// from -180 up to just under 180 degrees.
+typedef int32_t yawBam_t;
+
+typedef struct yawMessage_t {
+    yawBam_t angle;
+    int32_t rate;           // deg/s (Q8)
+} yawMessage_t;
+
+typedef struct yawRateHandle_t {
+    int32_t prevCount;      // Count at the last update
+    uint32_t prevEdgeTime;  // Time of the last edge at the last update
+    uint32_t prevTime;      // Time of the last update
+    int32_t rate;           // deg/s (Q8)
+} yawRateHandle_t;
+
 typedef struct encoderHandle_t {
     uint8_t pins;    // LSB encodes pinA state, next bit pinB
     int32_t prevState;    // Previous quadrature encoded state
     int32_t currentState; // Current quadrature encoded state
 } encoderHandle_t;
+
+typedef struct yawIntegrity_t {
+    uint32_t illegal;     // Both pins changed between interrupts (lost edge)
+    uint32_t repeats;     // Interrupt with no change of state (bounce or two lost edges)
+    uint32_t windowMax;   // Most illegal transitions in one fault window
+    uint32_t faults;      // Windows over YAW_FAULT_THRESHOLD
+} yawIntegrity_t;
+
+typedef struct yawIndexStats_t {
+    uint32_t crossings;   // Index pulses checked
+    uint32_t corrections; // Pulses that moved the position
+    uint32_t rejected;    // Pulses with an error over YAW_INDEX_MAX_ERROR
+    int32_t lastError;    // Counts gained (+) or lost (-) at the last pulse
+    int32_t maxError;     // Largest error accepted
+} yawIndexStats_t;
+
+typedef struct yawIsrStats_t {
+    uint32_t edges;       // Edges decoded
+    uint32_t lastCycles;  // Handler cycles for the last edge
+    uint32_t maxCycles;   // Worst handler cycles
+} yawIsrStats_t;
 /*--------------------------------------------------------------*/
 
 /* Globals --------------------------------------------*/
 extern QueueHandle_t xMeasuredYawQueue;
-extern QueueHandle_t xYawEncoderQueue;
 extern QueueHandle_t xMeasuredAltitudeQueue;
 extern SemaphoreHandle_t ctrlYawRefSmph;
+extern QueueHandle_t xUserInputEventQueue;
 /*--------------------------------------------------------------*/
 
 /* Function prototypes -----------------------------------------*/
@@ -53,8 +138,29 @@ void yawIntHandler(void);
 // Calculates the change in yaw position after a change in
 // state of either quadrature encoder pin
 int8_t yawChange(encoderHandle_t* yawState);
-// Calculates current yaw position in degrees (-180 -> 180)
-int32_t yawCalcDeg (int32_t yawPosition);
+// Binary angle of a yaw count
+yawBam_t yawCountToBam (int32_t yawPosition);
+// Binary angle to whole degrees (-180 -> 180), rounded
+int32_t yawBamToDeg (yawBam_t angle);
+// Binary angle to degrees (Q8)
+int32_t yawBamToDegQ8 (yawBam_t angle);
+// Degrees to binary angle
+yawBam_t yawDegToBam (int32_t degrees);
+// Latest yaw rate (deg/s, Q8)
+int32_t yawGetRate (void);
+// Snapshot of the decoded yaw count
+int32_t yawGetCount (void);
+// Snapshot of the decoded yaw count and the timer value at its last edge
+int32_t yawGetEdge (uint32_t* edgeTime);
+// Updates the rate estimate from a count and edge time snapshot taken
+// at timer value now. Returns the rate (deg/s, Q8).
+int32_t yawRateUpdate (yawRateHandle_t* h, int32_t count, uint32_t edgeTime, uint32_t now);
+// yawIntHandler timing
+const yawIsrStats_t* yawGetIsrStats (void);
+// Encoder integrity counters
+const yawIntegrity_t* yawGetIntegrity (void);
+// Index pulse correction statistics
+const yawIndexStats_t* yawGetIndexStats (void);
 /*--------------------------------------------------------------*/
 
 #endif /* YAW_H_ */